@@ -5,6 +5,10 @@ import json
 
 workspace_folder = os.path.abspath(os.path.join(os.path.dirname(__file__), 'src/chess_ai/ai_cplus'))
 unit_tests_folder = os.path.join(workspace_folder, "unit_tests")
+benchmarks_folder = os.path.join(workspace_folder, "benchmarks")
+match_folder = os.path.join(workspace_folder, "match")
+tuner_folder = os.path.join(workspace_folder, "tuner")
+dataset_folder = os.path.join(workspace_folder, "dataset")
 headers_folder = os.path.join(workspace_folder, "headers")
 print(headers_folder)
 print(unit_tests_folder)
@@ -29,7 +33,8 @@ tasks["tasks"].append({
         "-o",
         f"{workspace_folder}/miniMax.exe",
         "-I",
-        headers_folder
+        headers_folder,
+        "-pthread"
     ],
     "group": {
         "kind": "build",
@@ -39,6 +44,77 @@ tasks["tasks"].append({
     "detail": "Compile miniMax.cpp with headers"
 })
 
+# Optimised builds of the engine. The default build above is a -g debug build.
+# MARCH picks the target CPU, "native" means the machine doing the build
+march = os.environ.get("MARCH", "native")
+release_flags = ["-O3", f"-march={march}", "-DNDEBUG"]
+engine_exe = f"{workspace_folder}/miniMax.exe"
+profile_folder = os.path.join(workspace_folder, "pgo_profile")
+
+
+def engine_build(label, flags, detail):
+    return {
+        "label": label,
+        "type": "shell",
+        "command": "g++",
+        "args": flags + [
+            f"{workspace_folder}/miniMax.cpp",
+            "-o",
+            engine_exe,
+            "-I",
+            headers_folder,
+            "-pthread"
+        ],
+        "group": {
+            "kind": "build",
+            "isDefault": False
+        },
+        "problemMatcher": ["$gcc"],
+        "detail": detail
+    }
+
+
+tasks["tasks"].append(engine_build("build miniMax release", release_flags,
+                                   "Compile miniMax.cpp with -O3 for the selected -march"))
+tasks["tasks"].append(engine_build("build miniMax lto", release_flags + ["-flto"],
+                                   "Release build with link time optimisation"))
+tasks["tasks"].append(engine_build("build miniMax trace", release_flags + ["-DSEARCH_TRACE"],
+                                   "Release build with the hot path timers of headers/trace.h"))
+tasks["tasks"].append(engine_build("build miniMax memory audit", release_flags + ["-DMEMORY_AUDIT"],
+                                   "Release build counting heap allocations, see headers/memory_audit.h"))
+
+# Profile guided build in two stages: an instrumented binary runs the bench
+# command to collect a profile, then the engine is rebuilt using it.
+# Both stages must write the same output file, the profile is named after it
+tasks["tasks"].append({
+    "label": "pgo clean",
+    "type": "shell",
+    "command": "python",
+    "args": ["-c", f"import shutil; shutil.rmtree(r'{profile_folder}', ignore_errors=True)"],
+    "detail": "Remove old profile data"
+})
+tasks["tasks"].append(engine_build("pgo instrument", release_flags + ["-flto", f"-fprofile-generate={profile_folder}"],
+                                   "Build an instrumented miniMax for profiling"))
+tasks["tasks"].append({
+    "label": "pgo train",
+    "type": "shell",
+    "command": engine_exe,
+    "args": ["bench"],
+    "detail": "Run the bench command to collect the profile"
+})
+tasks["tasks"].append(engine_build("pgo optimize", release_flags + ["-flto", f"-fprofile-use={profile_folder}", "-fprofile-correction"],
+                                   "Rebuild miniMax using the collected profile"))
+tasks["tasks"].append({
+    "label": "build miniMax pgo",
+    "dependsOrder": "sequence",
+    "dependsOn": ["pgo clean", "pgo instrument", "pgo train", "pgo optimize"],
+    "group": {
+        "kind": "build",
+        "isDefault": False
+    },
+    "detail": "Two stage profile guided build, trained on the bench command"
+})
+
 # Add a task for each test file
 for test_file in test_files:
     test_name = os.path.splitext(test_file)[0]
@@ -52,7 +128,8 @@ for test_file in test_files:
             "-o",
             f"{test_name}.exe",
             "-I",
-            headers_folder
+            headers_folder,
+            "-pthread"
         ],
         "group": {
             "kind": "build",
@@ -62,6 +139,99 @@ for test_file in test_files:
         "detail": f"Compile {test_file} with headers"
     })
 
+# Benchmarks are only meaningful with optimisation turned on
+bench_files = [f for f in os.listdir(benchmarks_folder) if f.endswith('.cpp')]
+for bench_file in bench_files:
+    bench_name = os.path.splitext(bench_file)[0]
+    tasks["tasks"].append({
+        "label": f"build benchmark {bench_name}",
+        "type": "shell",
+        "command": "g++",
+        "args": [
+            "-O2",
+            f"{benchmarks_folder}/{bench_file}",
+            "-o",
+            f"{bench_name}.exe",
+            "-I",
+            headers_folder,
+            "-pthread"
+        ],
+        "group": {
+            "kind": "build",
+            "isDefault": False
+        },
+        "problemMatcher": ["$gcc"],
+        "detail": f"Compile benchmark {bench_file} with optimisations"
+    })
+
+# Self-play match runner, plays two engine builds against each other (Linux only)
+tasks["tasks"].append({
+    "label": "build match_runner",
+    "type": "shell",
+    "command": "g++",
+    "args": [
+        "-O2",
+        f"{match_folder}/match_runner.cpp",
+        "-o",
+        f"{workspace_folder}/match_runner.exe",
+        "-I",
+        headers_folder,
+        "-pthread"
+    ],
+    "group": {
+        "kind": "build",
+        "isDefault": False
+    },
+    "problemMatcher": ["$gcc"],
+    "detail": "Compile the match runner, see match/match_runner.cpp for its options"
+})
+
+# Texel tuner, fits the evaluation parameters to game results and rewrites eval_values.h
+tasks["tasks"].append({
+    "label": "build texel_tuner",
+    "type": "shell",
+    "command": "g++",
+    "args": [
+        "-O3",
+        f"-march={march}",
+        f"{tuner_folder}/texel_tuner.cpp",
+        "-o",
+        f"{workspace_folder}/texel_tuner.exe",
+        "-I",
+        headers_folder,
+        "-pthread"
+    ],
+    "group": {
+        "kind": "build",
+        "isDefault": False
+    },
+    "problemMatcher": ["$gcc"],
+    "detail": "Compile the evaluation tuner, see tuner/texel_tuner.cpp for its options"
+})
+
+# PGN to packed position dataset converter, the input for the tuner
+tasks["tasks"].append({
+    "label": "build pgn_converter",
+    "type": "shell",
+    "command": "g++",
+    "args": [
+        "-O3",
+        f"-march={march}",
+        f"{dataset_folder}/pgn_converter.cpp",
+        "-o",
+        f"{workspace_folder}/pgn_converter.exe",
+        "-I",
+        headers_folder,
+        "-pthread"
+    ],
+    "group": {
+        "kind": "build",
+        "isDefault": False
+    },
+    "problemMatcher": ["$gcc"],
+    "detail": "Compile the PGN converter, see dataset/pgn_converter.cpp for its options"
+})
+
 # Write the tasks.json file
 with open(".vscode/tasks.json", "w") as f:
     json.dump(tasks, f, indent=4)
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <eval_values.h>
+#include <board_representation.h>
+#include <search_algorithm.h>
+#include <game_annotation.h>
+#include <bench.h>
+#include "bench_harness.h"
+
+// Whole game annotation with one hash table walked back through the game, against
+// searching every position from a cleared table.
+// Usage: annotate.exe [results.json]
+
+// The Opera Game, Morphy against the Duke of Brunswick and Count Isouard, 1858
+const std::string BENCH_GAME = "1. e4 e5 2. Nf3 d6 3. d4 Bg4 4. dxe5 Bxf3 5. Qxf3 dxe5 6. Bc4 Nf6 7. Qb3 Qe7 "
+                               "8. Nc3 c6 9. Bg5 b5 10. Nxb5 cxb5 11. Bxb5+ Nbd7 12. O-O-O Rd8 13. Rxd7 Rxd7 "
+                               "14. Rd1 Qe6 15. Bxd7+ Nxd7 16. Qb8+ Nxb8 17. Rd8# 1-0";
+
+int main(int argc, char *argv[]) {
+    PgnGame game;
+    if (!game_from_pgn_text(BENCH_GAME, game)) {
+        std::cerr << "could not read the game" << std::endl;
+        return 1;
+    }
+    std::vector<BenchResult> results;
+    uint64_t nodes[2] = {0, 0};
+    for (int reuse = 1; reuse >= 0; reuse--) {
+        results.push_back(run_benchmark(reuse ? "annotate_backwards_shared" : "annotate_cold", 1, [&]() {
+            SearchState state;
+            state.print_progress = false;
+            Board board(game.fen);
+            GameAnnotation annotation = annotate_game(board, board.current_player, game.moves, BENCH_DEPTH, state, reuse);
+            nodes[reuse] = annotation.nodes;
+            return annotation.nodes;
+        }, 3, 1));
+    }
+    std::fprintf(stderr, "%d plies at depth %d: %llu nodes against %llu, %.2f of the time\n", (int)game.moves.size(), BENCH_DEPTH,
+                 (unsigned long long)nodes[1], (unsigned long long)nodes[0], results[0].median_ns / results[1].median_ns);
+    write_results(argc, argv, results_to_json("annotate", {BENCH_GAME}, results));
+    return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Timings of one benchmark, all per single operation
+struct BenchResult {
+    std::string name;
+    int samples;
+    uint64_t ops_per_sample;
+    double median_ns;
+    double p95_ns;
+    double mean_ns;
+    double ops_per_sec;
+};
+
+// Results are added to this so the compiler can't throw the measured work away
+volatile uint64_t bench_sink = 0;
+
+// Shortest time a single sample should take, short samples are mostly timer noise
+const double MIN_SAMPLE_NS = 5e6;
+
+// Run `body` (which does ops_per_call operations) a few times untimed to warm
+// caches and branch predictors, then time it `samples` times and summarise.
+// Each sample repeats the body enough times to take at least MIN_SAMPLE_NS
+template <typename Function>
+BenchResult run_benchmark(const std::string &name, uint64_t ops_per_call, Function body, int samples = 31, int warmup = 5) {
+    double warmup_ns = 0;
+    for (int i = 0; i < warmup; i++) {
+        auto start = std::chrono::steady_clock::now();
+        bench_sink = bench_sink + body();
+        warmup_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+    int repeats = std::max(1, (int)(MIN_SAMPLE_NS / std::max(warmup_ns, 1.0)));
+    uint64_t ops_per_sample = ops_per_call * repeats;
+
+    std::vector<double> per_op_ns;
+    for (int i = 0; i < samples; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            bench_sink = bench_sink + body();
+        }
+        auto end = std::chrono::steady_clock::now();
+        per_op_ns.push_back(std::chrono::duration<double, std::nano>(end - start).count() / ops_per_sample);
+    }
+    std::sort(per_op_ns.begin(), per_op_ns.end());
+
+    BenchResult result;
+    result.name = name;
+    result.samples = samples;
+    result.ops_per_sample = ops_per_sample;
+    result.median_ns = per_op_ns[per_op_ns.size() / 2];
+    result.p95_ns = per_op_ns[std::min(per_op_ns.size() - 1, (size_t)(per_op_ns.size() * 0.95))];
+    double sum = 0;
+    for (double t : per_op_ns) {
+        sum += t;
+    }
+    result.mean_ns = sum / per_op_ns.size();
+    result.ops_per_sec = 1e9 / result.median_ns;
+
+    std::fprintf(stderr, "%-28s median %10.1f ns  p95 %10.1f ns  %12.0f ops/s\n", name.c_str(), result.median_ns, result.p95_ns, result.ops_per_sec);
+    return result;
+}
+
+std::string json_escape(const std::string &text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+// All results as one JSON document, so runs on different commits can be diffed
+std::string results_to_json(const std::string &suite, const std::vector<std::string> &positions, const std::vector<BenchResult> &results) {
+    std::ostringstream out;
+    out << "{\n  \"suite\": \"" << json_escape(suite) << "\",\n  \"positions\": [";
+    for (size_t i = 0; i < positions.size(); i++) {
+        out << (i ? ", " : "") << "\"" << json_escape(positions[i]) << "\"";
+    }
+    out << "],\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        out << "    {\"name\": \"" << json_escape(r.name) << "\", \"samples\": " << r.samples
+            << ", \"ops_per_sample\": " << r.ops_per_sample
+            << ", \"median_ns\": " << r.median_ns << ", \"p95_ns\": " << r.p95_ns
+            << ", \"mean_ns\": " << r.mean_ns << ", \"ops_per_sec\": " << r.ops_per_sec << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+// Print the JSON, and also save it if a file name was given on the command line
+void write_results(int argc, char *argv[], const std::string &json) {
+    std::cout << json;
+    if (argc > 1) {
+        std::ofstream file(argv[1]);
+        file << json;
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+
+#include <eval_values.h>
+#include <board_representation.h>
+#include <bench.h>
+#include "bench_harness.h"
+
+// FEN parsing and writing against the std::string versions they replaced.
+// Usage: fen.exe [results.json]
+
+// The board state the old functions worked on
+struct LegacyPosition {
+    std::array<std::array<int, 8>, 8> board;
+    int pieces_alive;
+    int king_pos[2][2];
+    int current_player;
+    bool white_castle[2];
+    bool black_castle[2];
+    int en_passant[2];
+    int halfmove_clock;
+    int fullmove_number;
+    uint64_t hash;
+};
+
+// The old set_board, as it was
+void legacy_set_board(std::string FEN, LegacyPosition &p) {
+    p.board.fill({0, 0, 0, 0, 0, 0, 0, 0});
+    p.pieces_alive = 0;
+    p.halfmove_clock = 0;
+    p.fullmove_number = 1;
+    p.en_passant[0] = p.en_passant[1] = -1;
+    p.white_castle[0] = p.white_castle[1] = false;
+    p.black_castle[0] = p.black_castle[1] = false;
+
+    int row = 0;
+    int col = 0;
+    int space_pos = FEN.find(" ");
+    for (int i = 0; i < space_pos; i++) {
+        char value = FEN[i];
+        if (value == '/') {
+            col = 0;
+            row++;
+            continue;
+        }
+        if (isdigit(value)) {
+            col += value - '0' - 1;
+        } else {
+            p.board[row][col] = piece_to_number.at(value);
+            p.pieces_alive++;
+            if (std::abs(p.board[row][col]) == 5) {
+                int color = p.board[row][col] > 0 ? 0 : 1;
+                p.king_pos[color][0] = row;
+                p.king_pos[color][1] = col;
+            }
+        }
+        col++;
+    }
+    p.current_player = FEN[space_pos + 1] == 'w' ? 1 : -1;
+    for (size_t i = space_pos + 2; i < FEN.find(" ", space_pos + 3); i++) {
+        switch (FEN[i]) {
+            case 'K': p.white_castle[1] = true; break;
+            case 'Q': p.white_castle[0] = true; break;
+            case 'k': p.black_castle[1] = true; break;
+            case 'q': p.black_castle[0] = true; break;
+        }
+    }
+    space_pos = FEN.find(" ", space_pos + 3);
+    if (FEN[space_pos + 1] != '-') {
+        p.en_passant[0] = 8 - (FEN[space_pos + 2] - '0');
+        p.en_passant[1] = ALPHATOCOLS.at(FEN[space_pos + 1]);
+    }
+    size_t counters = FEN.find(" ", space_pos + 1);
+    if (counters != std::string::npos) {
+        p.halfmove_clock = std::atoi(FEN.c_str() + counters + 1);
+        counters = FEN.find(" ", counters + 1);
+        if (counters != std::string::npos) {
+            p.fullmove_number = std::max(1, std::atoi(FEN.c_str() + counters + 1));
+        }
+    }
+
+    int castle = p.white_castle[0] | (p.white_castle[1] << 1) | (p.black_castle[0] << 2) | (p.black_castle[1] << 3);
+    uint64_t key = ZOBRIST.castle[castle];
+    if (p.en_passant[0] != -1) {
+        key ^= ZOBRIST.en_passant[p.en_passant[1]];
+    }
+    for (int r = 0; r < 8; r++) {
+        for (int c = 0; c < 8; c++) {
+            key ^= ZOBRIST.pieces[p.board[r][c] + 6][r * 8 + c];
+        }
+    }
+    p.hash = key;
+}
+
+// The old board_to_fen, as it was
+std::string legacy_board_to_fen(const LegacyPosition &p, int side) {
+    std::string FEN = "";
+    for (int row = 0; row < 8; row++) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            int piece = p.board[row][col];
+            if (piece == 0) {
+                empty++;
+            } else {
+                if (empty > 0) {
+                    FEN += std::to_string(empty);
+                    empty = 0;
+                }
+                FEN += number_to_piece.at(piece);
+            }
+        }
+        if (empty > 0) {
+            FEN += std::to_string(empty);
+        }
+        if (row < 7) {
+            FEN += "/";
+        }
+    }
+    FEN += side == 1 ? " w " : " b ";
+    if (p.white_castle[0] || p.white_castle[1] || p.black_castle[0] || p.black_castle[1]) {
+        if (p.white_castle[1]) FEN += "K";
+        if (p.white_castle[0]) FEN += "Q";
+        if (p.black_castle[1]) FEN += "k";
+        if (p.black_castle[0]) FEN += "q";
+    } else {
+        FEN += "-";
+    }
+    FEN += " ";
+    if (p.en_passant[0] != -1) {
+        FEN += ALPHACOLS.at(p.en_passant[1]);
+        FEN += std::to_string(8 - p.en_passant[0]);
+    } else {
+        FEN += "-";
+    }
+    FEN += " " + std::to_string(p.halfmove_clock) + " " + std::to_string(p.fullmove_number);
+    return FEN;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> fens(BENCH_POSITIONS.begin(), BENCH_POSITIONS.end());
+    std::vector<std::string_view> views(fens.begin(), fens.end());
+    std::vector<LegacyPosition> legacy(fens.size());
+    std::vector<int> sides;
+    for (size_t p = 0; p < fens.size(); p++) {
+        legacy_set_board(fens[p], legacy[p]);
+        sides.push_back(legacy[p].current_player);
+    }
+    Board board(fens[0]);
+    std::vector<BenchResult> results;
+
+    results.push_back(run_benchmark("legacy_set_board", fens.size(), [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < fens.size(); p++) {
+            legacy_set_board(fens[p], legacy[p]);
+            sum += legacy[p].hash;
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("parse_fen", fens.size(), [&]() {
+        uint64_t sum = 0;
+        for (std::string_view fen : views) {
+            sum += board.parse_fen(fen);
+            sum += board.pieces_alive;
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("legacy_board_to_fen", fens.size(), [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < fens.size(); p++) {
+            sum += legacy_board_to_fen(legacy[p], sides[p]).size();
+        }
+        return sum;
+    }));
+
+    // Written from the positions the parse benchmark left on the boards
+    std::vector<Board> boards(fens.begin(), fens.end());
+    results.push_back(run_benchmark("write_fen", fens.size(), [&]() {
+        uint64_t sum = 0;
+        char fen[MAX_FEN_LENGTH];
+        for (size_t p = 0; p < boards.size(); p++) {
+            sum += boards[p].write_fen(fen, sides[p]);
+            sum += fen[0];
+        }
+        return sum;
+    }));
+
+    std::fprintf(stderr, "parse speedup %.1fx, write speedup %.1fx\n",
+                 results[0].median_ns / results[1].median_ns, results[2].median_ns / results[3].median_ns);
+    write_results(argc, argv, results_to_json("fen", BENCH_POSITIONS, results));
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+
+#include <eval_values.h>
+#include <board_representation.h>
+#include <search_algorithm.h>
+#include <mate_search.h>
+#include "bench_harness.h"
+
+// The mate solver against the alpha-beta search on mate puzzles, both from a cleared table.
+// Alpha-beta gets exactly the depth the mate needs, which it wouldn't know on a real puzzle.
+// Usage: mate.exe [results.json]
+
+struct MatePuzzle {
+    std::string fen;
+    int moves; // Mate in
+};
+
+const std::vector<MatePuzzle> MATE_PUZZLES = {
+    {"r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1", 2},
+    {"2r3k1/p4p2/3Rp2p/1p2P1pK/8/1P4P1/P3Q2P/1q6 b - - 0 1", 3},
+    {"k7/8/8/1Q6/8/8/K7/8 w - - 4 3", 5},
+};
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> fens;
+    for (const MatePuzzle &puzzle : MATE_PUZZLES) {
+        fens.push_back(puzzle.fen);
+    }
+    std::vector<BenchResult> results;
+    MateSearch solver;
+    SearchState state;
+    state.print_progress = false;
+
+    for (const MatePuzzle &puzzle : MATE_PUZZLES) {
+        Board board(puzzle.fen);
+        int side = board.current_player;
+        std::string name = "mate_in_" + std::to_string(puzzle.moves) + "_" + std::to_string(results.size() / 2);
+
+        uint64_t solver_nodes = 0;
+        results.push_back(run_benchmark(name + "_dfpn", 1, [&]() {
+            solver.clear();
+            MateResult result = solver.solve(board, side, puzzle.moves);
+            if (!result.found || result.moves != puzzle.moves) {
+                std::cerr << "solver missed the mate in " << puzzle.fen << std::endl;
+                std::exit(1);
+            }
+            solver_nodes = result.nodes;
+            return result.nodes;
+        }, 11, 1));
+
+        uint64_t search_nodes = 0;
+        results.push_back(run_benchmark(name + "_alphabeta", 1, [&]() {
+            state.hash_table.clear();
+            MiniMaxResult result = start_minimax(2 * puzzle.moves - 1, &board, side == 1, state);
+            search_nodes = state.stats.nodes.get();
+            return (uint64_t)result.score;
+        }, 5, 1));
+
+        const BenchResult &dfpn = results[results.size() - 2];
+        const BenchResult &alphabeta = results.back();
+        std::fprintf(stderr, "%s: %llu nodes against %llu, %.1fx faster\n", name.c_str(), (unsigned long long)solver_nodes,
+                     (unsigned long long)search_nodes, alphabeta.median_ns / dfpn.median_ns);
+    }
+
+    write_results(argc, argv, results_to_json("mate", fens, results));
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <array>
+
+#include <eval_values.h>
+#include <board_representation.h>
+#include <search_algorithm.h>
+#include <mcts.h>
+#include <bench.h>
+#include "bench_harness.h"
+
+// Throughput of the MCTS engine by thread count, next to the alpha-beta search on the
+// bench positions, and how often the two pick the same move.
+// Usage: mcts_bench.exe [results.json]
+
+// Iterations of every MCTS search, about as long as the alpha-beta search at BENCH_DEPTH
+const int MCTS_BENCH_DEPTH = 5;
+
+int main(int argc, char *argv[]) {
+    std::vector<BenchResult> results;
+    std::vector<std::array<int, 4>> minimax_moves(BENCH_POSITIONS.size());
+    std::vector<std::array<int, 4>> mcts_moves(BENCH_POSITIONS.size());
+
+    uint64_t nodes = 0;
+    results.push_back(run_benchmark("minimax_depth_" + std::to_string(BENCH_DEPTH), 1, [&]() {
+        nodes = 0;
+        for (size_t p = 0; p < BENCH_POSITIONS.size(); p++) {
+            SearchState state;
+            state.print_progress = false;
+            Board board(BENCH_POSITIONS[p]);
+            minimax_moves[p] = start_minimax(BENCH_DEPTH, &board, board.current_player == 1, state).move;
+            nodes += state.stats.nodes.get();
+        }
+        return nodes;
+    }, 3, 1));
+    std::fprintf(stderr, "minimax: %.0f nodes/s\n", nodes * results.back().ops_per_sec);
+
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    MctsSearch mcts(DEFAULT_MCTS_NODES);
+    for (int playout : {0, 8}) {
+        for (int threads = 1; threads <= cores; threads *= 2) {
+            mcts.config.threads = threads;
+            mcts.config.playout_plies = playout;
+            uint64_t iterations = 0;
+            std::string name = "mcts_threads_" + std::to_string(threads) + (playout ? "_playout_" + std::to_string(playout) : "");
+            results.push_back(run_benchmark(name, 1, [&]() {
+                iterations = 0;
+                for (size_t p = 0; p < BENCH_POSITIONS.size(); p++) {
+                    SearchState state;
+                    state.print_progress = false;
+                    Board board(BENCH_POSITIONS[p]);
+                    mcts_moves[p] = mcts.search(board, MCTS_BENCH_DEPTH, board.current_player == 1, state).move;
+                    iterations += mcts.last_iterations();
+                }
+                return iterations;
+            }, 3, 1));
+            int same = 0;
+            for (size_t p = 0; p < BENCH_POSITIONS.size(); p++) {
+                same += mcts_moves[p] == minimax_moves[p];
+            }
+            std::fprintf(stderr, "%s: %.0f iterations/s, same move as minimax in %d of %d positions\n", name.c_str(),
+                         iterations * results.back().ops_per_sec, same, (int)BENCH_POSITIONS.size());
+        }
+    }
+
+    write_results(argc, argv, results_to_json("mcts", BENCH_POSITIONS, results));
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+
+#include <eval_values.h>
+#include <eval_functions.h>
+#include <board_representation.h>
+#include <search_algorithm.h>
+#include <bench.h>
+#include "bench_harness.h"
+
+// Microbenchmarks for the functions the search spends its time in.
+// Usage: primitives.exe [results.json]
+
+int main(int argc, char *argv[]) {
+    std::vector<Board> boards;
+    std::vector<std::vector<std::array<int, 4>>> moves;
+    std::vector<int> sides;
+    uint64_t total_moves = 0;
+    for (const std::string &fen : BENCH_POSITIONS) {
+        boards.push_back(Board(fen));
+        int side = boards.back().current_player;
+        sides.push_back(side);
+        moves.push_back(boards.back().get_allmoves(side));
+        total_moves += moves.back().size();
+    }
+    uint64_t positions = boards.size();
+    std::vector<BenchResult> results;
+
+    results.push_back(run_benchmark("move_piece+undo_move", total_moves, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            for (const auto &m : moves[p]) {
+                boards[p].move_piece(m[0], m[1], m[2], m[3]);
+                sum += boards[p].pieces_alive;
+                boards[p].undo_move();
+            }
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("get_allmoves", positions, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            sum += boards[p].get_allmoves(sides[p]).size();
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("is_check", total_moves, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            for (const auto &m : moves[p]) {
+                sum += boards[p].move_leaves_check(m[0], m[1], m[2], m[3]);
+            }
+        }
+        return sum;
+    }));
+
+    // Evaluation, as a whole and term by term
+    std::vector<std::array<std::array<int, 8>, 8>> arrays;
+    std::vector<std::array<std::array<int, 2>, 2>> kings;
+    for (Board &board : boards) {
+        arrays.push_back(board.get_board());
+        int king_pos[2][2];
+        board.get_king_pos(king_pos);
+        kings.push_back({{{king_pos[0][0], king_pos[0][1]}, {king_pos[1][0], king_pos[1][1]}}});
+    }
+
+    results.push_back(run_benchmark("evaluate_board", positions, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            int king_pos[2][2] = {{kings[p][0][0], kings[p][0][1]}, {kings[p][1][0], kings[p][1][1]}};
+            sum += (int64_t)evaluate_board(arrays[p], boards[p].pieces_alive, king_pos);
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("sum_material_values", positions, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            sum += sum_material_values(arrays[p], boards[p].pieces_alive);
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("evaluate_pawn_structure", positions, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            sum += evaluate_pawn_structure(arrays[p]);
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("compute_attack_maps", positions, [&]() {
+        uint64_t sum = 0;
+        AttackMaps maps;
+        for (size_t p = 0; p < boards.size(); p++) {
+            compute_attack_maps(arrays[p], maps);
+            sum += maps.side[0].all ^ maps.side[1].twice;
+        }
+        return sum;
+    }));
+
+    // The terms reading the attack maps, on maps worked out beforehand
+    std::vector<AttackMaps> attack_maps(boards.size());
+    for (size_t p = 0; p < boards.size(); p++) {
+        compute_attack_maps(arrays[p], attack_maps[p]);
+    }
+
+    results.push_back(run_benchmark("evaluate_king_safety", positions, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            int king_pos[2][2] = {{kings[p][0][0], kings[p][0][1]}, {kings[p][1][0], kings[p][1][1]}};
+            sum += evaluate_king_safety(attack_maps[p], king_pos);
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("evaluate_threats", positions, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            sum += evaluate_threats(attack_maps[p]);
+        }
+        return sum;
+    }));
+
+    // FEN round trips
+    results.push_back(run_benchmark("board_to_fen", positions, [&]() {
+        uint64_t sum = 0;
+        for (size_t p = 0; p < boards.size(); p++) {
+            sum += boards[p].board_to_fen(sides[p]).size();
+        }
+        return sum;
+    }));
+
+    results.push_back(run_benchmark("set_board", positions, [&]() {
+        uint64_t sum = 0;
+        for (const std::string &fen : BENCH_POSITIONS) {
+            Board board(fen);
+            sum += board.pieces_alive;
+        }
+        return sum;
+    }));
+
+    // Hash table, filled by a short search from every position
+    SearchState state;
+    state.print_progress = false;
+    std::vector<uint64_t> keys;
+    for (size_t p = 0; p < boards.size(); p++) {
+        state.max_depth = 3;
+        iterative_minimax(&boards[p], sides[p] == 1, state);
+        keys.push_back(boards[p].get_hash(sides[p]));
+        for (const auto &m : moves[p]) {
+            boards[p].move_piece(m[0], m[1], m[2], m[3]);
+            keys.push_back(boards[p].get_hash(-sides[p]));
+            boards[p].undo_move();
+        }
+    }
+
+    results.push_back(run_benchmark("hash_table_probe", keys.size(), [&]() {
+        uint64_t sum = 0;
+        HashEntry entry;
+        for (uint64_t key : keys) {
+            sum += state.hash_table.probe(key, entry);
+        }
+        return sum;
+    }));
+
+    write_results(argc, argv, results_to_json("primitives", BENCH_POSITIONS, results));
+    return 0;
+}
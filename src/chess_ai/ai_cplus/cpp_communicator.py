@@ -2,9 +2,11 @@ from subprocess import Popen, PIPE
 import os
 import time
 import shlex  # For handling shell commands
+import threading
+import json
 
 class CplusAI:
-    def __init__(self):
+    def __init__(self, ponder=True):
         # Get the directory where the current file is located
         current_dir = os.path.dirname(os.path.abspath(__file__))
         # Get the path to the project folder
@@ -19,12 +21,36 @@ class CplusAI:
         # Launch the C++ program as a subprocess without shell
         self.cpp_process = Popen([folder_path], stdin=PIPE, stdout=PIPE, stderr=PIPE)
 
-    def cpp_minimax(self, FEN, player, depth=5):
-        message = f'{1 if player == "white" else -1},{depth},{FEN}\n'
-        # Send the string
-        self.cpp_process.stdin.write(message.encode())
+        # Let the engine keep searching while the other side is thinking
+        if ponder:
+            self.send('ponder on')
+
+    def send(self, message):
+        self.cpp_process.stdin.write(f'{message}\n'.encode())
         self.cpp_process.stdin.flush()
 
+    def stop(self):
+        # The engine answers with the best move it has found so far
+        self.send('stop')
+
+    def is_ready(self):
+        self.send('isready')
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if line_returned == "readyok":
+                return True
+
+    def cpp_minimax(self, FEN, player, depth=5, time_limit=None):
+        message = f'{1 if player == "white" else -1},{depth},{FEN}'
+        # Send the string
+        self.send(message)
+
+        # Stop the search when the time is up, the engine still gives a move
+        timer = None
+        if time_limit is not None:
+            timer = threading.Timer(time_limit, self.stop)
+            timer.start()
+
         resulting_move = [0, 0, 0, 0]
         while True:
             line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
@@ -36,8 +62,125 @@ class CplusAI:
                 for i, number in enumerate(numbers):
                     resulting_move[i] = eval(number)
 
+        if timer is not None:
+            timer.cancel()
         return resulting_move
 
+    def save_hash(self, path):
+        # Keep the engine's analysis, load_hash in a later session picks it up again
+        return self._hash_file_command(f'savehash {path}')
+
+    def load_hash(self, path):
+        return self._hash_file_command(f'loadhash {path}')
+
+    def _hash_file_command(self, message):
+        self.send(message)
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if line_returned.startswith("info string hash"):
+                return True
+            if line_returned.startswith("info string could not"):
+                return False
+
+    def memory_report(self):
+        # What the engine's structures take in bytes, as a dict. A build with -DMEMORY_AUDIT
+        # also has the heap allocations of every phase
+        self.send('memory')
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if line_returned.startswith("info string memory {"):
+                return json.loads(line_returned[len("info string memory "):])
+
+    def set_memory_limit(self, megabytes):
+        # Cap the engine's memory, the hash table shrinks to fit. 0 takes the cap away
+        self.send(f'memory limit {megabytes}')
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if line_returned.startswith("info string memory limit"):
+                return True
+            if line_returned.startswith("info string could not limit memory"):
+                return False
+
+    def set_engine(self, name, threads=None, playout=None):
+        # "minimax" or "mcts". MCTS can search with several threads, and play random moves
+        # from a leaf before evaluating it
+        if threads is not None:
+            self.send(f'mcts threads {threads}')
+        if playout is not None:
+            self.send(f'mcts playout {playout}')
+        self.send(f'engine {name}')
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if line_returned.startswith("info string engine"):
+                return True
+            if line_returned.startswith("info string could not switch"):
+                return False
+
+    def cpp_mate(self, FEN, moves=0):
+        # Mate solver for the side to move, moves=0 looks for any mate. Returns (mate in, [moves])
+        # with the defender's longest replies in between, (0, []) if there is no mate in that
+        # many moves and None if the solver gave up first
+        self.send(f'mate {moves} {FEN}')
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if not line_returned.startswith("info string mate "):
+                continue
+            words = line_returned.split()
+            if words[3] == "unknown":
+                return None
+            if words[3] == "none":
+                return (0, [])
+            line = line_returned.split(" pv ")[1].split() if " pv " in line_returned else []
+            return (int(words[3]), [[int(n) for n in move.split(',')] for move in line])
+
+    def cpp_annotate(self, game, depth=5):
+        # Every move of a game with its score, the best move instead and a flag ("none",
+        # "inaccuracy", "mistake" or "blunder"). game is PGN text, a move list like "e4 e5 Nf3",
+        # or "file PATH" for the first game of a PGN file. Scores and losses are in centipawns.
+        # Returns (plies, summary)
+        game = " ".join(game.split())
+        self.send(f'annotate {depth} {game}')
+        plies = []
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if line_returned.startswith("info string could not read the game"):
+                return None
+            if line_returned.startswith("info string annotate "):
+                return plies, json.loads(line_returned[len("info string annotate "):])
+            if not line_returned.startswith("info annotate "):
+                continue
+            words = line_returned.split(" pv ")[0].split()
+            ply = {key: words[words.index(key) + 1] for key in ("san", "flag")}
+            for key in ("move", "best"):
+                ply[key] = [int(n) for n in words[words.index(key) + 1].split(',')]
+            for key in ("score", "bestscore"):
+                ply[key] = " ".join(words[words.index(key) + 1:words.index(key) + 3])
+            ply["loss"] = int(words[words.index("loss") + 1])
+            line = line_returned.split(" pv ")[1] if " pv " in line_returned else ""
+            ply["pv"] = [[int(n) for n in move.split(',')] for move in line.split()]
+            plies.append(ply)
+
+    def cpp_analyse(self, FEN, player, depth=5, lines=3):
+        # The best lines of the position as (score, [moves]), best first.
+        # Scores are "cp <centipawns>" or "mate <moves>", from white's side
+        self.send(f'multipv {lines}')
+        self.send(f'{1 if player == "white" else -1},{depth},{FEN}')
+        found = {}
+        while True:
+            line_returned = self.cpp_process.stdout.readline().strip().decode("utf-8")
+            if "We are done" in line_returned:
+                break
+            if not line_returned.startswith("info depth") or " pv " not in line_returned:
+                continue
+            words = line_returned.split(" pv ")[0].split()
+            number = int(words[words.index("multipv") + 1]) if "multipv" in words else 1
+            score = " ".join(words[words.index("score") + 1:words.index("score") + 3])
+            moves = [[int(n) for n in move.split(',')] for move in line_returned.split(" pv ")[1].split()]
+            # Deeper iterations come later and replace the lines of the earlier ones
+            found[number] = (score, moves)
+        self.send('multipv 1')
+        return [found[number] for number in sorted(found)]
+
 if __name__ == "__main__":
     cpp = CplusAI()
     time.sleep(1)
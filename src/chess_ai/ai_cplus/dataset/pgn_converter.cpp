@@ -0,0 +1,179 @@
+// Converts PGN files into a packed position dataset (see headers/packed_position.h).
+// Every position of every finished game is written with the move played in it and
+// the result of the game. The files are shared out over all cores.
+//
+//   pgn_converter -out games.bin [options] FILE_OR_FOLDER...
+//
+// Options:
+//   -threads N       Files converted at the same time (default: one per core)
+//   -skip N          Leave out the first N plies of every game (default 0)
+//
+// Games without a result are left out. A game is cut off at the first move that can't be
+// decoded (broken SAN, or an underpromotion the board can't make), the positions before
+// it are kept.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <board_representation.h>
+#include <pgn_reader.h>
+#include <packed_position.h>
+
+// Positions a thread collects before handing them to the writer
+const size_t CHUNK_POSITIONS = 1 << 16;
+
+struct ConverterConfig {
+    std::string out_file;
+    std::vector<std::string> inputs;
+    int threads = 0;
+    int skip_plies = 0;
+};
+
+struct ConvertStats {
+    std::atomic<uint64_t> games{0};
+    std::atomic<uint64_t> cut_games{0}; // Games with a FEN tag or a move that couldn't be decoded
+    std::atomic<uint64_t> bytes{0};
+};
+
+// Add the positions of a game to chunk, false if its FEN or a move couldn't be decoded
+bool convert_game(const PgnGame &game, int skip_plies, std::vector<PackedPosition> &chunk, DatasetWriter &writer){
+    Board board("");
+    if (!board.parse_fen(game.fen)) {
+        return false;
+    }
+    int side = board.current_player;
+    std::array<int, 4> move;
+    // The board keeps MAX_HISTORY moves, longer games stop there
+    size_t plies = std::min(game.moves.size(), (size_t)MAX_HISTORY);
+    for (size_t ply = 0; ply < plies; ply++) {
+        if (!san_to_move(board, side, game.moves[ply], move)) {
+            return false;
+        }
+        if ((int)ply >= skip_plies) {
+            chunk.push_back(pack_position(board, side, move, game.result));
+            if (chunk.size() == CHUNK_POSITIONS) {
+                writer.write(chunk);
+            }
+        }
+        board.move_piece(move[0], move[1], move[2], move[3]);
+        side = -side;
+    }
+    return true;
+}
+
+void convert_file(const std::string &path, const ConverterConfig &config, DatasetWriter &writer, ConvertStats &stats, std::vector<PackedPosition> &chunk){
+    PgnReader reader(path);
+    if (!reader.is_open()) {
+        std::cerr << "Could not open " << path << std::endl;
+        return;
+    }
+    PgnGame game;
+    while (reader.next_game(game)) {
+        if (game.result == PGN_NO_RESULT) {
+            continue;
+        }
+        if (!convert_game(game, config.skip_plies, chunk, writer)) {
+            stats.cut_games++;
+        }
+        stats.games++;
+    }
+    std::error_code error;
+    stats.bytes += std::filesystem::file_size(path, error);
+}
+
+// The PGN files to convert, folders are searched for .pgn files
+std::vector<std::string> collect_files(const std::vector<std::string> &inputs){
+    std::vector<std::string> files;
+    for (const std::string &input : inputs) {
+        if (std::filesystem::is_directory(input)) {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".pgn") {
+                    files.push_back(entry.path().string());
+                }
+            }
+        } else {
+            files.push_back(input);
+        }
+    }
+    // Biggest first, so one large file doesn't start last and hold everything up
+    std::error_code error;
+    std::sort(files.begin(), files.end(), [&](const std::string &a, const std::string &b) {
+        return std::filesystem::file_size(a, error) > std::filesystem::file_size(b, error);
+    });
+    return files;
+}
+
+bool parse_args(int argc, char *argv[], ConverterConfig &config){
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-out" && has_value) {
+            config.out_file = argv[++i];
+        } else if (arg == "-threads" && has_value) {
+            config.threads = std::atoi(argv[++i]);
+        } else if (arg == "-skip" && has_value) {
+            config.skip_plies = std::atoi(argv[++i]);
+        } else if (arg[0] == '-') {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        } else {
+            config.inputs.push_back(arg);
+        }
+    }
+    if (config.out_file.empty() || config.inputs.empty()) {
+        std::cerr << "Usage: pgn_converter -out FILE [options] FILE_OR_FOLDER..., see dataset/pgn_converter.cpp" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    ConverterConfig config;
+    if (!parse_args(argc, argv, config)) {
+        return 1;
+    }
+    std::vector<std::string> files = collect_files(config.inputs);
+    DatasetWriter writer(config.out_file);
+    if (!writer.is_open()) {
+        std::cerr << "Could not create " << config.out_file << std::endl;
+        return 1;
+    }
+    int threads = config.threads > 0 ? config.threads : std::max(1, (int)std::thread::hardware_concurrency());
+    threads = std::min(threads, (int)files.size());
+
+    auto start = std::chrono::steady_clock::now();
+    ConvertStats stats;
+    std::atomic<size_t> next_file{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            std::vector<PackedPosition> chunk;
+            chunk.reserve(CHUNK_POSITIONS);
+            size_t file;
+            while ((file = next_file++) < files.size()) {
+                convert_file(files[file], config, writer, stats, chunk);
+            }
+            writer.write(chunk);
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Converted " << stats.games << " games from " << files.size() << " files into "
+              << writer.positions_written() << " positions in " << seconds << " s ("
+              << stats.bytes / 1e6 / std::max(seconds, 1e-9) << " MB/s)" << std::endl;
+    if (stats.cut_games > 0) {
+        std::cout << stats.cut_games << " games had a FEN tag or a move that couldn't be read, they were cut off there" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef ATTACK_TABLES_H
+#define ATTACK_TABLES_H
+
+#include <array>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Squares attacked by knights, kings and pawns from every square, and the lines sliding
+// pieces move along, built at compile time.
+// Squares are numbered row * 8 + col, with row 0 being the 8th rank like the board array
+
+inline constexpr int square_of(int row, int col) {
+    return row * 8 + col;
+}
+
+inline constexpr uint64_t square_bit(int row, int col) {
+    return uint64_t(1) << square_of(row, col);
+}
+
+// Number of squares in a set
+inline int square_count(uint64_t squares) {
+#if defined(_MSC_VER)
+    return (int)__popcnt64(squares);
+#else
+    return __builtin_popcountll(squares);
+#endif
+}
+
+// The squares a piece attacks from one square, as a bitset and as a list.
+// The list keeps the order of the offsets it was built from, so moves come out as they used to
+struct SquareAttacks {
+    uint64_t mask = 0;
+    uint8_t size = 0;
+    uint8_t squares[8] = {};
+};
+
+template <int N>
+constexpr std::array<SquareAttacks, 64> make_attack_table(const int (&offsets)[N][2]) {
+    std::array<SquareAttacks, 64> table{};
+    for (int square = 0; square < 64; square++) {
+        SquareAttacks &attacks = table[square];
+        for (int i = 0; i < N; i++) {
+            int row = square / 8 + offsets[i][0];
+            int col = square % 8 + offsets[i][1];
+            if (row >= 0 && row < 8 && col >= 0 && col < 8) {
+                attacks.mask |= square_bit(row, col);
+                attacks.squares[attacks.size++] = (uint8_t)square_of(row, col);
+            }
+        }
+    }
+    return table;
+}
+
+constexpr int KNIGHT_OFFSETS[8][2] = {{2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}};
+constexpr int KING_OFFSETS[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+// White pawns move up the board (towards row 0), black pawns down
+constexpr int WHITE_PAWN_OFFSETS[2][2] = {{-1, 1}, {-1, -1}};
+constexpr int BLACK_PAWN_OFFSETS[2][2] = {{1, 1}, {1, -1}};
+
+constexpr std::array<SquareAttacks, 64> KNIGHT_ATTACKS = make_attack_table(KNIGHT_OFFSETS);
+constexpr std::array<SquareAttacks, 64> KING_ATTACKS = make_attack_table(KING_OFFSETS);
+// Squares a pawn attacks, [0] = white, [1] = black.
+// A square is attacked by the pawns of a side from the squares in the other side's table
+constexpr std::array<std::array<SquareAttacks, 64>, 2> PAWN_ATTACKS = {
+    make_attack_table(WHITE_PAWN_OFFSETS), make_attack_table(BLACK_PAWN_OFFSETS)};
+
+// The squares along each line out of a square, nearest first, in the directions of KING_OFFSETS.
+// The first four lines are the straight ones, the last four the diagonals
+struct Ray {
+    uint8_t size = 0;
+    uint8_t squares[7] = {};
+};
+
+constexpr std::array<std::array<Ray, 8>, 64> make_ray_table() {
+    std::array<std::array<Ray, 8>, 64> table{};
+    for (int square = 0; square < 64; square++) {
+        for (int d = 0; d < 8; d++) {
+            Ray &ray = table[square][d];
+            for (int row = square / 8 + KING_OFFSETS[d][0], col = square % 8 + KING_OFFSETS[d][1];
+                 row >= 0 && row < 8 && col >= 0 && col < 8; row += KING_OFFSETS[d][0], col += KING_OFFSETS[d][1]) {
+                ray.squares[ray.size++] = (uint8_t)square_of(row, col);
+            }
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::array<Ray, 8>, 64> RAYS = make_ray_table();
+
+static_assert(KNIGHT_ATTACKS[0].size == 2 && KNIGHT_ATTACKS[square_of(3, 3)].size == 8, "knight table");
+static_assert(KING_ATTACKS[63].size == 3 && KING_ATTACKS[square_of(4, 4)].size == 8, "king table");
+static_assert(PAWN_ATTACKS[0][square_of(6, 0)].mask == square_bit(5, 1), "pawn table");
+static_assert(RAYS[0][0].size == 7 && RAYS[0][1].size == 0 && RAYS[square_of(3, 3)][4].size == 4, "ray table");
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <board_representation.h>
+#include <search_algorithm.h>
+
+// Depth the bench command searches every position to
+const int BENCH_DEPTH = 5;
+
+// Fixed positions for benchmarks and profile guided builds
+const std::vector<std::string> BENCH_POSITIONS = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "rnbqkb1r/pppppppp/5n2/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 0 1",
+    "r1b1kb1r/3npppp/p1p5/2N3B1/4P1n1/8/PPP2PPP/R3K1NR w KQkq - 0 1",
+    "r3kb1r/3bp1pp/p1P5/8/6q1/8/PPP2PP1/1K4NR b kq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N2N2/PP2BPPP/R2QKB1R w KQ - 0 1",
+    "8/5pk1/6p1/3R4/6P1/5K2/r7/8 w - - 0 1",
+};
+
+// Search every bench position from a cold hash table to a fixed depth.
+// The total node count only changes when the search changes, so it works as a
+// signature of the search, and nodes per second measures the build
+uint64_t run_bench(int depth) {
+    uint64_t total_nodes = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < BENCH_POSITIONS.size(); i++) {
+        SearchState state;
+        state.print_progress = false;
+        state.max_depth = depth;
+        Board board(BENCH_POSITIONS[i]);
+        MiniMaxResult result = iterative_minimax(&board, board.current_player == 1, state);
+        uint64_t nodes = state.stats.nodes.get();
+        total_nodes += nodes;
+        std::cout << "Position " << i + 1 << "/" << BENCH_POSITIONS.size() << ": " << BENCH_POSITIONS[i]
+                  << " | Best move: " << move_to_string(result.move) << " | Nodes: " << nodes << std::endl;
+    }
+
+    int64_t time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "===========================" << std::endl;
+    std::cout << "Total time (ms) : " << time_ms << std::endl;
+    std::cout << "Nodes searched  : " << total_nodes << std::endl;
+    std::cout << "Nodes/second    : " << total_nodes * 1000 / (time_ms > 0 ? time_ms : 1) << std::endl;
+    return total_nodes;
+}
+
+#endif
@@ -1,14 +1,87 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <cstdlib>
 #include <eval_values.h>
 #include <eval_functions.h>
 #include <cmath>
 #include <vector>
 #include <array>
+#include <cstdint>
+#include <zobrist.h>
+#include <attack_tables.h>
+#include <trace.h>
+
+// Most moves a position can have, sizes the move lists
+const int MAX_MOVES = 256;
+// Most moves that can be made on a Board without being undone. The history is a fixed
+// array, making one more move stops the program (see make_move), so callers that play
+// whole games have to stop short of it and leave room for a search
+const int MAX_HISTORY = 512;
+// Buffer size write_fen needs, the longest FEN plus the terminating zero
+const int MAX_FEN_LENGTH = 128;
+
+// Piece number of every FEN character, 0 for the ones that aren't pieces
+constexpr std::array<int8_t, 256> make_fen_piece_table() {
+    std::array<int8_t, 256> table{};
+    const char letters[] = "PRNBKQ";
+    for (int i = 0; i < 6; i++) {
+        table[(unsigned char)letters[i]] = (int8_t)(i + 1);
+        table[(unsigned char)(letters[i] - 'A' + 'a')] = (int8_t)-(i + 1);
+    }
+    return table;
+}
+constexpr std::array<int8_t, 256> FEN_PIECES = make_fen_piece_table();
+
+// FEN character of every piece, by piece + 6
+constexpr char FEN_CHARS[13] = {'q', 'k', 'b', 'n', 'r', 'p', '.', 'P', 'R', 'N', 'B', 'K', 'Q'};
+
+// Which moves a generator should produce
+enum GenType {
+    GEN_ALL,
+    GEN_CAPTURES, // Moves onto an enemy piece, and en passant
+    GEN_QUIETS    // Moves onto an empty square, castling included
+};
+
+// Side to move as a compile time constant for the templated move generation, make/unmake
+// and search. The values are the usual 1 and -1, so a piece of a side is side * piece number
+enum Color {
+    WHITE = 1,
+    BLACK = -1
+};
+
+constexpr Color operator~(Color color) {
+    return Color(-color);
+}
+
+// Fixed size move list, so generating moves never allocates
+struct MoveList {
+    std::array<std::array<int, 4>, MAX_MOVES> moves;
+    int size = 0;
+
+    void push_back(const std::array<int, 4> &move){
+        moves[size++] = move;
+    }
+    void clear(){
+        size = 0;
+    }
+    bool empty() const{
+        return size == 0;
+    }
+    std::array<int, 4> &operator[](int i){
+        return moves[i];
+    }
+    std::array<int, 4> *begin(){
+        return moves.data();
+    }
+    std::array<int, 4> *end(){
+        return moves.data() + size;
+    }
+};
 
 class Board
 {
@@ -20,9 +93,12 @@ private:
 
     int king_pos[2][2] = {{7, 4}, {0, 4}}; // [0] = white, [1] = black
     bool game_over = false;
+    int halfmove_clock = 0; // Half moves since the last capture or pawn move
+    int fullmove_number = 1; // Goes up after every black move
 
 
     std::array<std::array<int, 8>, 8> board;
+    uint64_t hash = 0; // Zobrist hash of the pieces, castling rights and en passant, not the side to move
 
     // Struct for moves
     struct ChessMove {
@@ -32,81 +108,83 @@ private:
         int to_col;
         int captured_piece;
         int old_passant[2];
-        bool old_castle[2];
+        bool old_castle[4]; // White queen-, king-side, black queen-, king-side
         bool did_castle[2];
+        bool passant_capture;
+        bool promotion;
+        uint64_t old_hash; // Also the hash stack used to find repetitions
+        int old_halfmove_clock;
     };
-    // Move history
-    std::vector<ChessMove> move_history;
+    // Move history, a fixed size stack so making moves never allocates
+    std::array<ChessMove, MAX_HISTORY> move_history;
+    int history_size = 0;
 
     // Function that resets the board
     void reset_board(){
         board.fill({0, 0, 0, 0, 0, 0, 0, 0});
         pieces_alive = 0;
+        history_size = 0;
+        halfmove_clock = 0;
+        fullmove_number = 1;
+        en_passant[0] = -1;
+        en_passant[1] = -1;
+        white_castle[0] = white_castle[1] = false;
+        black_castle[0] = black_castle[1] = false;
     }
 
-    // Funtion that sets the board, given a FEN string
-    void set_board(std::string FEN){
-        // Fill the board with zeroes
-        reset_board();
+    // The castling rights as one number, for hashing
+    int castle_index(){
+        return white_castle[0] | (white_castle[1] << 1) | (black_castle[0] << 2) | (black_castle[1] << 3);
+    }
 
-        // Initiate loop values
-        int row = 0;
-        int col = 0;
-        int space_pos = FEN.find(" ");
-        // loop through the FEN string
-        for(int i=0; i < space_pos; i++){
-            char value = FEN[i];
-            // Incase it's a new section
-            if(value == '/'){
-                col = 0;
-                row++;
-                continue;
-            }
+    // Hash of the castling rights and en passant square
+    uint64_t state_hash(){
+        uint64_t key = ZOBRIST.castle[castle_index()];
+        if (en_passant[0] != -1) {
+            key ^= ZOBRIST.en_passant[en_passant[1]];
+        }
+        return key;
+    }
 
-            if (isdigit(value)){
-                // if it's a number we update the col value
-                col += value - '0' - 1;
-            }else{
-                board[row][col] = piece_to_number.at(value);
-                pieces_alive++;
+    // Hash the whole position from scratch
+    uint64_t compute_hash(){
+        uint64_t key = state_hash();
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++) {
+                key ^= ZOBRIST.pieces[board[row][col] + 6][row * 8 + col];
             }
-            col++;
-        }
-        // Then check for current player
-        if(FEN[space_pos+1] == 'w'){
-            current_player = 1;
-        }else{
-            current_player = -1;
         }
+        return key;
+    }
 
-        // Check for castling rights
-        for(int i=space_pos+2; i < FEN.find(" ", space_pos+3); i++){
-            char value = FEN[i];
-            // If there's a minus there are no castling rights
-            switch(value){
-                case '-':
-                    break;
-                case 'K':
-                    white_castle[1] = true;
-                    break;
-                case 'Q':
-                    white_castle[0] = true;
-                    break;
-                case 'k':
-                    black_castle[1] = true;
-                    break;
-                case 'q':
-                    black_castle[0] = true;
-                    break;
-            }
+    // Change a square and keep the hash up to date
+    void set_square(int row, int col, int piece){
+        hash ^= ZOBRIST.pieces[board[row][col] + 6][row * 8 + col] ^ ZOBRIST.pieces[piece + 6][row * 8 + col];
+        board[row][col] = piece;
+    }
+
+    // Read a number of at most max_digits digits at fen[i], false if there is none
+    static bool parse_counter(std::string_view fen, size_t &i, int max_digits, int &value){
+        size_t start = i;
+        value = 0;
+        while (i < fen.size() && fen[i] >= '0' && fen[i] <= '9' && (int)(i - start) < max_digits) {
+            value = value * 10 + (fen[i++] - '0');
         }
-        space_pos = FEN.find(" ", space_pos+3);
+        return i > start && (i == fen.size() || fen[i] == ' ');
+    }
 
-        // possible en passant
-        if(FEN[space_pos+1] != '-'){ // In case there are no passants
-            en_passant[0] = ALPHATOCOLS.at(FEN[space_pos+1]);
-            en_passant[1] = FEN[space_pos+2] - '0'; // Convert to an integer
+    // Write a positive number at out, returns the character after it
+    static char *write_number(char *out, int value){
+        char digits[12];
+        int count = 0;
+        do {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            *out++ = digits[--count];
         }
+        return out;
     }
 
     // Function that checks for enemies at a given position
@@ -141,191 +219,27 @@ private:
         }
     }
 
-    // Function to check if the move results in a checkmate
+    // Function to check if the move leaves our king in check
+    template<Color Us>
     bool is_check(int start_row, int start_col, int end_row, int end_col){
-        // Retrieve the side
-        int side = board[start_row][start_col] > 0 ? 1 : -1;
-        
-        // Move the piece
-        move_piece(start_row, start_col, end_row, end_col);
-
-        // Get the king position
-        int king_row;
-        int king_col;
-        if (std::abs(board[end_row][end_col]) == 5){ // If the piece is a king
-            king_row = end_row;
-            king_col = end_col;
-        }else if (side == 1){ // If the piece is white
-            king_row = king_pos[0][0];
-            king_col = king_pos[0][1];
-        }else{ // If the piece is black
-            king_row = king_pos[1][0];
-            king_col = king_pos[1][1];
-        }
-
-        // Check straight lines for Rooks or Queens
-        for (int i = 1; king_row + i < 8; i++) {
-                int pos = board[king_row + i][king_col];
-                if(pos != 0){
-                    // check if the found piece is an enemy rook or queen
-                    if(pos == -1*side*2 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                        // If it is, the king is in check
-                        undo_move();
-                        return true;
-                    }else{
-                        // If it's not, there's no check
-                        break;
-                    }
-                }
-            }
-        // Check below
-        for (int i = 1; king_row - i >= 0; i++) {
-            int pos = board[king_row - i][king_col];
-            if(pos != 0){
-                // check if the found piece is an enemy rook or queen
-                if(pos == -1*side*2 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }else{
-                    // If it's not, there's no check
-                    break;
-                }
-            }
-        }
-
-        // check right
-        for (int i = 1; king_col + i < 8; i++) {
-            int pos = board[king_row][king_col + i];
-            if(pos != 0){
-                // check if the found piece is an enemy rook or queen
-                if(pos == -1*side*2 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }else{
-                    // If it's not, there's no check
-                    break;
-                }
-            }
-        }
-        // check left
-        for (int i = 1; king_col - i >= 0; i++) {
-            int pos = board[king_row][king_col - i];
-            if(pos != 0){
-                // check if the found piece is an enemy rook or queen
-                if(pos == -1*side*2 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }else{
-                    // If it's not, there's no check
-                    break;
-                }
-            }
-        }
-
-        // Check diagonal lines for Bishops or Queens
-        for (int i = 1; king_row - i >= 0 && king_col - i >= 0; i++) {
-            int pos = board[king_row - i][king_col - i];
-            if(pos != 0){
-                // check if the found piece is an enemy rook or queen
-                if(pos == -1*side*4 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }else{
-                    // If it's not, there's no check
-                    break;
-                }
-            }
-        }
-        for (int i = 1; king_row + i < 8 && king_col + i < 8; i++) {
-            int pos = board[king_row + i][king_col + i];
-            if(pos != 0){
-            // check if the found piece is an enemy rook or queen
-                if(pos == -1*side*4 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }else{
-                    // If it's not, there's no check
-                    break;
-                }
-            }
-        }
-
-        // check diagonal from top right to bottom left
-        for (int i = 1; king_row - i >= 0 && king_col + i < 8; i++) {
-            int pos = board[king_row - i][king_col + i];
-            if(pos != 0){
-                // check if the found piece is an enemy rook or queen
-                if(pos == -1*side*4 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }else{
-                    // If it's not, there's no check
-                    break;
-                }
-            }
-        }
-        for (int i = 1; king_row + i < 8 && king_col - i >= 0; i++) {
-            int pos = board[king_row + i][king_col - i];
-            if(pos != 0){
-                // check if the found piece is an enemy rook or queen
-                if(pos == -1*side*4 || pos == -1*side*6 || (i == 1 && pos == -1*side*5)){ // first position can be a king
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }else{
-                    // If it's not, there's no check
-                    break;
-                }
-            }
-        }
-
-        // Check for knights
-        int knight_moves[8][2] = {{king_row+2, king_col+1}, {king_row+2, king_col-1}, {king_row-2, king_col+1}, {king_row-2, king_col-1}, {king_row+1, king_col+2}, {king_row+1, king_col-2}, {king_row-1, king_col+2}, {king_row-1, king_col-2}};
-        for (int i = 0; i < 8; i++) {
-            int row = knight_moves[i][0];
-            int col = knight_moves[i][1];
-            if(row >= 0 && row < 8 && col >= 0 && col < 8){
-                int pos = board[row][col];
-                if(pos == -1*side*3){
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }
-            }
-        }
-
-        // Check for pawns
-        int pawn_moves[2][2] = {{king_row+(-1*side), king_col+1}, {king_row+(-1*side), king_col-1}};
-        for (int i = 0; i < 2; i++) {
-            int row = pawn_moves[i][0];
-            int col = pawn_moves[i][1];
-            if(row >= 0 && row < 8 && col >= 0 && col < 8){
-                int pos = board[row][col];
-                if(pos == -1*side){
-                    // If it is, the king is in check
-                    undo_move();
-                    return true;
-                }
-            }
-        }
-        // If nothing checks the king, return false
-        undo_move();
-        return false;
+        TRACE_SCOPE("is_check");
+        // Move the piece, the king position is updated if the king moves
+        make_move<Us>(start_row, start_col, end_row, end_col);
+        bool check = in_check<Us>();
+        unmake_move<Us>();
+        return check;
     }
 
     // Function to check possible moves -> Rook, Bishop and Queen
-    std::vector<std::array<int, 4>> general_move_calc(int p_row, int p_col, bool move_diagonal, bool move_straight){
-        // Get the piece we are checking
-        int piece = board[p_row][p_col];
-        // Output vector
-        std::vector<std::array<int, 4>> moves;
+    // Add a move if it is of the kind being generated
+    void add_move(MoveList &moves, GenType gen, bool capture, int p_row, int p_col, int row, int col){
+        if (gen == GEN_ALL || capture == (gen == GEN_CAPTURES)) {
+            moves.push_back({p_row, p_col, row, col});
+        }
+    }
 
+    template<Color Us>
+    void general_move_calc(int p_row, int p_col, bool move_diagonal, bool move_straight, MoveList &moves, GenType gen){
         // Check diagonal moves
         if(move_diagonal){
             // check diagonal from top left to bottom right
@@ -333,13 +247,13 @@ private:
                 int pos = board[p_row - i][p_col - i];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row - i, p_col - i});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row - i, p_col - i);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row - i, p_col - i});
+                    add_move(moves, gen, true, p_row, p_col, p_row - i, p_col - i);
                     break;
                 }
             }
@@ -347,13 +261,13 @@ private:
                 int pos = board[p_row + i][p_col + i];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row + i, p_col + i});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row + i, p_col + i);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row + i, p_col + i});
+                    add_move(moves, gen, true, p_row, p_col, p_row + i, p_col + i);
                     break;
                 }
             }
@@ -363,13 +277,13 @@ private:
                 int pos = board[p_row - i][p_col + i];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row - i, p_col + i});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row - i, p_col + i);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row - i, p_col + i});
+                    add_move(moves, gen, true, p_row, p_col, p_row - i, p_col + i);
                     break;
                 }
             }
@@ -377,13 +291,13 @@ private:
                 int pos = board[p_row + i][p_col - i];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row + i, p_col - i});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row + i, p_col - i);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row + i, p_col - i});
+                    add_move(moves, gen, true, p_row, p_col, p_row + i, p_col - i);
                     break;
                 }
             }
@@ -395,13 +309,13 @@ private:
                 int pos = board[p_row + i][p_col];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row + i, p_col});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row + i, p_col);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row + i, p_col});
+                    add_move(moves, gen, true, p_row, p_col, p_row + i, p_col);
                     break;
                 }
             }
@@ -410,13 +324,13 @@ private:
                 int pos = board[p_row - i][p_col];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row - i, p_col});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row - i, p_col);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row - i, p_col});
+                    add_move(moves, gen, true, p_row, p_col, p_row - i, p_col);
                     break;
                 }
             }
@@ -426,13 +340,13 @@ private:
                 int pos = board[p_row][p_col + i];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row, p_col + i});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row, p_col + i);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row, p_col + i});
+                    add_move(moves, gen, true, p_row, p_col, p_row, p_col + i);
                     break;
                 }
             }
@@ -441,174 +355,148 @@ private:
                 int pos = board[p_row][p_col - i];
                 if (pos == 0) {
                     // save the possible move
-                    moves.push_back({p_row, p_col, p_row, p_col - i});
-                }else if((pos > 0) == (piece > 0)){
+                    add_move(moves, gen, false, p_row, p_col, p_row, p_col - i);
+                }else if(pos * Us > 0){
                     // If the piece is the same color as the side there's an ally
                     break;
                 }else{
                     // If the piece is the not same color as the side there's an enemy
-                    moves.push_back({p_row, p_col, p_row, p_col - i});
+                    add_move(moves, gen, true, p_row, p_col, p_row, p_col - i);
                     break;
                 }
             }
         }
-       return moves;
     }
 
     // Function to check for pawn moves
-    std::vector<std::array<int, 4>> pawn_move_calc(int p_row, int p_col){
-        int piece = board[p_row][p_col];
-        int direction = -1*piece;
-        // output vector
-        std::vector<std::array<int, 4>> moves;
+    template<Color Us>
+    void pawn_move_calc(int p_row, int p_col, MoveList &moves, GenType gen){
+        constexpr int direction = -Us; // White moves up the rows, towards row 0
+        constexpr int start_row = Us == WHITE ? 6 : 1;
         // Check for blocking pieces
         if (p_row + direction < 8 && p_row + direction >= 0) {
             if (board[p_row + direction][p_col] == 0) {
                 // If the space is free the piece can move there
-                moves.push_back({p_row, p_col, p_row + direction, p_col});
+                add_move(moves, gen, false, p_row, p_col, p_row + direction, p_col);
                 // if we are at the starting position we can move two spaces
-                if ((p_row == 6 && piece == 1) || (p_row == 1 && piece == -1)) {
+                if (p_row == start_row) {
                     if (board[p_row + direction*2][p_col] == 0) {
-                        moves.push_back({p_row, p_col, p_row + direction*2, p_col});
+                        add_move(moves, gen, false, p_row, p_col, p_row + direction*2, p_col);
                     }
                 }
             }
         }
         // Check for capturing pieces
-        if (p_row + direction < 8 && p_row + direction >= 0) {
-            if (p_col + 1 < 8) {
-                if (has_enemy(p_row + direction, p_col + 1, piece)){
-                    // If there is an enemy we can capture it
-                    moves.push_back({p_row, p_col, p_row + direction, p_col + 1});
-                }
-            }
-            if (p_col - 1 >= 0) {
-                if (has_enemy(p_row + direction, p_col - 1, piece)) {
-                    // If there is an enemy we can capture it
-                    moves.push_back({p_row, p_col, p_row + direction, p_col - 1});
-                }
+        const SquareAttacks &attacks = PAWN_ATTACKS[Us == WHITE ? 0 : 1][square_of(p_row, p_col)];
+        for (int i = 0; i < attacks.size; i++) {
+            int row = attacks.squares[i] / 8;
+            int col = attacks.squares[i] % 8;
+            if (board[row][col] * Us < 0) {
+                // If there is an enemy we can capture it
+                add_move(moves, gen, true, p_row, p_col, row, col);
             }
         }
 
-        // Check for en passant
-        if(en_passant[0] != -1){
-            // Check if the pawn is in the correct position
-            int possible_pos[4] = {en_passant[0]+direction, en_passant[1]-1, en_passant[0]+direction, en_passant[1]+1};
-            if ((p_row == possible_pos[0] && p_col == possible_pos[1]) || (p_row == possible_pos[2] && p_col == possible_pos[3])) {
-                    // If the pawn is in the correct row and column we can capture it
-                    moves.push_back({p_row, p_col, en_passant[0], en_passant[1]});
-            }
+        // Check for en passant, the pawn has to attack the square behind the pawn that moved
+        if (en_passant[0] != -1 && (attacks.mask & square_bit(en_passant[0], en_passant[1]))) {
+            add_move(moves, gen, true, p_row, p_col, en_passant[0], en_passant[1]);
         }
-        return moves;
     }
-    // Function to check for knight moves
-    std::vector<std::array<int, 4>> knight_move_calc(int p_row, int p_col){
-        int piece = board[p_row][p_col];
-        int side = piece > 0 ? 1 : -1;
-
-        // output vector
-        std::vector<std::array<int, 4>> moves;
-
-        // Check for all possible moves
-        int possible_pos[8][2] = {{p_row+2, p_col+1}, {p_row+2, p_col-1}, {p_row-2, p_col+1}, {p_row-2, p_col-1}, {p_row+1, p_col+2}, {p_row+1, p_col-2}, {p_row-1, p_col+2}, {p_row-1, p_col-2}};
-        for (int i = 0; i < 8; i++) {
-            if (possible_pos[i][0] < 8 && possible_pos[i][0] >= 0 && possible_pos[i][1] < 8 && possible_pos[i][1] >= 0) {
-                if (board[possible_pos[i][0]][possible_pos[i][1]] == 0 || has_enemy(possible_pos[i][0], possible_pos[i][1], side)) {
-                    // If the space is free or has an enemy we can move there
-                    moves.push_back({p_row, p_col, possible_pos[i][0], possible_pos[i][1]});
-                }
+    // Add the moves of a knight or king to the squares in its attack table
+    template<Color Us>
+    void leaper_move_calc(int p_row, int p_col, const SquareAttacks &targets, MoveList &moves, GenType gen){
+        for (int i = 0; i < targets.size; i++) {
+            int row = targets.squares[i] / 8;
+            int col = targets.squares[i] % 8;
+            int target = board[row][col];
+            // If the space is free or has an enemy we can move there
+            if (target * Us <= 0) {
+                add_move(moves, gen, target != 0, p_row, p_col, row, col);
             }
         }
-        return moves;
+    }
+    // Function to check for knight moves
+    template<Color Us>
+    void knight_move_calc(int p_row, int p_col, MoveList &moves, GenType gen){
+        leaper_move_calc<Us>(p_row, p_col, KNIGHT_ATTACKS[square_of(p_row, p_col)], moves, gen);
     }
     // Function to check for King moves
-    std::vector<std::array<int, 4>> king_move_calc(int p_row, int p_col){
-        int piece = board[p_row][p_col];
-        int side = piece > 0 ? 1 : -1;
-
-        // output vector
-        std::vector<std::array<int, 4>> moves;
-
-        // Check for all possible moves
-        int possible_pos[8][2] = {{p_row+1, p_col}, {p_row-1, p_col}, {p_row, p_col+1}, {p_row, p_col-1}, {p_row+1, p_col+1}, {p_row+1, p_col-1}, {p_row-1, p_col+1}, {p_row-1, p_col-1}};
-        for (int i = 0; i < 8; i++) {
-            if (possible_pos[i][0] < 8 && possible_pos[i][0] >= 0 && possible_pos[i][1] < 8 && possible_pos[i][1] >= 0) {
-                if (board[possible_pos[i][0]][possible_pos[i][1]] == 0 || has_enemy(possible_pos[i][0], possible_pos[i][1], side)) {
-                    // If the space is free or has an enemy we can move there
-                    moves.push_back({p_row, p_col, possible_pos[i][0], possible_pos[i][1]});
-                }
-            }
+    template<Color Us>
+    void king_move_calc(int p_row, int p_col, MoveList &moves, GenType gen){
+        leaper_move_calc<Us>(p_row, p_col, KING_ATTACKS[square_of(p_row, p_col)], moves, gen);
+        // Check for castling, the king can't castle out of or through check
+        // (landing in check is caught like for any other move)
+        bool *castle = Us == WHITE ? white_castle : black_castle;
+        constexpr int home_row = Us == WHITE ? 7 : 0;
+        if (castle[0] && board[home_row][1] == 0 && board[home_row][2] == 0 && board[home_row][3] == 0 &&
+            !square_attacked<~Us>(p_row, p_col) && !square_attacked<~Us>(p_row, p_col-1)) {
+            add_move(moves, gen, false, p_row, p_col, p_row, p_col-2);
         }
-        // Check for castling
-        if (side == 1) {
-            // Check for white castling and if the king is being blocked
-            if (white_castle[0] && board[7][1] == 0 && board[7][2] == 0 && board[7][3] == 0) {
-                // Move the position back if possible
-                moves.push_back({p_row, p_col, p_row, p_col-2});
-            }
-            if (white_castle[1] && board[7][5] == 0 && board[7][6] == 0) {
-                // Check if the king and rook are being blocked
-                moves.push_back({p_row, p_col, p_row, p_col+2});
-            }
-        }else{
-            // Check for white castling and if the king is being blocked
-            if (black_castle[0] && board[0][1] == 0 && board[0][2] == 0 && board[0][3] == 0) {
-                // Move the position back if possible
-                moves.push_back({p_row, p_col, p_row, p_col-2});
-            }
-            if (black_castle[1] && board[0][5] == 0 && board[0][6] == 0) {
-                // Check if the king and rook are being blocked
-                moves.push_back({p_row, p_col, p_row, p_col+2});
-            }
+        if (castle[1] && board[home_row][5] == 0 && board[home_row][6] == 0 &&
+            !square_attacked<~Us>(p_row, p_col) && !square_attacked<~Us>(p_row, p_col+1)) {
+            add_move(moves, gen, false, p_row, p_col, p_row, p_col+2);
         }
-        return moves;
     }
 
-    // Function to get valid moves for a piece
-    std::vector<std::array<int, 4>> get_valid_moves(int p_row, int p_col){
-        int piece = board[p_row][p_col];
-        std::vector<std::array<int, 4>> moves;
+    // Function to get valid moves for a piece, they are added to the end of moves.
+    // Without legal the moves are only pseudo legal, they may leave the king in check
+    // The piece has to be one of Us
+    template<Color Us>
+    void get_valid_moves(int p_row, int p_col, MoveList &moves, GenType gen = GEN_ALL, bool legal = true){
+        TRACE_SCOPE("get_valid_moves");
+        int first = moves.size;
 
         // Check for the piece type
-        switch (std::abs(piece)) {
+        switch (board[p_row][p_col] * Us) {
             case 1:
                 // Pawn
-                moves = pawn_move_calc(p_row, p_col);
+                pawn_move_calc<Us>(p_row, p_col, moves, gen);
                 break;
             case 2:
                 // Rook
-                moves = general_move_calc(p_row, p_col, 0, 1);
+                general_move_calc<Us>(p_row, p_col, 0, 1, moves, gen);
                 break;
             case 3:
                 // Knight
-                moves = knight_move_calc(p_row, p_col);
+                knight_move_calc<Us>(p_row, p_col, moves, gen);
                 break;
             case 4:
                 // Bishop
-                moves = general_move_calc(p_row, p_col, 1, 0);
+                general_move_calc<Us>(p_row, p_col, 1, 0, moves, gen);
                 break;
             case 6:
                 // Queen
-                moves = general_move_calc(p_row, p_col, 1, 1);
+                general_move_calc<Us>(p_row, p_col, 1, 1, moves, gen);
                 break;
             case 5:
                 // King
-                moves = king_move_calc(p_row, p_col);
+                king_move_calc<Us>(p_row, p_col, moves, gen);
                 break;
             default:
-                // If the piece is not valid return an empty vector
-                return moves;
+                // If the piece is not valid there are no moves
+                return;
         }
-        // check the moves for checks
-        for (int i = 0; i < moves.size(); i++) {
-            // Check if the move is valid
-            if (is_check(moves[i][0], moves[i][1], moves[i][2], moves[i][3])) {
-                // If the move is not valid remove it from the list
-                moves.erase(moves.begin() + i);
-                i--;
+        if (!legal) {
+            return;
+        }
+        // check the moves for checks, the valid ones are kept in order
+        int kept = first;
+        for (int i = first; i < moves.size; i++) {
+            if (!is_check<Us>(moves[i][0], moves[i][1], moves[i][2], moves[i][3])) {
+                moves[kept++] = moves[i];
             }
         }
-        return moves;
+        moves.size = kept;
+    }
+
+    // The same for a piece of either side
+    void get_valid_moves(int p_row, int p_col, MoveList &moves, GenType gen = GEN_ALL, bool legal = true){
+        int piece = board[p_row][p_col];
+        if (piece > 0) {
+            get_valid_moves<WHITE>(p_row, p_col, moves, gen, legal);
+        } else if (piece < 0) {
+            get_valid_moves<BLACK>(p_row, p_col, moves, gen, legal);
+        }
     }
 
 public:
@@ -616,14 +504,19 @@ public:
     int current_player = 1; // 1 = white, -1 = black
     int pieces_alive = 32; // 32 pieces in total during the start of the game
 
-    // Function to undo a move
-    void undo_move(){
-        // Get the last move
-        ChessMove move = move_history.back();
-        // Remove the move from the history
-        move_history.pop_back();
+    // Function to undo a move, the last one made, which Us made
+    template<Color Us>
+    void unmake_move(){
+        TRACE_SCOPE("undo_move");
+        constexpr int home_row = Us == WHITE ? 7 : 0;
+        // Get the last move and remove it from the history
+        const ChessMove &move = move_history[--history_size];
         // Get the piece
         int piece = board[move.to_row][move.to_col];
+        // A promoted pawn goes back as a pawn
+        if (move.promotion) {
+            piece = Us;
+        }
         // Move the piece back
         board[move.from_row][move.from_col] = piece;
         // Remove the piece from the old position
@@ -631,151 +524,128 @@ public:
         if (move.captured_piece != 0) {
             pieces_alive++;
         }
+        // Put back a pawn taken en passant
+        if (move.passant_capture) {
+            board[move.from_row][move.to_col] = -Us;
+            pieces_alive++;
+        }
 
         // set back passant
         en_passant[0] = move.old_passant[0];
         en_passant[1] = move.old_passant[1];
         // set back castling
-        if (piece > 0) {
-            white_castle[0] = move.old_castle[0];
-            white_castle[1] = move.old_castle[1];
-            if(move.did_castle[0]) {
-                // Move the rook back
-                board[7][0] = 2;
-                board[7][3] = 0;
-            }else if(move.did_castle[1]){
-                // Move the rook back
-                board[7][7] = 2;
-                board[7][5] = 0;
-            }
-        }else{
-            black_castle[0] = move.old_castle[0];
-            black_castle[1] = move.old_castle[1];
-            if(move.did_castle[0]) {
-                // Move the rook back
-                board[0][0] = -2;
-                board[0][3] = 0;
-            }else if(move.did_castle[1]){
-                // Move the rook back
-                board[0][7] = -2;
-                board[0][5] = 0;
-            }
+        white_castle[0] = move.old_castle[0];
+        white_castle[1] = move.old_castle[1];
+        black_castle[0] = move.old_castle[2];
+        black_castle[1] = move.old_castle[3];
+        if(move.did_castle[0]) {
+            // Move the rook back
+            board[home_row][0] = 2*Us;
+            board[home_row][3] = 0;
+        }else if(move.did_castle[1]){
+            // Move the rook back
+            board[home_row][7] = 2*Us;
+            board[home_row][5] = 0;
         }
         // Set back king pos
-        if (piece == 5) {
-            king_pos[0][0] = move.from_row;
-            king_pos[0][1] = move.from_col;
-        }else if (piece == -5){
-            king_pos[1][0] = move.from_row;
-            king_pos[1][1] = move.from_col;
+        if (piece == 5*Us) {
+            king_pos[Us == WHITE ? 0 : 1][0] = move.from_row;
+            king_pos[Us == WHITE ? 0 : 1][1] = move.from_col;
+        }
+        hash = move.old_hash;
+        halfmove_clock = move.old_halfmove_clock;
+        if (Us == BLACK) {
+            fullmove_number--;
         }
         // Set back the game state if the king died
         game_over = false;
     }
 
-        // Function to move pieces
-    void move_piece(int start_row, int start_col, int end_row, int end_col){
+    // The same when the side isn't known, it is the side of the piece that moved
+    void undo_move(){
+        const ChessMove &move = move_history[history_size - 1];
+        if (board[move.to_row][move.to_col] > 0) {
+            unmake_move<WHITE>();
+        } else {
+            unmake_move<BLACK>();
+        }
+    }
+
+    // Function to move pieces, the piece has to be one of Us
+    template<Color Us>
+    void make_move(int start_row, int start_col, int end_row, int end_col){
+        TRACE_SCOPE("move_piece");
+        constexpr int home_row = Us == WHITE ? 7 : 0;
+        constexpr int their_home_row = Us == WHITE ? 0 : 7;
+        bool *castle = Us == WHITE ? white_castle : black_castle;
+        bool *their_castle = Us == WHITE ? black_castle : white_castle;
         // retrieve the piece
         int piece = board[start_row][start_col];
-        int sign = piece > 0 ? 1 : -1;
         bool did_castle[2] = {false, false};
+        bool passant_capture = false;
+        bool promotion = piece == Us && end_row == their_home_row;
         // values for saving last move
-        bool old_castle[2];
+        bool old_castle[4] = {white_castle[0], white_castle[1], black_castle[0], black_castle[1]};
         int old_passant[2] = {en_passant[0], en_passant[1]};
-        if(sign == 1){
-            old_castle[0] = white_castle[0];
-            old_castle[1] = white_castle[1];
-        }else{
-            old_castle[0] = black_castle[0];
-            old_castle[1] = black_castle[1];
-        }
+        uint64_t old_hash = hash;
+        // The castling and passant rights are hashed in again once they're updated
+        hash ^= state_hash();
 
         // Check if the piece is a pawn
-        if (std::abs(piece) == 1){
+        if (piece == Us){
+            // Check if we completed an en passant
+            if (end_row == old_passant[0] && end_col == old_passant[1] && start_col != end_col){
+                // Remove the piece
+                set_square(start_row, end_col, 0);
+                passant_capture = true;
+                pieces_alive--;
+            }
             // Check if the pawn is moving two steps and if there are enemies nearby
             if ((std::abs(start_row - end_row) == 2) &&
-                ((end_col <= 7 && board[end_row][end_col+1] == -1*piece) ||
-                (end_col >= 0 && board[end_row][end_col-1] == -1*piece))){
+                ((end_col < 7 && board[end_row][end_col+1] == -Us) ||
+                (end_col > 0 && board[end_row][end_col-1] == -Us))){
                     // Set the possible move for en passant
-                    en_passant[0] = end_row+piece;
+                    en_passant[0] = end_row + Us;
                     en_passant[1] = end_col;
                 }else{
                     // Else we reset the en passant
                     en_passant[0] = -1;
                     en_passant[1] = -1;
                 }
-            // Check if we completed an en passant instead
-            if (end_row == en_passant[0] && end_col == en_passant[1]){
-                // Remove the piece
-                board[start_row][end_col] = 0;
-            }
         }else{ // Incase we are not pawns we reset the passants
             en_passant[0] = -1;
             en_passant[1] = -1;
         }
 
-        // Check for Rook moves
-        if (std::abs(piece) == 2){
-            // Check if we are moving the white rook
-            if (sign == 1){
-                // Check if we are moving the left rook
-                if (start_col == 0){
-                    white_castle[0] = false;
-                }else if(start_col == 7){
-                    white_castle[1] = false;
-                }
-            }else{
-                // Check if we are moving the left rook
-                if (start_col == 0){
-                    black_castle[0] = false;
-                }else if(start_col == 7){
-                    black_castle[1] = false;
-                }
+        // Check for Rook moves, moving the left or right rook loses that castling
+        if (piece == 2*Us){
+            if (start_col == 0){
+                castle[0] = false;
+            }else if(start_col == 7){
+                castle[1] = false;
             }
         }
 
         // Check for King moves
-        if (std::abs(piece) == 5){
-            // Check if we are moving the white king
-            if (sign == 1){
-                if (white_castle[0] && end_col == 2){
-                    // Move the rook
-                    board[7][0] = 0;
-                    board[7][3] = 2;
-                    did_castle[0] = true;
-                }else if (white_castle[1] && end_col == 6){
-                    // Move the rook
-                    board[7][7] = 0;
-                    board[7][5] = 2;
-                    did_castle[1] = true;
-                }
-                // Set castling to false
-                white_castle[0] = false;
-                white_castle[1] = false;
-
-                // update the king position
-                king_pos[0][0] = end_row;
-                king_pos[0][1] = end_col;
-            }else{
-                if (black_castle[0] && end_col == 2){
-                    // Move the rook
-                    board[0][0] = 0;
-                    board[0][3] = -2;
-                    did_castle[0] = true;
-                }else if (black_castle[1] && end_col == 6){
-                    // Move the rook
-                    board[0][7] = 0;
-                    board[0][5] = -2;
-                    did_castle[1] = true;
-                }
-                // Set castling to false
-                black_castle[0] = false;
-                black_castle[1] = false;
-
-                // update the king position
-                king_pos[1][0] = end_row;
-                king_pos[1][1] = end_col;
+        if (piece == 5*Us){
+            if (castle[0] && end_col == 2){
+                // Move the rook
+                set_square(home_row, 0, 0);
+                set_square(home_row, 3, 2*Us);
+                did_castle[0] = true;
+            }else if (castle[1] && end_col == 6){
+                // Move the rook
+                set_square(home_row, 7, 0);
+                set_square(home_row, 5, 2*Us);
+                did_castle[1] = true;
             }
+            // Set castling to false
+            castle[0] = false;
+            castle[1] = false;
+
+            // update the king position
+            king_pos[Us == WHITE ? 0 : 1][0] = end_row;
+            king_pos[Us == WHITE ? 0 : 1][1] = end_col;
         }
         // Get the piece captued
         int captured_piece = board[end_row][end_col];
@@ -783,34 +653,258 @@ public:
         if (captured_piece != 0){
             pieces_alive--;
         }
+        // Taking a rook on its starting square also takes the castling right
+        if (captured_piece == -2*Us && end_row == their_home_row && (end_col == 0 || end_col == 7)){
+            their_castle[end_col == 0 ? 0 : 1] = false;
+        }
 
         // Set the game to over if the king is dead
-        if (captured_piece == 5 || captured_piece == -5){
+        if (captured_piece == -5*Us){
             game_over = true;
         }
 
-        // save the move
-        ChessMove move = {start_row, start_col, end_row, end_col, captured_piece, {old_passant[0], old_passant[1]}, {old_castle[0], old_castle[1]}, {did_castle[0], did_castle[1]}};
-        
-        move_history.push_back(move);
-        // Move the piece
-        board[end_row][end_col] = piece;
+        // save the move. A full history is a bug of the caller, writing past it would quietly
+        // corrupt the board, so it stops here whatever the build
+        if (history_size == MAX_HISTORY) {
+            std::cerr << "Board: more than " << MAX_HISTORY << " moves made without undoing them" << std::endl;
+            std::abort();
+        }
+        move_history[history_size++] = {start_row, start_col, end_row, end_col, captured_piece, {old_passant[0], old_passant[1]}, {old_castle[0], old_castle[1], old_castle[2], old_castle[3]}, {did_castle[0], did_castle[1]}, passant_capture, promotion, old_hash, halfmove_clock};
+
+        // Captures and pawn moves can't be undone, they restart the fifty move count
+        if (captured_piece != 0 || piece == Us) {
+            halfmove_clock = 0;
+        }else{
+            halfmove_clock++;
+        }
+        if (Us == BLACK) {
+            fullmove_number++;
+        }
+
+        // Move the piece, pawns reaching the last row always become queens
+        set_square(end_row, end_col, promotion ? 6*Us : piece);
         // Remove the piece from the old position
-        board[start_row][start_col] = 0;
+        set_square(start_row, start_col, 0);
+        hash ^= state_hash();
+    }
+
+    // The same for a piece of either side
+    void move_piece(int start_row, int start_col, int end_row, int end_col){
+        if (board[start_row][start_col] > 0) {
+            make_move<WHITE>(start_row, start_col, end_row, end_col);
+        } else {
+            make_move<BLACK>(start_row, start_col, end_row, end_col);
+        }
     }
     
-    // Get all the moves possible
-    std::vector<std::array<int, 4>> get_allmoves(int side){
-        std::vector<std::array<int, 4>> moves;
+    // Get all the moves possible, added to the end of moves
+    template<Color Us>
+    void generate_moves(MoveList &moves, GenType gen = GEN_ALL, bool legal = true){
         for (int i = 0; i < 8; i++) {
             for (int j = 0; j < 8; j++) {
-                if (board[i][j] != 0 && board[i][j] > 0 == side > 0) {
-                    std::vector<std::array<int, 4>> temp = get_valid_moves(i, j);
-                    moves.insert(moves.end(), temp.begin(), temp.end());
+                if (board[i][j] * Us > 0) {
+                    get_valid_moves<Us>(i, j, moves, gen, legal);
+                }
+            }
+        }
+    }
+
+    void generate_moves(int side, MoveList &moves, GenType gen = GEN_ALL, bool legal = true){
+        if (side > 0) {
+            generate_moves<WHITE>(moves, gen, legal);
+        } else {
+            generate_moves<BLACK>(moves, gen, legal);
+        }
+    }
+
+    // Get all the moves possible
+    std::vector<std::array<int, 4>> get_allmoves(int side){
+        MoveList moves;
+        generate_moves(side, moves);
+        return std::vector<std::array<int, 4>>(moves.begin(), moves.end());
+    }
+
+    // Check if a move (e.g. from the hash table) can be played by side, ignoring checks.
+    // Only the moves of the piece being moved are generated
+    bool is_pseudo_legal(int side, const std::array<int, 4> &move){
+        for (int i = 0; i < 4; i++) {
+            if (move[i] < 0 || move[i] > 7) {
+                return false;
+            }
+        }
+        int piece = board[move[0]][move[1]];
+        if (piece == 0 || (piece > 0) != (side > 0)) {
+            return false;
+        }
+        MoveList moves;
+        get_valid_moves(move[0], move[1], moves, GEN_ALL, false);
+        for (const std::array<int, 4> &m : moves) {
+            if (m == move) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Zobrist hash of the position with the given side to move
+    uint64_t get_hash(int side){
+        return side == 1 ? hash : hash ^ ZOBRIST.black_to_move;
+    }
+
+    // Check if the position has been on the board before, with the same side to move.
+    // Only positions since the last capture or pawn move can be the same
+    bool is_repetition(){
+        int oldest = std::max(0, history_size - halfmove_clock);
+        for (int i = history_size - 4; i >= oldest; i -= 2) {
+            if (move_history[i].old_hash == hash) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // No capture or pawn move for fifty moves each
+    bool is_fifty_move_draw(){
+        return halfmove_clock >= 100;
+    }
+
+    int get_halfmove_clock(){
+        return halfmove_clock;
+    }
+
+    int get_fullmove_number(){
+        return fullmove_number;
+    }
+
+    // Castling rights as bits: white queen-, king-side, black queen-, king-side
+    int get_castle_rights(){
+        return castle_index();
+    }
+
+    // Column a pawn can be taken en passant on, -1 if there is none
+    int get_en_passant_col(){
+        return en_passant[0] == -1 ? -1 : en_passant[1];
+    }
+
+    // Get the piece on a square
+    int piece_at(int row, int col){
+        return board[row][col];
+    }
+
+    // True if the piece stands on one of the squares
+    bool any_on(const SquareAttacks &squares, int piece){
+        for (int i = 0; i < squares.size; i++) {
+            if (board[squares.squares[i] / 8][squares.squares[i] % 8] == piece) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Set of the squares holding the piece
+    uint64_t pieces_on(const SquareAttacks &squares, int piece){
+        uint64_t found = 0;
+        for (int i = 0; i < squares.size; i++) {
+            if (board[squares.squares[i] / 8][squares.squares[i] % 8] == piece) {
+                found |= uint64_t(1) << squares.squares[i];
+            }
+        }
+        return found;
+    }
+
+    // First piece along a line from the square, as its square number, -1 if the line is empty
+    int first_on_ray(int row, int col, int row_step, int col_step){
+        for (int r = row + row_step, c = col + col_step; r >= 0 && r < 8 && c >= 0 && c < 8; r += row_step, c += col_step) {
+            if (board[r][c] != 0) {
+                return square_of(r, c);
+            }
+        }
+        return -1;
+    }
+
+    // Function to check if a square is attacked by the side Them
+    template<Color Them>
+    bool square_attacked(int row, int col){
+        int square = square_of(row, col);
+        // Knights, kings and pawns are looked up, a square is attacked by pawns from
+        // where a pawn of the other side would attack. The king is where king_pos says
+        const int *king = king_pos[Them == WHITE ? 0 : 1];
+        if ((KING_ATTACKS[square].mask & square_bit(king[0], king[1])) && board[king[0]][king[1]] == Them*5) {
+            return true;
+        }
+        if (any_on(KNIGHT_ATTACKS[square], Them*3) || any_on(PAWN_ATTACKS[Them == WHITE ? 1 : 0][square], Them)) {
+            return true;
+        }
+        // Straight lines, rooks or queens, then diagonal lines, bishops or queens
+        for (int d = 0; d < 8; d++) {
+            int slider = Them*(d < 4 ? 2 : 4);
+            for (int r = row + KING_OFFSETS[d][0], c = col + KING_OFFSETS[d][1]; r >= 0 && r < 8 && c >= 0 && c < 8;
+                 r += KING_OFFSETS[d][0], c += KING_OFFSETS[d][1]) {
+                int pos = board[r][c];
+                if (pos != 0) {
+                    if (pos == slider || pos == Them*6) {
+                        return true;
+                    }
+                    break;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool square_attacked(int row, int col, int by_side){
+        return by_side > 0 ? square_attacked<WHITE>(row, col) : square_attacked<BLACK>(row, col);
+    }
+
+    // Set of the squares with a piece of by_side that attacks the square
+    uint64_t attackers_to(int row, int col, int by_side){
+        int square = square_of(row, col);
+        uint64_t attackers = pieces_on(KNIGHT_ATTACKS[square], by_side*3) | pieces_on(KING_ATTACKS[square], by_side*5) |
+                             pieces_on(PAWN_ATTACKS[by_side == 1 ? 1 : 0][square], by_side);
+        for (int d = 0; d < 8; d++) {
+            int found = first_on_ray(row, col, KING_OFFSETS[d][0], KING_OFFSETS[d][1]);
+            if (found != -1) {
+                int pos = board[found / 8][found % 8];
+                if (pos == by_side*6 || pos == by_side*(d < 4 ? 2 : 4)) {
+                    attackers |= uint64_t(1) << found;
                 }
             }
         }
-        return moves;
+        return attackers;
+    }
+
+    // Check if the king of the given side is attacked
+    template<Color Us>
+    bool in_check(){
+        TRACE_SCOPE("in_check");
+        constexpr int color = Us == WHITE ? 0 : 1;
+        return square_attacked<~Us>(king_pos[color][0], king_pos[color][1]);
+    }
+
+    bool in_check(int side){
+        return side > 0 ? in_check<WHITE>() : in_check<BLACK>();
+    }
+
+    // Check if a move of Us would leave our king in check
+    template<Color Us>
+    bool move_leaves_check(int start_row, int start_col, int end_row, int end_col){
+        return is_check<Us>(start_row, start_col, end_row, end_col);
+    }
+
+    // The same for a move of either side
+    bool move_leaves_check(int start_row, int start_col, int end_row, int end_col){
+        if (board[start_row][start_col] > 0) {
+            return is_check<WHITE>(start_row, start_col, end_row, end_col);
+        }
+        return is_check<BLACK>(start_row, start_col, end_row, end_col);
+    }
+
+    // Copy out the king positions, [0] = white, [1] = black
+    void get_king_pos(int out[2][2]){
+        for (int i = 0; i < 2; i++) {
+            out[i][0] = king_pos[i][0];
+            out[i][1] = king_pos[i][1];
+        }
     }
 
     // Is the game over
@@ -829,98 +923,229 @@ public:
         return score;
     }
 
-    //Retrieve fen string from the current board
-    std::string board_to_fen(int side){
-        std::string FEN = "";
-        // Loop through the board
-        for(int row=0; row < 8; row++){
-            int empty = 0;
-            for(int col=0; col < 8; col++){
-                int piece = board[row][col];
-                if(piece == 0){
-                    empty++;
-                }else{
-                    if(empty > 0){
-                        FEN += std::to_string(empty);
-                        empty = 0;
+    // Set the board up from a FEN. The whole FEN is checked first, and if anything is wrong
+    // false is returned and the board is left as it was. Castling rights whose king or rook
+    // has moved are dropped. The move counters may be left out, then they are 0 and 1
+    bool parse_fen(std::string_view fen){
+        // Surrounding whitespace, like the '\r' of a line from Windows
+        while (!fen.empty() && (fen.front() == ' ' || fen.front() == '\t')) {
+            fen.remove_prefix(1);
+        }
+        while (!fen.empty() && (fen.back() == ' ' || fen.back() == '\t' || fen.back() == '\r' || fen.back() == '\n')) {
+            fen.remove_suffix(1);
+        }
+
+        // Pieces, rank 8 first
+        std::array<std::array<int, 8>, 8> squares{};
+        uint64_t key = 0;
+        int pieces = 0;
+        int kings[2][2] = {{-1, -1}, {-1, -1}};
+        int row = 0;
+        int col = 0;
+        bool last_digit = false;
+        size_t i = 0;
+        for (; i < fen.size() && fen[i] != ' '; i++) {
+            char c = fen[i];
+            int piece = FEN_PIECES[(unsigned char)c];
+            if (piece != 0) {
+                if (col > 7) {
+                    return false;
+                }
+                if (piece == 1 || piece == -1) {
+                    if (row == 0 || row == 7) {
+                        return false; // Pawns can't stand on the first or last rank
                     }
-                    FEN += number_to_piece.at(piece);
+                } else if (piece == 5 || piece == -5) {
+                    int color = piece > 0 ? 0 : 1;
+                    if (kings[color][0] != -1) {
+                        return false;
+                    }
+                    kings[color][0] = row;
+                    kings[color][1] = col;
                 }
+                squares[row][col] = piece;
+                key ^= ZOBRIST.pieces[piece + 6][row * 8 + col];
+                pieces++;
+                col++;
+                last_digit = false;
+            } else if (c >= '1' && c <= '8') {
+                col += c - '0';
+                if (col > 8 || last_digit) {
+                    return false;
+                }
+                last_digit = true;
+            } else if (c == '/') {
+                if (col != 8 || row == 7) {
+                    return false;
+                }
+                row++;
+                col = 0;
+                last_digit = false;
+            } else {
+                return false;
             }
-            if(empty > 0){
-                FEN += std::to_string(empty);
-            }
-            if(row < 7){
-                FEN += "/";
+        }
+        if (row != 7 || col != 8 || kings[0][0] == -1 || kings[1][0] == -1) {
+            return false;
+        }
+
+        // Side to move
+        if (i + 2 > fen.size() || (fen[i + 1] != 'w' && fen[i + 1] != 'b')) {
+            return false;
+        }
+        int side = fen[i + 1] == 'w' ? 1 : -1;
+        i += 2;
+        if (i + 1 >= fen.size() || fen[i] != ' ') {
+            return false;
+        }
+        i++;
+
+        // Castling rights, '-' or some of KQkq in that order
+        bool castle[4] = {false, false, false, false}; // White queen-, king-side, black queen-, king-side
+        if (fen[i] == '-') {
+            i++;
+        } else {
+            const char order[4] = {'K', 'Q', 'k', 'q'};
+            const int right[4] = {1, 0, 3, 2};
+            int next = 0;
+            for (; i < fen.size() && fen[i] != ' '; i++) {
+                while (next < 4 && order[next] != fen[i]) {
+                    next++;
+                }
+                if (next == 4) {
+                    return false;
+                }
+                castle[right[next++]] = true;
             }
         }
-        // Add the current player
-        if(side == 1){
-            FEN += " w ";
-        }else{
-            FEN += " b ";
+        // A right is only kept while the king and that rook are still on their home squares,
+        // castling without them would move pieces that aren't there
+        for (int color = 0; color < 2; color++) {
+            int home_row = color == 0 ? 7 : 0;
+            int sign = color == 0 ? 1 : -1;
+            bool king_home = squares[home_row][4] == 5 * sign;
+            castle[color * 2] = castle[color * 2] && king_home && squares[home_row][0] == 2 * sign;
+            castle[color * 2 + 1] = castle[color * 2 + 1] && king_home && squares[home_row][7] == 2 * sign;
+        }
+        if (i + 1 >= fen.size() || fen[i] != ' ') {
+            return false;
         }
+        i++;
 
-        // Add the castling rights
-        if(white_castle[0] || white_castle[1] || black_castle[0] || black_castle[1]){
-            if(white_castle[1]){
-                FEN += "K";
+        // En passant square, it is behind a pawn that just moved two squares
+        int passant[2] = {-1, -1};
+        if (fen[i] == '-') {
+            i++;
+        } else {
+            if (i + 2 > fen.size() || fen[i] < 'a' || fen[i] > 'h' || fen[i + 1] != (side == 1 ? '6' : '3')) {
+                return false;
+            }
+            passant[0] = side == 1 ? 2 : 5;
+            passant[1] = fen[i] - 'a';
+            if (squares[passant[0] + side][passant[1]] != -side) {
+                return false; // The pawn that just moved has to be in front of it
             }
-            if(white_castle[0]){
-                FEN += "Q";
+            i += 2;
+        }
+
+        // Move counters
+        int halfmoves = 0;
+        int fullmoves = 1;
+        if (i < fen.size()) {
+            if (fen[i] != ' ') {
+                return false;
             }
-            if(black_castle[1]){
-                FEN += "k";
+            i++;
+            if (!parse_counter(fen, i, 6, halfmoves) || i == fen.size()) {
+                return false;
             }
-            if(black_castle[0]){
-                FEN += "q";
+            i++;
+            if (!parse_counter(fen, i, 6, fullmoves) || i != fen.size() || fullmoves < 1) {
+                return false;
             }
-        }else{
-            FEN += "-";
         }
-        FEN += " ";
 
-        // Add the en passant
-        if(en_passant[0] != -1){
-            FEN += ALPHACOLS.at(en_passant[1]);
-            FEN += std::to_string(en_passant[0]+1);
-        }else{
-            FEN += "-";
+        // Everything checked out
+        board = squares;
+        history_size = 0;
+        pieces_alive = pieces;
+        for (int color = 0; color < 2; color++) {
+            king_pos[color][0] = kings[color][0];
+            king_pos[color][1] = kings[color][1];
         }
-        FEN += " 0 1";
-
-        return FEN;
+        current_player = side;
+        white_castle[0] = castle[0];
+        white_castle[1] = castle[1];
+        black_castle[0] = castle[2];
+        black_castle[1] = castle[3];
+        en_passant[0] = passant[0];
+        en_passant[1] = passant[1];
+        halfmove_clock = halfmoves;
+        fullmove_number = fullmoves;
+        game_over = false;
+        hash = key ^ state_hash();
+        return true;
     }
 
-    // Function for generating a hashkey
-    std::string generate_hash_key(int side) {
-        std::string key = "";
-
-        for (int row = 0; row < 8; ++row) {
-            for (int col = 0; col < 8; ++col) {
+    // Write the FEN of the position into out, which needs room for MAX_FEN_LENGTH characters.
+    // Returns the length, out is zero terminated
+    int write_fen(char *out, int side){
+        char *start = out;
+        for (int row = 0; row < 8; row++) {
+            int empty = 0;
+            for (int col = 0; col < 8; col++) {
                 int piece = board[row][col];
-                key += std::to_string(piece) + ",";
+                if (piece == 0) {
+                    empty++;
+                    continue;
+                }
+                if (empty > 0) {
+                    *out++ = (char)('0' + empty);
+                    empty = 0;
+                }
+                *out++ = FEN_CHARS[piece + 6];
+            }
+            if (empty > 0) {
+                *out++ = (char)('0' + empty);
+            }
+            *out++ = row < 7 ? '/' : ' ';
+        }
+        *out++ = side == 1 ? 'w' : 'b';
+        *out++ = ' ';
+
+        if (castle_index() == 0) {
+            *out++ = '-';
+        } else {
+            const bool rights[4] = {white_castle[1], white_castle[0], black_castle[1], black_castle[0]};
+            const char letters[4] = {'K', 'Q', 'k', 'q'};
+            for (int i = 0; i < 4; i++) {
+                if (rights[i]) {
+                    *out++ = letters[i];
+                }
             }
         }
+        *out++ = ' ';
 
-        key += side == 1 ? "w" : "b";
-        key += ",";
-        
-        key += white_castle[0] ? "Q" : "";
-        key += white_castle[1] ? "K" : "";
-        key += black_castle[0] ? "q" : "";
-        key += black_castle[1] ? "k" : "";
-        key += ",";
-        
         if (en_passant[0] != -1) {
-            key += ALPHACOLS.at(en_passant[0]);
-            key += std::to_string(en_passant[1]);
+            *out++ = (char)('a' + en_passant[1]);
+            *out++ = (char)('8' - en_passant[0]);
         } else {
-            key += "-";
+            *out++ = '-';
         }
+        *out++ = ' ';
+        out = write_number(out, std::max(halfmove_clock, 0));
+        *out++ = ' ';
+        out = write_number(out, std::max(fullmove_number, 1));
+        *out = '\0';
+        return (int)(out - start);
+    }
 
-        return key;
-}
+    //Retrieve fen string from the current board
+    std::string board_to_fen(int side){
+        char fen[MAX_FEN_LENGTH];
+        int length = write_fen(fen, side);
+        return std::string(fen, length);
+    }
 
     //////////// DEBUGGING ////////////
     // Print the current board
@@ -940,7 +1165,9 @@ public:
     }
     // Return valid moves of a single piece
     std::vector<std::array<int, 4>> debug_moves(int row, int col){
-        return get_valid_moves(row, col);
+        MoveList moves;
+        get_valid_moves(row, col, moves);
+        return std::vector<std::array<int, 4>>(moves.begin(), moves.end());
     }
     // Check if the board is equal to another board
     bool areEqual(const std::array<std::array<int, 8>, 8>& new_board)
@@ -960,9 +1187,12 @@ public:
     }
     //////////// DEBUGGING ////////////
 
-    // Constructer, used for setting the board up
-    Board(std::string FEN){
-        set_board(FEN);
+    // Constructer, used for setting the board up. An invalid FEN gives an empty board
+    Board(std::string_view FEN){
+        if (!parse_fen(FEN)) {
+            reset_board();
+            hash = compute_hash();
+        }
     }
     //~Board();
 };
@@ -3,9 +3,12 @@
 
 #include <array>
 #include <eval_values.h>
+#include <attack_tables.h>
+#include <trace.h>
 
 // Function for summing the values of the pieces
 int sum_material_values(std::array<std::array<int, 8>, 8> board, int pieces_alive){
+    TRACE_SCOPE("sum_material_values");
     int sum = 0;
     int value = 0;
 
@@ -33,8 +36,50 @@ int sum_material_values(std::array<std::array<int, 8>, 8> board, int pieces_aliv
     return sum;
 }
 
+// Pawn structure checks for the pawn standing on rank, file
+bool is_doubled_pawn(const std::array<std::array<int, 8>, 8> &board, int rank, int file) {
+    int piece = board[rank][file];
+    int side = piece > 0 ? 1 : -1;
+    for (int r = rank + side; r >= 0 && r < 8; r += side) {
+        if (board[r][file] == piece) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool is_isolated_pawn(const std::array<std::array<int, 8>, 8> &board, int rank, int file) {
+    int piece = board[rank][file];
+    for (int f = file - 1; f <= file + 1; f += 2) {
+        if (f < 0 || f > 7) {
+            continue;
+        }
+        for (int r = 0; r < 8; ++r) {
+            if (board[r][f] == piece) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Free movement, no enemy pawn in front of it or on the files next to it
+bool is_passed_pawn(const std::array<std::array<int, 8>, 8> &board, int rank, int file) {
+    int piece = board[rank][file];
+    int side = piece > 0 ? 1 : -1;
+    for (int r = rank + side; r >= 0 && r < 8; r += side) {
+        for (int f = std::max(0, file - 1); f <= std::min(7, file + 1); ++f) {
+            if (board[r][f] == -piece) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 // Pawn structure evaluation
-int evaluate_pawn_structure(std::array<std::array<int, 8>, 8> board) {
+int evaluate_pawn_structure(const std::array<std::array<int, 8>, 8> &board) {
+    TRACE_SCOPE("evaluate_pawn_structure");
     int score = 0;
 
     for (int rank = 0; rank < 8; ++rank) {
@@ -43,48 +88,14 @@ int evaluate_pawn_structure(std::array<std::array<int, 8>, 8> board) {
             if (abs(piece) == 1) { // Check if it's a pawn
                 int side = piece > 0 ? 1 : -1;
 
-                // Check for doubled pawns
-                for (int r = rank + side; r >= 0 && r < 8; r += side) {
-                    if (board[r][file] == piece) {
-                        score -= side * 10; // Penalize doubled pawns
-                        break;
-                    }
-                }
-
-                // Check for isolated pawns
-                bool isolated = true;
-                if (file > 0) {
-                    for (int r = 0; r < 8; ++r) {
-                        if (board[r][file - 1] == piece) {
-                            isolated = false;
-                            break;
-                        }
-                    }
+                if (is_doubled_pawn(board, rank, file)) {
+                    score -= side * DOUBLED_PAWN_PENALTY; // Penalize doubled pawns
                 }
-                if (file < 7 && isolated) {
-                    for (int r = 0; r < 8; ++r) {
-                        if (board[r][file + 1] == piece) {
-                            isolated = false;
-                            break;
-                        }
-                    }
-                }
-                if (isolated) {
-                    score -= side * 20; // Penalize isolated pawns
-                }
-
-                // Check for passed pawns (Free movement)
-                bool passed = true;
-                for (int r = rank + side; r >= 0 && r < 8 && passed; r += side) {
-                    for (int f = std::max(0, file - 1); f <= std::min(7, file + 1); ++f) {
-                        if (board[r][f] == -piece) {
-                            passed = false;
-                            break;
-                        }
-                    }
+                if (is_isolated_pawn(board, rank, file)) {
+                    score -= side * ISOLATED_PAWN_PENALTY; // Penalize isolated pawns
                 }
-                if (passed) {
-                    score += side * 30; // Reward passed pawns
+                if (is_passed_pawn(board, rank, file)) {
+                    score += side * PASSED_PAWN_BONUS; // Reward passed pawns
                 }
             }
         }
@@ -93,10 +104,106 @@ int evaluate_pawn_structure(std::array<std::array<int, 8>, 8> board) {
     return score;
 }
 
-int evaluate_king_safety(std::array<std::array<int, 8>, 8> board, int king_pos[2][2]) {
+// The squares each side attacks. They are worked out once per evaluated position and
+// shared by the king safety, mobility and threat terms. Sets of squares as in attack_tables.h
+struct SideAttacks {
+    uint64_t occupied = 0;     // Squares of the side's pieces
+    uint64_t pieces[7] = {};   // Squares of the side's pieces of each type, by piece number
+    uint64_t by_piece[7] = {}; // Squares attacked by the pieces of each type
+    uint64_t all = 0;          // Squares attacked by any piece
+    uint64_t twice = 0;        // Squares attacked by two pieces or more
+    int mobility[7] = {};      // Safe squares the pieces of each type reach, added up
+};
+
+struct AttackMaps {
+    SideAttacks side[2]; // [0] = white, [1] = black
+};
+
+// Squares a rook, bishop or queen attacks, up to and including the first piece on each line
+uint64_t slider_attacks(const std::array<std::array<int, 8>, 8> &board, int square, bool diagonal, bool straight) {
+    const int *squares = &board[0][0];
+    uint64_t attacks = 0;
+    for (int d = straight ? 0 : 4; d < (diagonal ? 8 : 4); d++) {
+        const Ray &ray = RAYS[square][d];
+        for (int i = 0; i < ray.size; i++) {
+            attacks |= uint64_t(1) << ray.squares[i];
+            if (squares[ray.squares[i]] != 0) {
+                break;
+            }
+        }
+    }
+    return attacks;
+}
+
+void add_attacks(SideAttacks &side, int type, uint64_t attacks) {
+    side.twice |= side.all & attacks;
+    side.all |= attacks;
+    side.by_piece[type] |= attacks;
+}
+
+void compute_attack_maps(const std::array<std::array<int, 8>, 8> &board, AttackMaps &maps) {
+    TRACE_SCOPE("compute_attack_maps");
+    maps = AttackMaps();
+    // Pawns go first, the mobility of the other pieces leaves out the squares enemy pawns attack
+    int others[64];
+    int count = 0;
+    for (int square = 0; square < 64; square++) {
+        int piece = board[square / 8][square % 8];
+        if (piece == 0) {
+            continue;
+        }
+        SideAttacks &side = maps.side[piece > 0 ? 0 : 1];
+        side.occupied |= uint64_t(1) << square;
+        side.pieces[std::abs(piece)] |= uint64_t(1) << square;
+        if (std::abs(piece) == 1) {
+            add_attacks(side, 1, PAWN_ATTACKS[piece > 0 ? 0 : 1][square].mask);
+        } else {
+            others[count++] = square;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        int piece = board[others[i] / 8][others[i] % 8];
+        int type = std::abs(piece);
+        uint64_t attacks;
+        switch (type) {
+            case 3: attacks = KNIGHT_ATTACKS[others[i]].mask; break;
+            case 5: attacks = KING_ATTACKS[others[i]].mask; break;
+            default: attacks = slider_attacks(board, others[i], type != 2, type != 4); break;
+        }
+        SideAttacks &side = maps.side[piece > 0 ? 0 : 1];
+        add_attacks(side, type, attacks);
+        if (type != 5) {
+            side.mobility[type] += square_count(attacks & ~side.occupied & ~maps.side[piece > 0 ? 1 : 0].by_piece[1]);
+        }
+    }
+}
+
+// What surrounds a king, each count gets weighted by its KING_ constant
+struct KingSafetyCounts {
+    int straight = 0; // Squares around the king attacked by enemy rooks and queens
+    int diagonal = 0; // Squares around the king attacked by enemy bishops
+    int knight = 0;
+    int pawn = 0;
+    int shield = 0;   // Own pieces next to the king
+};
+
+KingSafetyCounts count_king_safety(const AttackMaps &maps, int king_row, int king_col, int side) {
+    const SideAttacks &own = maps.side[side == 1 ? 0 : 1];
+    const SideAttacks &enemy = maps.side[side == 1 ? 1 : 0];
+    uint64_t around = KING_ATTACKS[square_of(king_row, king_col)].mask;
+    uint64_t zone = around | square_bit(king_row, king_col);
+    KingSafetyCounts counts;
+    counts.straight = square_count(zone & (enemy.by_piece[2] | enemy.by_piece[6]));
+    counts.diagonal = square_count(zone & enemy.by_piece[4]);
+    counts.knight = square_count(zone & enemy.by_piece[3]);
+    counts.pawn = square_count(zone & enemy.by_piece[1]);
+    counts.shield = square_count(around & own.occupied);
+    return counts;
+}
+
+int evaluate_king_safety(const AttackMaps &maps, int king_pos[2][2]) {
+    TRACE_SCOPE("evaluate_king_safety");
     int score = 0;
-    int directions[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
-    int knight_moves[8][2] = {{1, 2}, {2, 1}, {-1, 2}, {-2, 1}, {1, -2}, {2, -1}, {-1, -2}, {-2, -1}};
 
     for (int color = 0; color < 2; color++) {
         int king_row = king_pos[color][0];
@@ -107,85 +214,56 @@ int evaluate_king_safety(std::array<std::array<int, 8>, 8> board, int king_pos[2
             continue;
         }
 
-        int attack_score = 0;
-
-        // Check for attackers in each direction (rook, bishop, queen)
-        for (int i = 0; i < 8; i++) {
-            int row = king_row + directions[i][0];
-            int col = king_col + directions[i][1];
-
-            while (row >= 0 && row < 8 && col >= 0 && col < 8) {
-                int piece = board[row][col];
-
-                if (piece != 0) {
-                    if (piece * side < 0) { // If it's an enemy piece
-                        // Rook or queen
-                        if (abs(piece) == 4 && (i < 4)) {
-                            attack_score += 5;
-                        }
-                        // Bishop or queen
-                        else if (abs(piece) == 3 && (i >= 4)) {
-                            attack_score += 3;
-                        }
-                    }
-                    break;
-                }
-
-                row += directions[i][0];
-                col += directions[i][1];
-            }
-        }
-
-        // Check for knight attacks
-        for (int i = 0; i < 8; i++) {
-            int row = king_row + knight_moves[i][0];
-            int col = king_col + knight_moves[i][1];
-
-            if (row >= 0 && row < 8 && col >= 0 && col < 8) {
-                int piece = board[row][col];
-                if (piece * side < 0 && abs(piece) == 2) { // If it's an enemy knight
-                    attack_score += 3;
-                }
-            }
-        }
-
-        // Check for pawn attacks
-        int pawn_directions[2][2] = {{1, -1}, {1, 1}};
-        for (int i = 0; i < 2; i++) {
-            int row = king_row + side * pawn_directions[i][0];
-            int col = king_col + pawn_directions[i][1];
-
-            if (row >= 0 && row < 8 && col >= 0 && col < 8) {
-                int piece = board[row][col];
-                if (piece * side < 0 && abs(piece) == 1) { // If it's an enemy pawn
-                    attack_score += 1;
-                }
-            }
-        }
+        KingSafetyCounts counts = count_king_safety(maps, king_row, king_col, side);
+        int attack_score = counts.straight * KING_STRAIGHT_ATTACK + counts.diagonal * KING_DIAGONAL_ATTACK
+                         + counts.knight * KING_KNIGHT_ATTACK + counts.pawn * KING_PAWN_ATTACK;
 
+        // The attacks are counted twice, once on their own and once offset by the shield
         score -= side * attack_score;
-                // Check for pieces surrounding the king
-        for (int i = -1; i <= 1; i++) {
-            for (int j = -1; j <= 1; j++) {
-                if (i == 0 && j == 0) {
-                    continue;
-                }
-
-                int row = king_row + i;
-                int col = king_col + j;
+        attack_score -= counts.shield * KING_SHIELD_BONUS;
+        score -= side * attack_score;
+    }
 
-                if (row >= 0 && row < 8 && col >= 0 && col < 8) {
-                    int piece = board[row][col];
-                    if (piece * side > 0) { // If it's an ally piece
-                        attack_score -= 2;
-                    }
-                }
-            }
-        }
+    return score;
+}
 
-        score -= side * attack_score;
+// Pieces whose mobility is scored, in the order of the MOBILITY_ constants
+const int MOBILITY_PIECES[4] = {3, 4, 2, 6};
+
+// How freely a side's pieces move and how many of them are under attack
+struct ThreatCounts {
+    int mobility[4] = {}; // Safe squares of the knights, bishops, rooks and queens
+    int hanging = 0;      // Pieces other than the king attacked and not defended
+    int by_pawn = 0;      // Pieces other than pawns and the king attacked by enemy pawns
+    int by_minor = 0;     // Rooks and queens attacked by enemy knights or bishops
+};
+
+ThreatCounts count_threats(const AttackMaps &maps, int side) {
+    const SideAttacks &own = maps.side[side == 1 ? 0 : 1];
+    const SideAttacks &enemy = maps.side[side == 1 ? 1 : 0];
+    ThreatCounts counts;
+    for (int i = 0; i < 4; i++) {
+        counts.mobility[i] = own.mobility[MOBILITY_PIECES[i]];
     }
+    uint64_t targets = own.occupied & ~own.pieces[5];
+    counts.hanging = square_count(targets & enemy.all & ~own.all);
+    counts.by_pawn = square_count(targets & ~own.pieces[1] & enemy.by_piece[1]);
+    counts.by_minor = square_count((own.pieces[2] | own.pieces[6]) & (enemy.by_piece[3] | enemy.by_piece[4]));
+    return counts;
+}
 
+int evaluate_threats(const AttackMaps &maps) {
+    TRACE_SCOPE("evaluate_threats");
+    static const int mobility_bonus[4] = {MOBILITY_KNIGHT, MOBILITY_BISHOP, MOBILITY_ROOK, MOBILITY_QUEEN};
+    int score = 0;
+    for (int side = 1; side >= -1; side -= 2) {
+        ThreatCounts counts = count_threats(maps, side);
+        for (int i = 0; i < 4; i++) {
+            score += side * counts.mobility[i] * mobility_bonus[i];
+        }
+        score -= side * (counts.hanging * HANGING_PIECE_PENALTY + counts.by_pawn * THREAT_BY_PAWN
+                         + counts.by_minor * THREAT_BY_MINOR);
+    }
     return score;
 }
 
@@ -208,6 +286,7 @@ std::array<std::array<int, 8>, 8> bolean_board(std::array<std::array<int, 8>, 8>
 }
 
 float evaluate_board(std::array<std::array<int, 8>, 8> board, int pieces_alive, int king_pos[2][2]){
+    TRACE_SCOPE("evaluate_board");
     float score = 0;
 
     // Get material values
@@ -217,9 +296,15 @@ float evaluate_board(std::array<std::array<int, 8>, 8> board, int pieces_alive,
     score += evaluate_pawn_structure(board);
 
 
+    // Attacked squares, shared by the terms below
+    AttackMaps maps;
+    compute_attack_maps(board, maps);
+
     // Get King safety
-    score += evaluate_king_safety(board, king_pos);
-    
+    score += evaluate_king_safety(maps, king_pos);
+
+    // Get mobility and threats
+    score += evaluate_threats(maps);
 
     return score;
 }
@@ -0,0 +1,237 @@
+#ifndef EVAL_PARAMS_H
+#define EVAL_PARAMS_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <vector>
+#include <eval_values.h>
+#include <eval_functions.h>
+
+// evaluate_board written as a weighted sum: every position is a short list of
+// (parameter, coefficient) features, and its score is the sum of coefficient * parameter.
+// The tuner changes the parameters and writes them back into eval_values.h
+
+// Layout of the parameter vector. Pieces are indexed by their number - 1 (P R N B K Q),
+// table squares by row * 8 + col, seen from white like the tables in eval_values.h
+const int PARAM_PIECE_VALUE = 0;
+const int PARAM_MG_TABLE = PARAM_PIECE_VALUE + 6;
+const int PARAM_EG_TABLE = PARAM_MG_TABLE + 6 * 64;
+const int PARAM_DOUBLED_PAWN = PARAM_EG_TABLE + 6 * 64;
+const int PARAM_ISOLATED_PAWN = PARAM_DOUBLED_PAWN + 1;
+const int PARAM_PASSED_PAWN = PARAM_ISOLATED_PAWN + 1;
+const int PARAM_KING_STRAIGHT = PARAM_PASSED_PAWN + 1;
+const int PARAM_KING_DIAGONAL = PARAM_KING_STRAIGHT + 1;
+const int PARAM_KING_KNIGHT = PARAM_KING_DIAGONAL + 1;
+const int PARAM_KING_PAWN = PARAM_KING_KNIGHT + 1;
+const int PARAM_KING_SHIELD = PARAM_KING_PAWN + 1;
+const int PARAM_MOBILITY = PARAM_KING_SHIELD + 1; // Knight, bishop, rook, queen
+const int PARAM_HANGING_PIECE = PARAM_MOBILITY + 4;
+const int PARAM_THREAT_BY_PAWN = PARAM_HANGING_PIECE + 1;
+const int PARAM_THREAT_BY_MINOR = PARAM_THREAT_BY_PAWN + 1;
+const int NUM_EVAL_PARAMS = PARAM_THREAT_BY_MINOR + 1;
+
+// Names of the tables in eval_values.h, by piece number - 1
+const char *const TABLE_PIECE_NAMES[6] = {"pawn", "rook", "knight", "bishop", "king", "queen"};
+
+// Names of the single value constants in eval_values.h, starting at PARAM_DOUBLED_PAWN
+const char *const CONSTANT_NAMES[NUM_EVAL_PARAMS - PARAM_DOUBLED_PAWN] = {
+    "DOUBLED_PAWN_PENALTY", "ISOLATED_PAWN_PENALTY", "PASSED_PAWN_BONUS",
+    "KING_STRAIGHT_ATTACK", "KING_DIAGONAL_ATTACK", "KING_KNIGHT_ATTACK", "KING_PAWN_ATTACK", "KING_SHIELD_BONUS",
+    "MOBILITY_KNIGHT", "MOBILITY_BISHOP", "MOBILITY_ROOK", "MOBILITY_QUEEN",
+    "HANGING_PIECE_PENALTY", "THREAT_BY_PAWN", "THREAT_BY_MINOR"
+};
+
+struct EvalFeature {
+    uint16_t index;
+    int16_t coefficient;
+};
+
+// The parameters eval_values.h holds right now
+std::vector<double> current_eval_params() {
+    std::vector<double> params(NUM_EVAL_PARAMS);
+    for (int piece = 1; piece <= 6; piece++) {
+        params[PARAM_PIECE_VALUE + piece - 1] = piece_value.at(piece);
+        for (int square = 0; square < 64; square++) {
+            params[PARAM_MG_TABLE + (piece - 1) * 64 + square] = mg_value_tables.at(piece)[square / 8][square % 8];
+            params[PARAM_EG_TABLE + (piece - 1) * 64 + square] = eg_value_tables.at(piece)[square / 8][square % 8];
+        }
+    }
+    const int constants[] = {DOUBLED_PAWN_PENALTY, ISOLATED_PAWN_PENALTY, PASSED_PAWN_BONUS,
+                             KING_STRAIGHT_ATTACK, KING_DIAGONAL_ATTACK, KING_KNIGHT_ATTACK, KING_PAWN_ATTACK, KING_SHIELD_BONUS,
+                             MOBILITY_KNIGHT, MOBILITY_BISHOP, MOBILITY_ROOK, MOBILITY_QUEEN,
+                             HANGING_PIECE_PENALTY, THREAT_BY_PAWN, THREAT_BY_MINOR};
+    for (int i = 0; i < NUM_EVAL_PARAMS - PARAM_DOUBLED_PAWN; i++) {
+        params[PARAM_DOUBLED_PAWN + i] = constants[i];
+    }
+    return params;
+}
+
+// Adds up the coefficients of a position, only touching the parameters it uses
+class FeatureCounter
+{
+private:
+    std::array<int, NUM_EVAL_PARAMS> counts{};
+    std::vector<uint16_t> touched;
+
+public:
+    void add(int index, int coefficient){
+        if (counts[index] == 0) {
+            touched.push_back((uint16_t)index);
+        }
+        counts[index] += coefficient;
+    }
+
+    // Move the features that didn't cancel out to the end of features, and reset the counter
+    void flush(std::vector<EvalFeature> &features){
+        for (uint16_t index : touched) {
+            if (counts[index] != 0) {
+                features.push_back({index, (int16_t)counts[index]});
+                counts[index] = 0;
+            }
+        }
+        touched.clear();
+    }
+};
+
+// Append the features of a position to features. Takes the same input as evaluate_board,
+// and sum of coefficient * current_eval_params() gives the same score
+void extract_features(const std::array<std::array<int, 8>, 8> &board, int pieces_alive, int king_pos[2][2], std::vector<EvalFeature> &features) {
+    static thread_local FeatureCounter counter;
+    int table = pieces_alive > 22 ? PARAM_MG_TABLE : PARAM_EG_TABLE;
+
+    // Material and piece square tables, black reads the white tables mirrored and negated
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            int piece = board[row][col];
+            if (piece == 0) {
+                continue;
+            }
+            int side = piece > 0 ? 1 : -1;
+            int type = std::abs(piece) - 1;
+            int square = side == 1 ? row * 8 + col : (7 - row) * 8 + col;
+            counter.add(PARAM_PIECE_VALUE + type, side);
+            counter.add(table + type * 64 + square, side);
+
+            if (type == 0) {
+                if (is_doubled_pawn(board, row, col)) {
+                    counter.add(PARAM_DOUBLED_PAWN, -side);
+                }
+                if (is_isolated_pawn(board, row, col)) {
+                    counter.add(PARAM_ISOLATED_PAWN, -side);
+                }
+                if (is_passed_pawn(board, row, col)) {
+                    counter.add(PARAM_PASSED_PAWN, side);
+                }
+            }
+        }
+    }
+
+    AttackMaps maps;
+    compute_attack_maps(board, maps);
+
+    // Mobility and threats
+    for (int side = 1; side >= -1; side -= 2) {
+        ThreatCounts counts = count_threats(maps, side);
+        for (int i = 0; i < 4; i++) {
+            counter.add(PARAM_MOBILITY + i, side * counts.mobility[i]);
+        }
+        counter.add(PARAM_HANGING_PIECE, -side * counts.hanging);
+        counter.add(PARAM_THREAT_BY_PAWN, -side * counts.by_pawn);
+        counter.add(PARAM_THREAT_BY_MINOR, -side * counts.by_minor);
+    }
+
+    // King safety counts the attacks twice, see evaluate_king_safety
+    for (int color = 0; color < 2; color++) {
+        if (king_pos[color][0] == -1) {
+            continue;
+        }
+        int side = color == 0 ? 1 : -1;
+        KingSafetyCounts counts = count_king_safety(maps, king_pos[color][0], king_pos[color][1], side);
+        counter.add(PARAM_KING_STRAIGHT, -2 * side * counts.straight);
+        counter.add(PARAM_KING_DIAGONAL, -2 * side * counts.diagonal);
+        counter.add(PARAM_KING_KNIGHT, -2 * side * counts.knight);
+        counter.add(PARAM_KING_PAWN, -2 * side * counts.pawn);
+        counter.add(PARAM_KING_SHIELD, side * counts.shield);
+    }
+    counter.flush(features);
+}
+
+double linear_eval(const EvalFeature *features, int count, const double *params) {
+    double score = 0.0;
+    for (int i = 0; i < count; i++) {
+        score += features[i].coefficient * params[features[i].index];
+    }
+    return score;
+}
+
+// Print a table in the layout eval_values.h uses
+std::string format_table(const std::string &name, const double *values) {
+    std::string text = "std::array<std::array<int, 8>, 8> " + name + " = {{\n";
+    for (int row = 0; row < 8; row++) {
+        text += "        {{";
+        for (int col = 0; col < 8; col++) {
+            text += std::to_string((int)std::lround(values[row * 8 + col]));
+            text += col < 7 ? ", " : "}}";
+        }
+        text += row < 7 ? ",\n" : "\n";
+    }
+    return text + "    }};";
+}
+
+// Put the parameters into the text of eval_values.h. Only the tuned values are replaced,
+// everything else in the file is kept as it is. Returns an empty string if something is missing
+std::string write_eval_values(std::string source, const std::vector<double> &params) {
+    // Piece values, the black entries are the negated white ones
+    size_t start = source.find("piece_value = {");
+    size_t end = source.find("};", start);
+    if (start == std::string::npos || end == std::string::npos) {
+        return "";
+    }
+    std::string block = source.substr(start, end - start);
+    std::string new_block;
+    std::regex entry("\\{(-?\\d+), (-?\\d+)\\}");
+    std::sregex_iterator it(block.begin(), block.end(), entry), last;
+    size_t copied = 0;
+    for (; it != last; ++it) {
+        int piece = std::stoi((*it)[1]);
+        int value = (int)std::lround(params[PARAM_PIECE_VALUE + std::abs(piece) - 1]);
+        new_block += block.substr(copied, it->position() - copied);
+        new_block += "{" + std::to_string(piece) + ", " + std::to_string(piece > 0 ? value : -value) + "}";
+        copied = it->position() + it->length();
+    }
+    new_block += block.substr(copied);
+    source.replace(start, end - start, new_block);
+
+    // Piece square tables
+    for (int phase = 0; phase < 2; phase++) {
+        for (int piece = 0; piece < 6; piece++) {
+            std::string name = std::string(phase == 0 ? "mg_" : "eg_") + TABLE_PIECE_NAMES[piece] + "_table";
+            start = source.find("std::array<std::array<int, 8>, 8> " + name + " = {{");
+            end = source.find("}};", start); // The rows end in "}}," so this is the end of the table
+            if (start == std::string::npos || end == std::string::npos) {
+                return "";
+            }
+            int first = (phase == 0 ? PARAM_MG_TABLE : PARAM_EG_TABLE) + piece * 64;
+            source.replace(start, end + 3 - start, format_table(name, &params[first]));
+        }
+    }
+
+    // Single value constants
+    for (int i = 0; i < NUM_EVAL_PARAMS - PARAM_DOUBLED_PAWN; i++) {
+        std::string declaration = "const int " + std::string(CONSTANT_NAMES[i]) + " = ";
+        start = source.find(declaration);
+        if (start == std::string::npos) {
+            return "";
+        }
+        start += declaration.size();
+        end = source.find(";", start);
+        source.replace(start, end - start, std::to_string((int)std::lround(params[PARAM_DOUBLED_PAWN + i])));
+    }
+    return source;
+}
+
+#endif
@@ -66,6 +66,29 @@ const std::unordered_map<int, int> piece_value = {
     {-6, -90}  // Queen
 };
 
+// Pawn structure
+const int DOUBLED_PAWN_PENALTY = 10;
+const int ISOLATED_PAWN_PENALTY = 20;
+const int PASSED_PAWN_BONUS = 30;
+
+// King safety, per square around the king attacked by enemy pieces and per own piece next to it
+const int KING_STRAIGHT_ATTACK = 2;
+const int KING_DIAGONAL_ATTACK = 2;
+const int KING_KNIGHT_ATTACK = 2;
+const int KING_PAWN_ATTACK = 1;
+const int KING_SHIELD_BONUS = 2;
+
+// Mobility, per square a piece reaches that isn't taken by its own side or attacked by enemy pawns
+const int MOBILITY_KNIGHT = 1;
+const int MOBILITY_BISHOP = 1;
+const int MOBILITY_ROOK = 1;
+const int MOBILITY_QUEEN = 1;
+
+// Threats, per piece attacked and not defended, attacked by a pawn, or a rook or queen attacked by a minor piece
+const int HANGING_PIECE_PENALTY = 4;
+const int THREAT_BY_PAWN = 8;
+const int THREAT_BY_MINOR = 6;
+
 
 // Translation of the coloumns to their alpha variable
 const std::unordered_map<int, char> ALPHACOLS = {
@@ -0,0 +1,195 @@
+#ifndef GAME_ANNOTATION_H
+#define GAME_ANNOTATION_H
+
+// Annotating a whole game: every position of the game is searched with the same
+// SearchState, starting from the last one and walking back to the first. The hash table
+// then already holds most of a position's tree from the positions after it, so the game
+// costs a fraction of searching every position on its own.
+// A move is judged by what a search of the position after it, a ply shallower, thinks of it,
+// against the best score of the position it was played in
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <board_representation.h>
+#include <search_algorithm.h>
+#include <pgn_reader.h>
+
+// Eval units (a pawn is 10) a move may lose before it gets flagged
+const int INACCURACY_LOSS = 5;
+const int MISTAKE_LOSS = 10;
+const int BLUNDER_LOSS = 30;
+// Scores are capped here before losses are worked out, so a slower mate isn't a blunder
+const int ANNOTATION_SCORE_CAP = 300;
+// Longest game that can be annotated, the search needs room in the board's history too
+const int MAX_ANNOTATED_PLIES = MAX_HISTORY - MAX_PLY - 1;
+
+enum AnnotationFlag {
+    ANNOTATION_NONE,
+    ANNOTATION_INACCURACY,
+    ANNOTATION_MISTAKE,
+    ANNOTATION_BLUNDER
+};
+
+const char *const ANNOTATION_FLAG_NAMES[4] = {"none", "inaccuracy", "mistake", "blunder"};
+
+struct AnnotatedPly {
+    std::string san;            // As the game gave it
+    std::array<int, 4> move;    // The move played
+    int side;                   // Side that played it
+    int score;                  // Score after the move, from white's side, as deep as best_score
+    int best_score;             // Score of the position before it, from white's side
+    std::array<int, 4> best_move;
+    std::string best_line;      // Search line of the position before the move
+    int loss;                   // Eval units the move gave away, for the side that played it
+    AnnotationFlag flag;
+};
+
+struct GameAnnotation {
+    std::vector<AnnotatedPly> plies;
+    int final_score = 0;    // Score of the position after the last move, from white's side
+    bool truncated = false; // The game was longer than MAX_ANNOTATED_PLIES
+    bool complete = true;   // False if a move couldn't be decoded, the plies before it are annotated
+    uint64_t nodes = 0;
+    int64_t time_ms = 0;
+};
+
+AnnotationFlag flag_for_loss(int loss) {
+    if (loss >= BLUNDER_LOSS) {
+        return ANNOTATION_BLUNDER;
+    }
+    if (loss >= MISTAKE_LOSS) {
+        return ANNOTATION_MISTAKE;
+    }
+    if (loss >= INACCURACY_LOSS) {
+        return ANNOTATION_INACCURACY;
+    }
+    return ANNOTATION_NONE;
+}
+
+// Search a position of the game a ply shallower and then to the full depth, or score it straight
+// away if the game is over in it. The shallow score is what the move into the position gets,
+// so it is looked at as deep as the best move of the position before (scores swing between
+// odd and even depths). The second search mostly comes out of the hash table
+MiniMaxResult annotation_search(Board &board, int side, int depth, SearchState &state, int &shallow_score, uint64_t &nodes) {
+    MoveList moves;
+    board.generate_moves(side, moves);
+    if (moves.empty()) {
+        state.lines[0].length = 0;
+        shallow_score = board.in_check(side) ? -side * MATE_SCORE : DRAW_SCORE;
+        return {shallow_score, {-1, -1, -1, -1}};
+    }
+    state.max_depth = depth - 1;
+    shallow_score = iterative_minimax(&board, side == 1, state).score;
+    nodes += state.stats.nodes.get();
+    state.max_depth = depth;
+    MiniMaxResult result = iterative_minimax(&board, side == 1, state);
+    nodes += state.stats.nodes.get();
+    return result;
+}
+
+// Annotate the main line of a game to a fixed depth, at least 2. The searches share state and
+// its hash table, set reuse to false to clear the table before every search instead (to see
+// what the reuse is worth). The board is left at the start of the game
+GameAnnotation annotate_game(Board &board, int side, const std::vector<std::string> &san_moves, int depth, SearchState &state, bool reuse = true) {
+    GameAnnotation annotation;
+    depth = std::max(2, depth);
+    auto start = std::chrono::steady_clock::now();
+    bool print_progress = state.print_progress;
+    int multi_pv = state.multi_pv;
+    state.print_progress = false;
+    state.multi_pv = 1;
+
+    // Play the game out first, then walk back through it with undo_move
+    int to_move = side;
+    for (const std::string &san : san_moves) {
+        if ((int)annotation.plies.size() == MAX_ANNOTATED_PLIES) {
+            annotation.truncated = true;
+            break;
+        }
+        AnnotatedPly ply;
+        if (!san_to_move(board, to_move, san, ply.move)) {
+            annotation.complete = false;
+            break;
+        }
+        ply.san = san;
+        ply.side = to_move;
+        board.move_piece(ply.move[0], ply.move[1], ply.move[2], ply.move[3]);
+        annotation.plies.push_back(ply);
+        to_move = -to_move;
+    }
+
+    if (!reuse) {
+        state.hash_table.clear();
+    }
+    int score_after;
+    annotation.final_score = annotation_search(board, to_move, depth, state, score_after, annotation.nodes).score;
+    for (int i = (int)annotation.plies.size() - 1; i >= 0; i--) {
+        AnnotatedPly &ply = annotation.plies[i];
+        board.undo_move();
+        if (!reuse) {
+            state.hash_table.clear();
+        }
+        int shallow_score;
+        MiniMaxResult best = annotation_search(board, ply.side, depth, state, shallow_score, annotation.nodes);
+        ply.score = score_after;
+        ply.best_score = best.score;
+        ply.best_move = best.move;
+        ply.best_line = principal_variation(state.lines[0]);
+        if (ply.best_move == ply.move) {
+            ply.loss = 0;
+        } else {
+            int before = std::max(-ANNOTATION_SCORE_CAP, std::min(ANNOTATION_SCORE_CAP, best.score));
+            int after = std::max(-ANNOTATION_SCORE_CAP, std::min(ANNOTATION_SCORE_CAP, score_after));
+            ply.loss = std::max(0, ply.side * (before - after));
+        }
+        ply.flag = flag_for_loss(ply.loss);
+        score_after = shallow_score;
+    }
+
+    state.print_progress = print_progress;
+    state.multi_pv = multi_pv;
+    annotation.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    return annotation;
+}
+
+// Read the first game of PGN text, a plain move list ("e4 e5 Nf3") is PGN movetext too
+bool game_from_pgn_text(const std::string &text, PgnGame &game) {
+    FILE *file = std::tmpfile();
+    if (!file) {
+        return false;
+    }
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::rewind(file);
+    bool found;
+    {
+        PgnReader reader(file);
+        found = reader.next_game(game);
+    }
+    std::fclose(file);
+    return found;
+}
+
+// One line per ply in game order, then a summary as JSON. Scores and losses are printed in centipawns
+void print_annotation(const GameAnnotation &annotation) {
+    int counts[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < annotation.plies.size(); i++) {
+        const AnnotatedPly &ply = annotation.plies[i];
+        counts[ply.flag]++;
+        std::cout << "info annotate ply " << i + 1 << " san " << ply.san << " move " << move_to_string(ply.move)
+                  << " score " << score_to_string(ply.score) << " best " << move_to_string(ply.best_move)
+                  << " bestscore " << score_to_string(ply.best_score) << " loss " << ply.loss * CENTIPAWNS_PER_UNIT
+                  << " flag " << ANNOTATION_FLAG_NAMES[ply.flag] << " pv " << ply.best_line << std::endl;
+    }
+    std::cout << "info string annotate {\"plies\":" << annotation.plies.size() << ",\"complete\":" << (annotation.complete ? "true" : "false")
+              << ",\"truncated\":" << (annotation.truncated ? "true" : "false") << ",\"final_score\":\"" << score_to_string(annotation.final_score)
+              << "\",\"inaccuracies\":" << counts[ANNOTATION_INACCURACY] << ",\"mistakes\":" << counts[ANNOTATION_MISTAKE]
+              << ",\"blunders\":" << counts[ANNOTATION_BLUNDER] << ",\"nodes\":" << annotation.nodes
+              << ",\"time_ms\":" << annotation.time_ms << "}" << std::endl;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read only into memory. The pages are read in by the OS as they
+// are touched, so opening even a big file is instant
+class MappedFile
+{
+private:
+    void *mapping = nullptr;
+    size_t mapped_size = 0;
+#ifdef _WIN32
+    HANDLE file_handle = INVALID_HANDLE_VALUE;
+    HANDLE map_handle = nullptr;
+#endif
+
+public:
+    // sequential tells the OS the file is read front to back, so it reads ahead
+    MappedFile(const std::string &path, bool sequential = false){
+#ifdef _WIN32
+        file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER size;
+        GetFileSizeEx(file_handle, &size);
+        if (size.QuadPart == 0) {
+            return; // Empty files can't be mapped
+        }
+        map_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!map_handle) {
+            return;
+        }
+        mapping = MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+        if (mapping) {
+            mapped_size = (size_t)size.QuadPart;
+        }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+            } else {
+                mapped_size = info.st_size;
+                if (sequential) {
+                    madvise(mapping, mapped_size, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        close(fd); // The mapping stays valid
+#endif
+    }
+
+    ~MappedFile(){
+#ifdef _WIN32
+        if (mapping) {
+            UnmapViewOfFile(mapping);
+        }
+        if (map_handle) {
+            CloseHandle(map_handle);
+        }
+        if (file_handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_handle);
+        }
+#else
+        if (mapping) {
+            munmap(mapping, mapped_size);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // False if the file is missing, empty or couldn't be mapped
+    bool is_open() const{
+        return mapping != nullptr;
+    }
+
+    const char *data() const{
+        return (const char *)mapping;
+    }
+
+    size_t size() const{
+        return mapped_size;
+    }
+};
+
+#endif
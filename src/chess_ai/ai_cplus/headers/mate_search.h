@@ -0,0 +1,279 @@
+#ifndef MATE_SEARCH_H
+#define MATE_SEARCH_H
+
+// Mate solver, a depth-first proof-number search (df-pn). Instead of scoring every line
+// like minimax it only asks "can the side to move force mate", and always works on the
+// part of the tree that is cheapest to prove or disprove. Forcing lines, where the
+// defender has few replies, get solved first, so deep mates are found with a tiny tree.
+//
+// The attacker is the side to move at the root. A mate in n moves is searched with
+// 2n - 1 plies left, positions are kept in the table per number of plies left, so a
+// position proven with more plies left isn't mistaken for one with fewer.
+// solve() tries mate in 1, 2, ... so the mate it finds is the shortest one
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <board_representation.h>
+
+// Entries of the node table if nothing else is asked for (16 MB)
+const size_t DEFAULT_MATE_ENTRIES = 1 << 20;
+// Nodes a mate search may visit if nothing else is asked for
+const uint64_t DEFAULT_MATE_NODES = 1 << 22;
+// Longest mate looked for, in moves of the attacker
+const int MAX_MATE_MOVES = 32;
+const int MAX_MATE_PLIES = 2 * MAX_MATE_MOVES - 1;
+// Proof and disproof numbers stop here, a node with one of them at infinity is solved
+const uint32_t PN_INFINITY = 1u << 30;
+
+struct MateEntry {
+    uint64_t key = 0;  // Position hash mixed with the plies left, 0 = empty slot
+    uint32_t pn = 1;   // Proof number, 0 = the attacker mates
+    uint32_t dn = 1;   // Disproof number, 0 = no mate within the plies left
+    int8_t move[4] = {-1, -1, -1, -1}; // Once proven: the mating move, or the longest defence
+    uint8_t distance = 0; // Once proven: plies to mate
+};
+
+struct MateResult {
+    bool found = false;
+    bool aborted = false; // Ran out of nodes before it could tell
+    int moves = 0;        // Mate in this many moves of the attacker
+    std::vector<std::array<int, 4>> line; // Attacker's moves and the defender's longest replies
+    uint64_t nodes = 0;
+};
+
+class MateSearch
+{
+private:
+    // A node being expanded, one per ply so the recursion keeps nothing big on the stack.
+    // The numbers of the children are kept here too, so a child pushed out of the table while
+    // the node is still working on it isn't lost
+    struct Frame {
+        MoveList moves;
+        std::array<uint64_t, MAX_MOVES> keys;
+        std::array<uint32_t, MAX_MOVES> pn;
+        std::array<uint32_t, MAX_MOVES> dn;
+        std::array<uint8_t, MAX_MOVES> distance;
+    };
+
+    std::vector<MateEntry> table;
+    uint64_t mask = 0;
+    std::vector<Frame> frames = std::vector<Frame>(MAX_MATE_PLIES + 1);
+    uint64_t nodes = 0;
+    uint64_t node_limit = DEFAULT_MATE_NODES;
+
+    static uint64_t entry_key(uint64_t hash, int plies){
+        uint64_t key = hash ^ ((uint64_t)(plies + 1) * 0x9E3779B97F4A7C15ULL);
+        return key ? key : 1;
+    }
+
+    // The entry of a position, a fresh one if it isn't in the table
+    MateEntry lookup(uint64_t key){
+        const MateEntry &entry = table[key & mask];
+        if (entry.key == key) {
+            return entry;
+        }
+        MateEntry fresh;
+        fresh.key = key;
+        return fresh;
+    }
+
+    void store(const MateEntry &entry){
+        table[entry.key & mask] = entry;
+    }
+
+    static uint32_t add_numbers(uint32_t a, uint32_t b){
+        return a + b >= PN_INFINITY ? PN_INFINITY : a + b;
+    }
+
+    // Search a node until it is solved or its proof or disproof number reaches its threshold.
+    // side is to move, attacking (an OR node) or defending (an AND node). Returns the node's entry
+    MateEntry mid(Board &board, int side, bool attacking, int plies, uint32_t pn_threshold, uint32_t dn_threshold){
+        nodes++;
+        uint64_t key = entry_key(board.get_hash(side), plies);
+        MateEntry node = lookup(key);
+        Frame &frame = frames[plies];
+        frame.moves.clear();
+        board.generate_moves(side, frame.moves);
+
+        // A defender without moves is mated if it is in check, anything else without moves
+        // or plies left can't be a mate any more
+        if (frame.moves.empty() || plies == 0) {
+            bool mated = !attacking && frame.moves.empty() && board.in_check(side);
+            node.pn = mated ? 0 : PN_INFINITY;
+            node.dn = mated ? PN_INFINITY : 0;
+            node.distance = 0;
+            store(node);
+            return node;
+        }
+        for (int i = 0; i < frame.moves.size; i++) {
+            const std::array<int, 4> &move = frame.moves[i];
+            board.move_piece(move[0], move[1], move[2], move[3]);
+            frame.keys[i] = entry_key(board.get_hash(-side), plies - 1);
+            MateEntry child = lookup(frame.keys[i]);
+            // With one move left only a check can mate, the rest are disproven without a visit
+            if (plies == 1 && child.pn != 0 && !board.in_check(-side)) {
+                child.pn = PN_INFINITY;
+                child.dn = 0;
+            }
+            frame.pn[i] = child.pn;
+            frame.dn[i] = child.dn;
+            frame.distance[i] = child.distance;
+            board.undo_move();
+        }
+
+        while (true) {
+            // An attacking node needs one proven child, a defending node all of them
+            uint32_t pn = attacking ? PN_INFINITY : 0;
+            uint32_t dn = attacking ? 0 : PN_INFINITY;
+            uint32_t best_number = PN_INFINITY, second_number = PN_INFINITY;
+            int best = 0;
+            int proof = -1;
+            for (int i = 0; i < frame.moves.size; i++) {
+                // The number the node works on, the proof number when attacking
+                uint32_t number = attacking ? frame.pn[i] : frame.dn[i];
+                if (attacking) {
+                    pn = std::min(pn, frame.pn[i]);
+                    dn = add_numbers(dn, frame.dn[i]);
+                } else {
+                    pn = add_numbers(pn, frame.pn[i]);
+                    dn = std::min(dn, frame.dn[i]);
+                }
+                if (number < best_number) {
+                    second_number = best_number;
+                    best_number = number;
+                    best = i;
+                } else if (number < second_number) {
+                    second_number = number;
+                }
+                // The quickest mate when attacking, the longest defence when defending
+                if (frame.pn[i] == 0 && (proof == -1 || (attacking ? frame.distance[i] < frame.distance[proof] : frame.distance[i] > frame.distance[proof]))) {
+                    proof = i;
+                }
+            }
+
+            if (pn == 0 || dn == 0 || pn >= pn_threshold || dn >= dn_threshold || nodes >= node_limit) {
+                node.pn = pn;
+                node.dn = dn;
+                if (pn == 0) {
+                    const std::array<int, 4> &move = frame.moves[proof];
+                    for (int j = 0; j < 4; j++) {
+                        node.move[j] = (int8_t)move[j];
+                    }
+                    node.distance = (uint8_t)(frame.distance[proof] + 1);
+                }
+                store(node);
+                return node;
+            }
+
+            // Go into the most promising child, until it is solved or another child looks better
+            uint32_t child_pn_threshold, child_dn_threshold;
+            if (attacking) {
+                child_pn_threshold = std::min(pn_threshold, add_numbers(second_number, 1));
+                child_dn_threshold = dn_threshold >= PN_INFINITY ? PN_INFINITY : dn_threshold - dn + frame.dn[best];
+            } else {
+                child_dn_threshold = std::min(dn_threshold, add_numbers(second_number, 1));
+                child_pn_threshold = pn_threshold >= PN_INFINITY ? PN_INFINITY : pn_threshold - pn + frame.pn[best];
+            }
+            std::array<int, 4> move = frame.moves[best];
+            board.move_piece(move[0], move[1], move[2], move[3]);
+            MateEntry child = mid(board, -side, !attacking, plies - 1, child_pn_threshold, child_dn_threshold);
+            board.undo_move();
+            frame.pn[best] = child.pn;
+            frame.dn[best] = child.dn;
+            frame.distance[best] = child.distance;
+        }
+    }
+
+    // Search a node until it is solved, false if the nodes ran out first
+    bool prove(Board &board, int side, bool attacking, int plies, MateEntry &entry){
+        entry = mid(board, side, attacking, plies, PN_INFINITY, PN_INFINITY);
+        return entry.pn == 0 || entry.dn == 0;
+    }
+
+    // Follow the proven moves from the root. Entries pushed out of the table on the way are proven again
+    bool mating_line(Board &board, int side, int plies, MateEntry root, std::vector<std::array<int, 4>> &line){
+        MateEntry entry = root;
+        bool attacking = true;
+        int made = 0;
+        bool ok = true;
+        while (entry.distance != 0) {
+            std::array<int, 4> move = {entry.move[0], entry.move[1], entry.move[2], entry.move[3]};
+            line.push_back(move);
+            board.move_piece(move[0], move[1], move[2], move[3]);
+            made++;
+            side = -side;
+            attacking = !attacking;
+            plies--;
+            entry = lookup(entry_key(board.get_hash(side), plies));
+            if (entry.pn != 0 && (!prove(board, side, attacking, plies, entry) || entry.pn != 0)) {
+                ok = false;
+                break;
+            }
+        }
+        for (int i = 0; i < made; i++) {
+            board.undo_move();
+        }
+        return ok;
+    }
+
+public:
+    MateSearch(size_t entries = DEFAULT_MATE_ENTRIES){
+        size_t size = 1;
+        while (size * 2 <= entries) {
+            size *= 2;
+        }
+        table.assign(size, MateEntry{});
+        mask = size - 1;
+    }
+
+    // Most entries a table can have in this many bytes, a power of two. 0 if not even one fits
+    static size_t entries_within(size_t bytes){
+        size_t entries = bytes / sizeof(MateEntry);
+        if (entries == 0) {
+            return 0;
+        }
+        size_t size = 1;
+        while (size * 2 <= entries) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    // Forget everything solved so far
+    void clear(){
+        std::fill(table.begin(), table.end(), MateEntry{});
+    }
+
+    size_t memory_usage() const{
+        return table.capacity() * sizeof(MateEntry) + frames.capacity() * sizeof(Frame);
+    }
+
+    // Look for the shortest mate of side (to move) in at most max_moves moves, visiting at
+    // most max_nodes nodes. The board is left as it was
+    MateResult solve(Board &board, int side, int max_moves = MAX_MATE_MOVES, uint64_t max_nodes = DEFAULT_MATE_NODES){
+        MateResult result;
+        nodes = 0;
+        node_limit = max_nodes;
+        max_moves = std::max(1, std::min(max_moves, MAX_MATE_MOVES));
+        for (int moves = 1; moves <= max_moves; moves++) {
+            int plies = 2 * moves - 1;
+            MateEntry root;
+            if (!prove(board, side, true, plies, root)) {
+                result.aborted = true;
+                break;
+            }
+            if (root.pn == 0) {
+                result.found = mating_line(board, side, plies, root, result.line);
+                result.aborted = !result.found;
+                result.moves = moves;
+                break;
+            }
+        }
+        result.nodes = nodes;
+        return result;
+    }
+};
+
+#endif
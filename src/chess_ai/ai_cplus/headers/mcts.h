@@ -0,0 +1,442 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+// Monte Carlo tree search (UCT), an engine to compare with the alpha-beta search.
+// Every iteration walks from the root to a leaf picking the child with the best upper
+// confidence bound, adds the leaf's children to the tree and backs up how likely the leaf
+// is to be won. Leaves are scored by evaluate_board turned into a win chance, or by a
+// short random playout first.
+//
+// Nodes come from a pool allocated once, a search never allocates a node on its own.
+// Several threads grow the same tree. A thread passing through a node adds a virtual
+// loss to it until its result is backed up, so the other threads look elsewhere meanwhile
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <board_representation.h>
+#include <search_algorithm.h>
+#include <trace.h>
+
+// Nodes of the tree if nothing else is asked for (32 MB)
+const size_t DEFAULT_MCTS_NODES = 1 << 20;
+// Iterations of a depth 1 search, every depth more doubles them. Deep searches (ponder and
+// movetime searches ask for depth 64) only end on a stop
+const uint64_t MCTS_DEPTH_ONE_ITERATIONS = 1000;
+const int MCTS_UNLIMITED_DEPTH = 32;
+// A stop is only obeyed after this many iterations, so every root move has been looked at
+const uint64_t MCTS_MIN_ITERATIONS = MAX_MOVES;
+// Most threads and playout plies that can be asked for
+const int MAX_MCTS_THREADS = 64;
+const int MAX_MCTS_PLAYOUT = 64;
+// Exploration constant of the upper confidence bound
+const double MCTS_EXPLORATION = 1.0;
+// Visits added as losses to a node while a thread is below it
+const int MCTS_VIRTUAL_LOSS = 3;
+// A leaf gets children on this visit, the visits before only score it
+const int MCTS_EXPAND_VISITS = 2;
+// Win chances are added up in fixed point, so they can be atomic
+const int64_t MCTS_VALUE_ONE = 1 << 16;
+// Eval units (a pawn is 10) for which the win chance goes from 50% to 1 / (1 + 10^-1), about 91%
+const double MCTS_SCORE_SCALE = 40.0;
+
+enum MctsExpansion : uint8_t {
+    MCTS_UNEXPANDED,
+    MCTS_EXPANDING, // A thread is adding the children
+    MCTS_EXPANDED
+};
+
+// What a node with no children is
+enum MctsTerminal : uint8_t {
+    MCTS_NOT_TERMINAL,
+    MCTS_DRAW,  // Stalemate, repetition or fifty moves
+    MCTS_MATED  // The side to move is mated
+};
+
+struct MctsNode {
+    std::atomic<int32_t> visits{0}; // Virtual losses of the threads below the node included
+    std::atomic<int64_t> value{0};  // Wins of the side that moved into the node, times MCTS_VALUE_ONE
+    std::atomic<uint8_t> expansion{MCTS_UNEXPANDED};
+    // Written before expansion becomes MCTS_EXPANDED, read after it is
+    uint8_t terminal = MCTS_NOT_TERMINAL;
+    uint16_t child_count = 0;
+    uint32_t first_child = 0; // Children are next to each other in the pool
+    int8_t move[4] = {-1, -1, -1, -1}; // Move into the node
+
+    void reset(const std::array<int, 4> &into){
+        visits.store(0, std::memory_order_relaxed);
+        value.store(0, std::memory_order_relaxed);
+        expansion.store(MCTS_UNEXPANDED, std::memory_order_relaxed);
+        terminal = MCTS_NOT_TERMINAL;
+        child_count = 0;
+        first_child = 0;
+        for (int i = 0; i < 4; i++) {
+            move[i] = (int8_t)into[i];
+        }
+    }
+};
+
+struct MctsConfig {
+    int threads = 1;
+    int playout_plies = 0; // Random moves played from a leaf before it is evaluated, 0 = none
+};
+
+// Chance of white winning a position of this score, and back
+double mcts_win_chance(double score) {
+    return 1.0 / (1.0 + std::pow(10.0, -score / MCTS_SCORE_SCALE));
+}
+
+int mcts_chance_to_score(double chance) {
+    chance = std::max(0.001, std::min(0.999, chance));
+    return (int)std::lround(-MCTS_SCORE_SCALE * std::log10(1.0 / chance - 1.0));
+}
+
+class MctsSearch
+{
+private:
+    std::unique_ptr<MctsNode[]> pool;
+    size_t pool_size = 0;
+    std::atomic<size_t> used{0};
+    std::atomic<bool> full{false};
+    std::atomic<uint64_t> iterations{0};
+    std::atomic<int> seldepth{0};
+
+    // Room for count children next to each other, false once the pool has run out
+    bool allocate(size_t count, uint32_t &first){
+        if (full.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        size_t start = used.fetch_add(count);
+        if (start + count > pool_size) {
+            full = true;
+            return false;
+        }
+        first = (uint32_t)start;
+        return true;
+    }
+
+    // Add the children of a leaf. False if another thread is doing it or the pool is full,
+    // the leaf is then scored as it is
+    bool expand(MctsNode &node, Board &board, int side){
+        TRACE_SCOPE("mcts_expand");
+        uint8_t expected = MCTS_UNEXPANDED;
+        if (!node.expansion.compare_exchange_strong(expected, MCTS_EXPANDING)) {
+            return expected == MCTS_EXPANDED;
+        }
+        MoveList moves;
+        if (board.is_repetition() || board.is_fifty_move_draw()) {
+            node.terminal = MCTS_DRAW;
+        } else {
+            board.generate_moves(side, moves);
+            if (moves.empty()) {
+                node.terminal = board.in_check(side) ? MCTS_MATED : MCTS_DRAW;
+            }
+        }
+        uint32_t first = 0;
+        if (!moves.empty() && !allocate(moves.size, first)) {
+            node.expansion.store(MCTS_UNEXPANDED, std::memory_order_release);
+            return false;
+        }
+        // Captures first, unvisited children are tried in order
+        uint32_t next = first;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < moves.size; i++) {
+                if ((board.piece_at(moves[i][2], moves[i][3]) != 0) == (pass == 0)) {
+                    pool[next++].reset(moves[i]);
+                }
+            }
+        }
+        node.first_child = first;
+        node.child_count = (uint16_t)moves.size;
+        node.expansion.store(MCTS_EXPANDED, std::memory_order_release);
+        return true;
+    }
+
+    // The child with the best upper confidence bound, the first unvisited one if there is one
+    uint32_t select(const MctsNode &node){
+        double log_visits = std::log((double)std::max(1, node.visits.load(std::memory_order_relaxed)));
+        uint32_t best = node.first_child;
+        double best_bound = -1.0;
+        for (uint32_t i = node.first_child; i < node.first_child + node.child_count; i++) {
+            const MctsNode &child = pool[i];
+            int visits = child.visits.load(std::memory_order_relaxed);
+            if (visits <= 0) {
+                return i;
+            }
+            double wins = (double)child.value.load(std::memory_order_relaxed) / MCTS_VALUE_ONE;
+            double bound = wins / visits + MCTS_EXPLORATION * std::sqrt(log_visits / visits);
+            if (bound > best_bound) {
+                best_bound = bound;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    // Chance the side that moved into a leaf wins, side is to move in it
+    double score_leaf(const MctsNode &leaf, Board &board, int side, int playout_plies, std::mt19937 &random){
+        TRACE_SCOPE("mcts_score");
+        if (leaf.expansion.load(std::memory_order_acquire) == MCTS_EXPANDED && leaf.terminal != MCTS_NOT_TERMINAL) {
+            return leaf.terminal == MCTS_MATED ? 1.0 : 0.5;
+        }
+        if (board.is_repetition() || board.is_fifty_move_draw()) {
+            return 0.5;
+        }
+        // Random moves until the plies run out or the game ends
+        double chance = -1.0;
+        int to_move = side;
+        int made = 0;
+        MoveList moves;
+        while (made < playout_plies) {
+            moves.clear();
+            board.generate_moves(to_move, moves);
+            if (moves.empty()) {
+                double draw_or_mated = board.in_check(to_move) ? 0.0 : 0.5; // For to_move
+                chance = to_move == side ? 1.0 - draw_or_mated : draw_or_mated;
+                break;
+            }
+            const std::array<int, 4> &move = moves[std::uniform_int_distribution<int>(0, moves.size - 1)(random)];
+            board.move_piece(move[0], move[1], move[2], move[3]);
+            to_move = -to_move;
+            made++;
+        }
+        if (chance < 0.0) {
+            double white = mcts_win_chance(board.get_board_value());
+            chance = side == 1 ? 1.0 - white : white;
+        }
+        for (int i = 0; i < made; i++) {
+            board.undo_move();
+        }
+        return chance;
+    }
+
+    // One walk down the tree and back up. The board is left as it was
+    void iterate(Board &board, int side, int playout_plies, std::mt19937 &random, int &deepest){
+        std::array<uint32_t, MAX_PLY + 1> path;
+        int length = 0;
+        uint32_t index = 0;
+        path[length++] = index;
+        while (true) {
+            MctsNode &node = pool[index];
+            if (node.expansion.load(std::memory_order_acquire) != MCTS_EXPANDED) {
+                // Our own virtual loss is in the visits already
+                bool ready = length == 1 || node.visits.load(std::memory_order_relaxed) - MCTS_VIRTUAL_LOSS >= MCTS_EXPAND_VISITS - 1;
+                if (!ready || length > MAX_PLY || !expand(node, board, side)) {
+                    break;
+                }
+            }
+            if (node.child_count == 0 || length > MAX_PLY) {
+                break;
+            }
+            index = select(node);
+            MctsNode &child = pool[index];
+            child.visits.fetch_add(MCTS_VIRTUAL_LOSS, std::memory_order_relaxed);
+            board.move_piece(child.move[0], child.move[1], child.move[2], child.move[3]);
+            path[length++] = index;
+            side = -side;
+        }
+        deepest = std::max(deepest, length - 1);
+
+        // Taking the virtual loss back, each node is scored for the side that moved into it
+        double chance = score_leaf(pool[index], board, side, playout_plies, random);
+        for (int i = length - 1; i >= 0; i--) {
+            MctsNode &node = pool[path[i]];
+            node.value.fetch_add((int64_t)(chance * MCTS_VALUE_ONE), std::memory_order_relaxed);
+            node.visits.fetch_add(i == 0 ? 1 : 1 - MCTS_VIRTUAL_LOSS, std::memory_order_relaxed);
+            chance = 1.0 - chance;
+        }
+        for (int i = 1; i < length; i++) {
+            board.undo_move();
+        }
+    }
+
+    // Most visited child, the move that was looked at the most is the one trusted the most
+    int best_child(const MctsNode &node) const{
+        int best = -1;
+        int best_visits = -1;
+        for (uint32_t i = node.first_child; i < node.first_child + node.child_count; i++) {
+            int visits = pool[i].visits.load(std::memory_order_relaxed);
+            if (visits > best_visits) {
+                best_visits = visits;
+                best = (int)i;
+            }
+        }
+        return best;
+    }
+
+    // Best move and its score, from white's side like the minimax scores
+    MiniMaxResult root_result(int side) const{
+        const MctsNode &root = pool[0];
+        if (root.expansion.load(std::memory_order_acquire) != MCTS_EXPANDED || root.child_count == 0) {
+            return {0, {-1, -1, -1, -1}};
+        }
+        const MctsNode &child = pool[best_child(root)];
+        std::array<int, 4> move = {child.move[0], child.move[1], child.move[2], child.move[3]};
+        if (child.expansion.load(std::memory_order_acquire) == MCTS_EXPANDED && child.terminal == MCTS_MATED) {
+            return {side * (MATE_SCORE - 1), move};
+        }
+        int visits = std::max(1, child.visits.load(std::memory_order_relaxed));
+        double chance = (double)child.value.load(std::memory_order_relaxed) / MCTS_VALUE_ONE / visits;
+        return {mcts_chance_to_score(side == 1 ? chance : 1.0 - chance), move};
+    }
+
+    // The most visited line
+    std::string principal_variation() const{
+        std::string pv = "";
+        uint32_t index = 0;
+        while (pool[index].expansion.load(std::memory_order_acquire) == MCTS_EXPANDED && pool[index].child_count > 0) {
+            index = (uint32_t)best_child(pool[index]);
+            const MctsNode &node = pool[index];
+            if (node.visits.load(std::memory_order_relaxed) == 0) {
+                break;
+            }
+            pv += (pv.empty() ? "" : " ") + move_to_string({node.move[0], node.move[1], node.move[2], node.move[3]});
+        }
+        return pv;
+    }
+
+public:
+    MctsConfig config;
+
+    MctsSearch(size_t nodes = 0){
+        resize(nodes);
+    }
+
+    // Change the number of nodes the tree can have, 0 gives the memory back
+    void resize(size_t nodes){
+        pool.reset();
+        pool_size = nodes;
+        if (nodes > 0) {
+            pool.reset(new MctsNode[nodes]);
+        }
+    }
+
+    size_t capacity() const{
+        return pool_size;
+    }
+
+    // Nodes in the tree of the last search
+    size_t tree_size() const{
+        return std::min(used.load(), pool_size);
+    }
+
+    // Root of the last search, its children are the root moves
+    const MctsNode &node(uint32_t index) const{
+        return pool[index];
+    }
+
+    uint64_t last_iterations() const{
+        return iterations.load();
+    }
+
+    static size_t nodes_within(size_t bytes){
+        return bytes / sizeof(MctsNode);
+    }
+
+    size_t memory_usage() const{
+        return pool_size * sizeof(MctsNode);
+    }
+
+    // Iterations a search of this depth runs, if it isn't stopped first
+    static uint64_t iterations_for_depth(int depth){
+        if (depth >= MCTS_UNLIMITED_DEPTH) {
+            return UINT64_MAX;
+        }
+        return MCTS_DEPTH_ONE_ITERATIONS << (std::max(depth, 1) - 1);
+    }
+
+    // Search the position with config.threads threads until the iterations of the depth are done
+    // or state.stop is set. Fills in the same parts of state a minimax search does, so
+    // "bestmove" and "stats" work on it too
+    MiniMaxResult search(Board &board, int depth, bool maximizing_player, SearchState &state){
+        TRACE_SCOPE("mcts");
+        int side = maximizing_player ? 1 : -1;
+        state.start_time = std::chrono::steady_clock::now();
+        state.searching = true;
+        state.completed_depth = 0;
+        state.best_so_far = pack_result({0, {-1, -1, -1, -1}});
+        state.stats.reset();
+        if (pool_size == 0) {
+            resize(DEFAULT_MCTS_NODES);
+        }
+        pool[0].reset({-1, -1, -1, -1});
+        used = 1;
+        full = false;
+        iterations = 0;
+        seldepth = 0;
+        uint64_t limit = iterations_for_depth(depth);
+        int threads = std::max(1, std::min(config.threads, MAX_MCTS_THREADS));
+        int playout_plies = std::max(0, std::min(config.playout_plies, MAX_MCTS_PLAYOUT));
+
+        // Thread 0 is this one, it also keeps the best move so far up to date
+        auto work = [&](int thread, Board thread_board) {
+            std::mt19937 random((uint32_t)(board.get_hash(side) + thread));
+            int deepest = 0;
+            uint64_t counted = 0;
+            while (true) {
+                uint64_t done = iterations.fetch_add(1);
+                if (done >= limit || (done >= MCTS_MIN_ITERATIONS && state.stop.load(std::memory_order_relaxed))) {
+                    break;
+                }
+                iterate(thread_board, side, playout_plies, random, deepest);
+                if (thread == 0 && (done & 1023) == 0) {
+                    state.best_so_far = pack_result(root_result(side));
+                    state.stats.nodes.add(done - counted);
+                    counted = done;
+                }
+            }
+            int previous = seldepth.load();
+            while (deepest > previous && !seldepth.compare_exchange_weak(previous, deepest)) {
+            }
+        };
+        std::vector<std::thread> helpers;
+        for (int t = 1; t < threads; t++) {
+            helpers.emplace_back(work, t, board);
+        }
+        work(0, board);
+        for (std::thread &helper : helpers) {
+            helper.join();
+        }
+        // The counter went past the limit once for every thread that ended
+        iterations = std::min(iterations.load() - threads, limit);
+
+        MiniMaxResult result = root_result(side);
+        state.best_so_far = pack_result(result);
+        state.stats.nodes.reset();
+        state.stats.nodes.add(iterations);
+        state.stats.seldepth.reset();
+        state.stats.seldepth.add(seldepth);
+        state.search_time_ms = elapsed_ms(state);
+        state.searching = false;
+        if (state.print_progress) {
+            print_info(state, result, threads, playout_plies);
+        }
+        return result;
+    }
+
+    // An info line like the minimax iterations print, and the tree's statistics as JSON
+    void print_info(SearchState &state, const MiniMaxResult &result, int threads, int playout_plies){
+        int64_t time_ms = elapsed_ms(state);
+        uint64_t done = iterations;
+        uint64_t per_second = done * 1000 / (time_ms > 0 ? time_ms : 1);
+        std::lock_guard<std::mutex> lock(output_mutex());
+        std::cout << "info depth " << seldepth << " score " << score_to_string(result.score) << " time " << time_ms
+                  << " nodes " << done << " nps " << per_second << " pv " << principal_variation() << std::endl;
+        std::cout << "info string mcts {\"iterations\":" << done << ",\"time_ms\":" << time_ms
+                  << ",\"iterations_per_second\":" << per_second << ",\"threads\":" << threads
+                  << ",\"playout_plies\":" << playout_plies << ",\"tree_nodes\":" << tree_size()
+                  << ",\"capacity\":" << pool_size << ",\"tree_full\":" << (full ? "true" : "false")
+                  << ",\"seldepth\":" << seldepth << "}" << std::endl;
+    }
+};
+
+#endif
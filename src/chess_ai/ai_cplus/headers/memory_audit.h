@@ -0,0 +1,193 @@
+#ifndef MEMORY_AUDIT_H
+#define MEMORY_AUDIT_H
+
+// Where the engine's heap memory goes. Build with -DMEMORY_AUDIT and the global operator
+// new and delete are replaced by ones that count every allocation and its bytes, by the
+// phase of the engine the allocating thread is in. Without the flag nothing is counted
+// and MemoryPhaseScope does nothing.
+// The replacements are defined in this header, so with the flag only one translation unit
+// of a program may include it (the engine and the tools are all built as one)
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+#if defined(__linux__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+// What the engine is doing, allocations are counted per phase
+enum MemoryPhase {
+    MEMORY_STARTUP,  // Before the first command
+    MEMORY_COMMANDS, // Reading and answering commands
+    MEMORY_SETUP,    // Setting up a position and handing it to the search
+    MEMORY_SEARCH,   // Searching, pondering included
+    MEMORY_REPORT,   // Printing the result of a search
+    NUM_MEMORY_PHASES
+};
+
+const char *const MEMORY_PHASE_NAMES[NUM_MEMORY_PHASES] = {"startup", "commands", "setup", "search", "report"};
+
+// Bytes of the process in physical memory, 0 where that can't be found out
+inline size_t process_resident_bytes() {
+#if defined(__linux__)
+    FILE *file = std::fopen("/proc/self/statm", "r");
+    if (!file) {
+        return 0;
+    }
+    unsigned long size = 0, resident = 0;
+    int read = std::fscanf(file, "%lu %lu", &size, &resident);
+    std::fclose(file);
+    return read == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    return K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#else
+    return 0;
+#endif
+}
+
+#ifdef MEMORY_AUDIT
+
+#include <cstdlib>
+#include <new>
+
+struct PhaseAllocations {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> bytes_allocated;
+    std::atomic<uint64_t> bytes_freed;
+};
+
+struct MemoryAudit {
+    PhaseAllocations phases[NUM_MEMORY_PHASES];
+    std::atomic<int64_t> live_bytes;
+    std::atomic<int64_t> peak_bytes;
+};
+
+// Zero initialised before anything runs, so allocations of static constructors are counted too
+inline MemoryAudit &memory_audit() {
+    static MemoryAudit audit;
+    return audit;
+}
+
+inline MemoryPhase &memory_phase() {
+    thread_local MemoryPhase phase = MEMORY_STARTUP;
+    return phase;
+}
+
+inline void memory_audit_allocated(size_t bytes) {
+    MemoryAudit &audit = memory_audit();
+    PhaseAllocations &phase = audit.phases[memory_phase()];
+    phase.allocations.fetch_add(1, std::memory_order_relaxed);
+    phase.bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+    int64_t live = audit.live_bytes.fetch_add((int64_t)bytes, std::memory_order_relaxed) + (int64_t)bytes;
+    int64_t peak = audit.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !audit.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+// Freed memory counts against the phase freeing it, not the one that allocated it
+inline void memory_audit_freed(size_t bytes) {
+    MemoryAudit &audit = memory_audit();
+    PhaseAllocations &phase = audit.phases[memory_phase()];
+    phase.frees.fetch_add(1, std::memory_order_relaxed);
+    phase.bytes_freed.fetch_add(bytes, std::memory_order_relaxed);
+    audit.live_bytes.fetch_sub((int64_t)bytes, std::memory_order_relaxed);
+}
+
+// Every block starts with its size, so deleting it knows how many bytes go.
+// The header keeps the alignment malloc gives
+const size_t MEMORY_AUDIT_HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size) {
+    char *block = (char *)std::malloc(size + MEMORY_AUDIT_HEADER);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *(size_t *)block = size;
+    memory_audit_allocated(size);
+    return block + MEMORY_AUDIT_HEADER;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    char *block = (char *)ptr - MEMORY_AUDIT_HEADER;
+    memory_audit_freed(*(size_t *)block);
+    std::free(block);
+}
+
+void operator delete[](void *ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+inline bool memory_audit_enabled() {
+    return true;
+}
+
+// The counts of every phase and the live and peak heap bytes, as JSON members
+inline void print_memory_audit(std::ostream &out) {
+    MemoryAudit &audit = memory_audit();
+    out << "\"heap_live\":" << audit.live_bytes.load() << ",\"heap_peak\":" << audit.peak_bytes.load() << ",\"phases\":{";
+    for (int i = 0; i < NUM_MEMORY_PHASES; i++) {
+        const PhaseAllocations &phase = audit.phases[i];
+        out << (i > 0 ? "," : "") << "\"" << MEMORY_PHASE_NAMES[i] << "\":{\"allocations\":" << phase.allocations.load()
+            << ",\"bytes\":" << phase.bytes_allocated.load() << ",\"frees\":" << phase.frees.load()
+            << ",\"bytes_freed\":" << phase.bytes_freed.load() << "}";
+    }
+    out << "}";
+}
+
+// Puts the calling thread in a phase until the end of the scope
+class MemoryPhaseScope
+{
+private:
+    MemoryPhase previous;
+
+public:
+    MemoryPhaseScope(MemoryPhase phase) : previous(memory_phase()){
+        memory_phase() = phase;
+    }
+    ~MemoryPhaseScope(){
+        memory_phase() = previous;
+    }
+};
+
+#else
+
+inline bool memory_audit_enabled() {
+    return false;
+}
+inline void print_memory_audit(std::ostream &) {
+}
+
+class MemoryPhaseScope
+{
+public:
+    MemoryPhaseScope(MemoryPhase){
+    }
+};
+
+#endif
+
+#endif
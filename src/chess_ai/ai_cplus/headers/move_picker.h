@@ -0,0 +1,169 @@
+#ifndef MOVE_PICKER_H
+#define MOVE_PICKER_H
+
+#include <array>
+#include <cstdlib>
+#include <board_representation.h>
+
+// Piece values used to order captures, indexed by the absolute piece number
+const int CAPTURE_VALUES[7] = {0, 100, 500, 300, 300, 10000, 900};
+
+// Order the picker hands out moves in
+enum PickStage {
+    PICK_HASH_MOVE,
+    PICK_GEN_CAPTURES,
+    PICK_GOOD_CAPTURES,
+    PICK_KILLERS,
+    PICK_GEN_QUIETS,
+    PICK_QUIETS,
+    PICK_BAD_CAPTURES,
+    PICK_DONE
+};
+
+// Hands out the moves of a node one at a time, best guess first. Each kind of move is
+// only generated once the ones before it are used up, so a node that cuts off on the
+// hash move or a capture never generates its quiet moves.
+// The moves are pseudo legal, the caller has to check that its king isn't left in check
+class MovePicker
+{
+private:
+    Board *board;
+    int side;
+    MoveList &moves; // Captures first, then the quiet moves
+    std::array<int, 4> hash_move;
+    const std::array<std::array<int, 4>, 2> &killers;
+    std::array<int, MAX_MOVES> scores;
+    int stage;
+    int current = 0;
+    int captures_end = 0;
+    int killer_index = 0;
+    int quiet_index = 0;
+
+    static bool is_no_move(const std::array<int, 4> &move){
+        return move[0] < 0;
+    }
+
+    // The moves handed out before the generated ones, they are skipped when generated
+    bool already_picked(const std::array<int, 4> &move){
+        return move == hash_move || move == killers[0] || move == killers[1];
+    }
+
+    // Most valuable victim first, least valuable attacker breaking ties.
+    // A capture that loses material to a recapture is bad and sorted to the back
+    int capture_score(const std::array<int, 4> &move){
+        int attacker = CAPTURE_VALUES[std::abs(board->piece_at(move[0], move[1]))];
+        int target = board->piece_at(move[2], move[3]);
+        int victim = CAPTURE_VALUES[target == 0 ? 1 : std::abs(target)]; // Empty means en passant
+        int score = victim * 16 - attacker / 100;
+        if (victim < attacker && board->square_attacked(move[2], move[3], -side)) {
+            score -= 1000000;
+        }
+        return score;
+    }
+
+    // Swap the best scored move from current on to the front, and return its score
+    int select_best(int end){
+        int best = current;
+        for (int i = current + 1; i < end; i++) {
+            if (scores[i] > scores[best]) {
+                best = i;
+            }
+        }
+        std::swap(moves[current], moves[best]);
+        std::swap(scores[current], scores[best]);
+        return scores[current];
+    }
+
+    // Killers are only used if they are quiet moves in this position too
+    bool usable_killer(const std::array<int, 4> &move){
+        if (is_no_move(move) || move == hash_move || board->piece_at(move[2], move[3]) != 0) {
+            return false;
+        }
+        // A pawn moving sideways onto an empty square is an en passant capture
+        if (std::abs(board->piece_at(move[0], move[1])) == 1 && move[1] != move[3]) {
+            return false;
+        }
+        return board->is_pseudo_legal(side, move);
+    }
+
+public:
+    MovePicker(Board *board, int side, MoveList &moves, const std::array<int, 4> &hash_move, const std::array<std::array<int, 4>, 2> &killers)
+        : board(board), side(side), moves(moves), hash_move(hash_move), killers(killers){
+        stage = PICK_HASH_MOVE;
+        moves.clear();
+        if (is_no_move(hash_move) || !board->is_pseudo_legal(side, hash_move)) {
+            this->hash_move = {-1, -1, -1, -1};
+            stage = PICK_GEN_CAPTURES;
+        }
+    }
+
+    // Put the next move in move, false when there are none left
+    bool next(std::array<int, 4> &move){
+        while (true) {
+            switch (stage) {
+                case PICK_HASH_MOVE:
+                    stage = PICK_GEN_CAPTURES;
+                    move = hash_move;
+                    return true;
+                case PICK_GEN_CAPTURES:
+                    board->generate_moves(side, moves, GEN_CAPTURES, false);
+                    captures_end = moves.size;
+                    for (int i = 0; i < captures_end; i++) {
+                        scores[i] = capture_score(moves[i]);
+                    }
+                    stage = PICK_GOOD_CAPTURES;
+                    break;
+                case PICK_GOOD_CAPTURES:
+                    while (current < captures_end) {
+                        if (select_best(captures_end) < 0) {
+                            break; // Only bad captures left, they wait until the end
+                        }
+                        move = moves[current++];
+                        if (move != hash_move) {
+                            return true;
+                        }
+                    }
+                    stage = PICK_KILLERS;
+                    break;
+                case PICK_KILLERS:
+                    while (killer_index < 2) {
+                        move = killers[killer_index++];
+                        if (usable_killer(move) && (killer_index == 1 || move != killers[0])) {
+                            return true;
+                        }
+                    }
+                    stage = PICK_GEN_QUIETS;
+                    break;
+                case PICK_GEN_QUIETS:
+                    quiet_index = moves.size;
+                    board->generate_moves(side, moves, GEN_QUIETS, false);
+                    stage = PICK_QUIETS;
+                    break;
+                case PICK_QUIETS:
+                    // Quiet moves are handed out in generation order
+                    while (quiet_index < moves.size) {
+                        move = moves[quiet_index++];
+                        if (!already_picked(move)) {
+                            return true;
+                        }
+                    }
+                    stage = PICK_BAD_CAPTURES;
+                    break;
+                case PICK_BAD_CAPTURES:
+                    while (current < captures_end) {
+                        select_best(captures_end);
+                        move = moves[current++];
+                        if (move != hash_move) {
+                            return true;
+                        }
+                    }
+                    stage = PICK_DONE;
+                    break;
+                default:
+                    return false;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef PACKED_POSITION_H
+#define PACKED_POSITION_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <board_representation.h>
+#include <mapped_file.h>
+
+// A position from a game, the move played in it and how the game ended, in 32 bytes
+struct PackedPosition {
+    uint64_t occupied;        // Bit row * 8 + col is set for every square with a piece
+    uint8_t pieces[16];       // piece + 6 for each set bit of occupied, 4 bits each, low bits first
+    uint8_t state;            // Bit 0 = black to move, bits 1-4 the castling rights of get_castle_rights
+    int8_t en_passant_col;    // -1 if there is none
+    uint8_t halfmove_clock;
+    int8_t result;            // 1 = white won, 0 = draw, -1 = black won
+    uint16_t fullmove_number;
+    uint16_t move;            // from * 64 + to, squares numbered row * 8 + col
+};
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition has to stay 32 bytes");
+
+PackedPosition pack_position(Board &board, int side, const std::array<int, 4> &move, int result) {
+    PackedPosition packed;
+    std::memset(&packed, 0, sizeof(packed));
+    std::array<std::array<int, 8>, 8> squares = board.get_board();
+    int count = 0;
+    for (int square = 0; square < 64; square++) {
+        int piece = squares[square / 8][square % 8];
+        if (piece != 0 && count < 32) {
+            packed.occupied |= 1ULL << square;
+            packed.pieces[count / 2] |= (piece + 6) << (4 * (count % 2));
+            count++;
+        }
+    }
+    packed.state = (side == -1 ? 1 : 0) | (board.get_castle_rights() << 1);
+    packed.en_passant_col = (int8_t)board.get_en_passant_col();
+    packed.halfmove_clock = (uint8_t)std::min(board.get_halfmove_clock(), 255);
+    packed.result = (int8_t)result;
+    packed.fullmove_number = (uint16_t)std::min(board.get_fullmove_number(), 65535);
+    packed.move = (uint16_t)((move[0] * 8 + move[1]) * 64 + move[2] * 8 + move[3]);
+    return packed;
+}
+
+// The board of a packed position, row 0 is rank 8 like in Board
+std::array<std::array<int, 8>, 8> unpack_board(const PackedPosition &packed) {
+    std::array<std::array<int, 8>, 8> board{};
+    int count = 0;
+    for (int square = 0; square < 64; square++) {
+        if (packed.occupied & (1ULL << square)) {
+            board[square / 8][square % 8] = ((packed.pieces[count / 2] >> (4 * (count % 2))) & 15) - 6;
+            count++;
+        }
+    }
+    return board;
+}
+
+int unpacked_side(const PackedPosition &packed) {
+    return packed.state & 1 ? -1 : 1;
+}
+
+std::array<int, 4> unpack_move(const PackedPosition &packed) {
+    int from = packed.move / 64;
+    int to = packed.move % 64;
+    return {from / 8, from % 8, to / 8, to % 8};
+}
+
+// The FEN of a packed position, to set up a Board with
+std::string unpack_fen(const PackedPosition &packed) {
+    std::array<std::array<int, 8>, 8> board = unpack_board(packed);
+    std::string fen;
+    for (int row = 0; row < 8; row++) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            if (board[row][col] == 0) {
+                empty++;
+                continue;
+            }
+            if (empty > 0) {
+                fen += (char)('0' + empty);
+                empty = 0;
+            }
+            fen += number_to_piece.at(board[row][col]);
+        }
+        if (empty > 0) {
+            fen += (char)('0' + empty);
+        }
+        if (row < 7) {
+            fen += '/';
+        }
+    }
+    fen += unpacked_side(packed) == 1 ? " w " : " b ";
+    int castle = packed.state >> 1;
+    if (castle == 0) {
+        fen += '-';
+    }
+    // Same order as get_castle_rights: white queen-, king-side, black queen-, king-side
+    const char castle_letters[4] = {'Q', 'K', 'q', 'k'};
+    for (int bit : {1, 0, 3, 2}) {
+        if (castle & (1 << bit)) {
+            fen += castle_letters[bit];
+        }
+    }
+    fen += ' ';
+    if (packed.en_passant_col == -1) {
+        fen += '-';
+    } else {
+        fen += (char)('a' + packed.en_passant_col);
+        fen += unpacked_side(packed) == 1 ? '6' : '3';
+    }
+    fen += " " + std::to_string(packed.halfmove_clock) + " " + std::to_string(packed.fullmove_number);
+    return fen;
+}
+
+// A dataset file is this header followed by the packed positions, back to back
+struct DatasetHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+const char DATASET_MAGIC[4] = {'C', 'P', 'O', 'S'};
+const uint32_t DATASET_VERSION = 1;
+
+// Appends positions to a dataset file. Threads fill their own chunk and hand it over whole,
+// the order of the chunks in the file is the order they arrive in
+class DatasetWriter
+{
+private:
+    FILE *file;
+    std::mutex mutex;
+    uint64_t written = 0;
+
+public:
+    DatasetWriter(const std::string &path) : file(std::fopen(path.c_str(), "wb")){
+        if (file) {
+            DatasetHeader header = {{DATASET_MAGIC[0], DATASET_MAGIC[1], DATASET_MAGIC[2], DATASET_MAGIC[3]}, DATASET_VERSION, sizeof(PackedPosition), 0};
+            std::fwrite(&header, sizeof(header), 1, file);
+        }
+    }
+
+    ~DatasetWriter(){
+        if (file) {
+            std::fclose(file);
+        }
+    }
+
+    DatasetWriter(const DatasetWriter &) = delete;
+    DatasetWriter &operator=(const DatasetWriter &) = delete;
+
+    bool is_open(){
+        return file != nullptr;
+    }
+
+    // Write a chunk and empty it
+    bool write(std::vector<PackedPosition> &chunk){
+        std::lock_guard<std::mutex> lock(mutex);
+        bool ok = std::fwrite(chunk.data(), sizeof(PackedPosition), chunk.size(), file) == chunk.size();
+        written += chunk.size();
+        chunk.clear();
+        return ok;
+    }
+
+    uint64_t positions_written(){
+        return written;
+    }
+};
+
+// A dataset file mapped into memory, the positions are read straight from the mapping
+class DatasetFile
+{
+private:
+    MappedFile file;
+    const PackedPosition *positions = nullptr;
+    size_t count = 0;
+
+public:
+    DatasetFile(const std::string &path) : file(path, true){
+        if (file.size() < sizeof(DatasetHeader)) {
+            return;
+        }
+        const DatasetHeader *header = (const DatasetHeader *)file.data();
+        if (std::memcmp(header->magic, DATASET_MAGIC, 4) != 0 || header->version != DATASET_VERSION || header->record_size != sizeof(PackedPosition)) {
+            return;
+        }
+        positions = (const PackedPosition *)(file.data() + sizeof(DatasetHeader));
+        count = (file.size() - sizeof(DatasetHeader)) / sizeof(PackedPosition);
+    }
+
+    // False if the file is missing or isn't a dataset of this version
+    bool is_open(){
+        return positions != nullptr;
+    }
+
+    size_t size() const{
+        return count;
+    }
+
+    const PackedPosition &operator[](size_t i) const{
+        return positions[i];
+    }
+
+    const PackedPosition *begin() const{
+        return positions;
+    }
+
+    const PackedPosition *end() const{
+        return positions + count;
+    }
+};
+
+#endif
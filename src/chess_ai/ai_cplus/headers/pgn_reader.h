@@ -0,0 +1,285 @@
+#ifndef PGN_READER_H
+#define PGN_READER_H
+
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <board_representation.h>
+
+const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Result of a game that isn't finished ("*")
+const int PGN_NO_RESULT = 2;
+
+struct PgnGame {
+    std::string fen = START_FEN; // From the FEN tag if there is one
+    int result = PGN_NO_RESULT;  // 1 = white won, 0 = draw, -1 = black won
+    std::vector<std::string> moves; // Main line in SAN, without move numbers and annotations
+};
+
+// Reads the games of a PGN file one at a time, through a fixed size buffer so the file
+// can be any size. Comments, variations and NAGs are skipped, tags other than FEN and
+// Result are ignored
+class PgnReader
+{
+private:
+    FILE *file;
+    bool owns_file;
+    std::vector<char> buffer;
+    size_t position = 0;
+    size_t filled = 0;
+
+    // Next character without taking it, EOF at the end of the file
+    int peek(){
+        if (position == filled) {
+            filled = file ? std::fread(buffer.data(), 1, buffer.size(), file) : 0;
+            position = 0;
+            if (filled == 0) {
+                return EOF;
+            }
+        }
+        return (unsigned char)buffer[position];
+    }
+
+    int get(){
+        int c = peek();
+        if (c != EOF) {
+            position++;
+        }
+        return c;
+    }
+
+    void skip_until(char end){
+        int c;
+        while ((c = get()) != EOF && c != end) {
+        }
+    }
+
+    // Skip a variation, they can hold comments and other variations
+    void skip_variation(){
+        int depth = 1;
+        int c;
+        while (depth > 0 && (c = get()) != EOF) {
+            if (c == '(') {
+                depth++;
+            } else if (c == ')') {
+                depth--;
+            } else if (c == '{') {
+                skip_until('}');
+            } else if (c == ';') {
+                skip_until('\n');
+            }
+        }
+    }
+
+    void read_tag(PgnGame &game){
+        std::string name;
+        std::string value;
+        int c;
+        while ((c = get()) != EOF && c != ']' && c != '"') {
+            if (!std::isspace(c)) {
+                name += (char)c;
+            }
+        }
+        if (c == '"') {
+            while ((c = get()) != EOF && c != '"') {
+                if (c == '\\') {
+                    c = get(); // Escaped quote or backslash
+                }
+                value += (char)c;
+            }
+            skip_until(']');
+        }
+        if (name == "FEN") {
+            game.fen = value;
+        } else if (name == "Result") {
+            game.result = parse_result(value);
+        }
+    }
+
+public:
+    PgnReader(const std::string &path) : file(std::fopen(path.c_str(), "rb")), owns_file(true), buffer(1 << 20){
+    }
+
+    // Read from a file that is already open, it is not closed by the reader
+    PgnReader(FILE *file) : file(file), owns_file(false), buffer(1 << 20){
+    }
+
+    ~PgnReader(){
+        if (file && owns_file) {
+            std::fclose(file);
+        }
+    }
+
+    PgnReader(const PgnReader &) = delete;
+    PgnReader &operator=(const PgnReader &) = delete;
+
+    bool is_open(){
+        return file != nullptr;
+    }
+
+    static int parse_result(const std::string &text){
+        if (text == "1-0") {
+            return 1;
+        }
+        if (text == "0-1") {
+            return -1;
+        }
+        if (text == "1/2-1/2") {
+            return 0;
+        }
+        return PGN_NO_RESULT;
+    }
+
+    // Read the next game, false when there are no more
+    bool next_game(PgnGame &game){
+        game = PgnGame();
+        bool in_moves = false;
+        bool found = false;
+        int c;
+        while ((c = peek()) != EOF) {
+            if (std::isspace(c)) {
+                get();
+            } else if (c == '[') {
+                if (in_moves) {
+                    return true; // Tags of the next game, the last one had no result at the end
+                }
+                get();
+                read_tag(game);
+                found = true;
+            } else if (c == '{') {
+                skip_until('}');
+            } else if (c == ';' || c == '%') {
+                skip_until('\n');
+            } else if (c == '(') {
+                get();
+                skip_variation();
+            } else if (c == '$' || c == ')') {
+                // NAGs, and closing brackets that don't belong to anything
+                get();
+                while (std::isdigit(peek())) {
+                    get();
+                }
+            } else {
+                std::string token;
+                while ((c = peek()) != EOF && !std::isspace(c) && c != '{' && c != '(' && c != ')' && c != ';' && c != '$') {
+                    token += (char)get();
+                }
+                in_moves = true;
+                found = true;
+                if (token == "*" || parse_result(token) != PGN_NO_RESULT) {
+                    game.result = parse_result(token);
+                    return true;
+                }
+                // Drop move numbers ("12." and "12...") and annotations ("!?", "+", "#")
+                size_t start = 0;
+                while (start < token.size() && (std::isdigit(token[start]) || token[start] == '.')) {
+                    start++;
+                }
+                size_t end = token.find_last_not_of("!?+#");
+                if (end != std::string::npos && end >= start) {
+                    game.moves.push_back(token.substr(start, end + 1 - start));
+                }
+            }
+        }
+        return found;
+    }
+};
+
+// Find the move a SAN string stands for among the legal moves of side. False if there is
+// no such move, it is ambiguous, or it promotes to something other than a queen
+bool san_to_move(Board &board, int side, const std::string &san, std::array<int, 4> &move) {
+    if (san.empty()) {
+        return false;
+    }
+    // Only the moves that fit the SAN are checked for legality
+    MoveList moves;
+    board.generate_moves(side, moves, GEN_ALL, false);
+
+    // Castling is written as the side it goes to, the board moves the king two squares
+    if (san[0] == 'O' || san[0] == '0') {
+        int home_row = side == 1 ? 7 : 0;
+        std::array<int, 4> castle;
+        if (san == "O-O" || san == "0-0") {
+            castle = {home_row, 4, home_row, 6};
+        } else if (san == "O-O-O" || san == "0-0-0") {
+            castle = {home_row, 4, home_row, 2};
+        } else {
+            return false;
+        }
+        for (const std::array<int, 4> &candidate : moves) {
+            if (candidate == castle && std::abs(board.piece_at(castle[0], castle[1])) == 5 && !board.move_leaves_check(castle[0], castle[1], castle[2], castle[3])) {
+                move = castle;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string text = san;
+    // Promotions, the board only knows how to make a queen
+    size_t equals = text.find('=');
+    if (equals != std::string::npos) {
+        if (equals + 1 >= text.size() || text[equals + 1] != 'Q') {
+            return false;
+        }
+        text.erase(equals);
+    } else if (text.size() > 2 && std::isupper(text.back())) {
+        if (text.back() != 'Q') {
+            return false;
+        }
+        text.pop_back(); // Written without the '=', like "e8Q"
+    }
+    if (text.size() < 2) {
+        return false;
+    }
+
+    int piece = 1;
+    size_t start = 0;
+    if (std::isupper(text[0])) {
+        auto it = piece_to_number.find(text[0]);
+        if (it == piece_to_number.end() || it->second == 1) {
+            return false;
+        }
+        piece = it->second;
+        start = 1;
+    }
+    // The destination is the last two characters, what is left in between disambiguates
+    int to_col = text[text.size() - 2] - 'a';
+    int to_row = 8 - (text[text.size() - 1] - '0');
+    if (to_col < 0 || to_col > 7 || to_row < 0 || to_row > 7) {
+        return false;
+    }
+    int from_col = -1;
+    int from_row = -1;
+    for (size_t i = start; i < text.size() - 2; i++) {
+        if (text[i] >= 'a' && text[i] <= 'h') {
+            from_col = text[i] - 'a';
+        } else if (text[i] >= '1' && text[i] <= '8') {
+            from_row = 8 - (text[i] - '0');
+        } else if (text[i] != 'x' && text[i] != '-') {
+            return false;
+        }
+    }
+
+    int found = 0;
+    for (const std::array<int, 4> &candidate : moves) {
+        if (candidate[2] != to_row || candidate[3] != to_col || std::abs(board.piece_at(candidate[0], candidate[1])) != piece) {
+            continue;
+        }
+        if ((from_col != -1 && candidate[1] != from_col) || (from_row != -1 && candidate[0] != from_row)) {
+            continue;
+        }
+        if (board.move_leaves_check(candidate[0], candidate[1], candidate[2], candidate[3])) {
+            continue; // Pinned pieces aren't counted when disambiguating
+        }
+        move = candidate;
+        found++;
+    }
+    return found == 1;
+}
+
+#endif
@@ -2,112 +2,770 @@
 #define SEARCH_ALGORITHMS_H
 
 #include <array>
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
 #include <cmath>
 #include <limits>
 #include <iostream>
 #include <chrono> // For time tracking
+#include <string>
+#include <vector>
 #include <board_representation.h> // Ensure this includes necessary board logic
+#include <transposition_table.h>
+#include <search_stats.h>
+#include <move_picker.h>
+#include <trace.h>
+
+// Most iterations a single search keeps statistics for
+const int MAX_ITERATIONS = 64;
+// Deepest ply the search stack has room for
+const int MAX_PLY = 64;
+// Static eval of a node that hasn't been evaluated
+const int NO_EVAL = std::numeric_limits<int>::min();
+// Score of a drawn position
+const int DRAW_SCORE = 0;
+// Bound of a full search window, both ends, so a window can be turned around for the other side
+const int INF_SCORE = std::numeric_limits<int>::max();
+// Score of mate at the root, a mate n plies away scores MATE_SCORE - n
+const int MATE_SCORE = 1000000;
+// Eval units are tenths of a pawn, scores are reported in centipawns
+const int CENTIPAWNS_PER_UNIT = 10;
+// Scores further from zero than this are mates
+const int MATE_BOUND = MATE_SCORE - MAX_PLY - 1;
+// Most root lines a MultiPV search can report
+const int MAX_MULTI_PV = 16;
+
+// Search depths are counted in fractions of a ply, so a move can be searched part of a ply
+// deeper. Iterations and the hash table still count whole plies
+const int ONE_PLY = 4;
+// How much deeper a move is searched, in fractions of a ply
+const int CHECK_EXTENSION = ONE_PLY;         // The move gives check
+const int RECAPTURE_EXTENSION = ONE_PLY / 2; // Takes back on the square the last move captured on
+const int SINGULAR_EXTENSION = ONE_PLY;      // The hash move is far better than every other move
+// Most a single move is extended by, whatever the reasons
+const int MAX_MOVE_EXTENSION = ONE_PLY;
+// Singular extensions are tried from this depth (plies), with a hash entry at most
+// SINGULAR_DEPTH_MARGIN plies shallower than the node
+const int SINGULAR_MIN_DEPTH = 4;
+const int SINGULAR_DEPTH_MARGIN = 3;
+// The hash move is singular if every other move scores this much worse per ply of depth
+const int SINGULAR_MARGIN_PER_PLY = 10;
+// Nodes with at most this many plies left can be pruned on their static eval
+const int FRONTIER_PLIES = 3;
+
+// Margins of the pruning near the leaves, in eval units, indexed by the plies left.
+// A margin of 0 turns that pruning off at that depth
+struct PruningMargins {
+    bool enabled = true;
+    // Quiet moves are skipped if the static eval plus this can't reach alpha
+    std::array<int, FRONTIER_PLIES + 1> futility = {0, 100, 200, 0};
+    // The node fails high without a search if the static eval minus this is still past beta
+    std::array<int, FRONTIER_PLIES + 1> reverse_futility = {0, 80, 160, 240};
+    // The node drops into the quiescence search if the static eval plus this can't reach alpha
+    std::array<int, FRONTIER_PLIES + 1> razor = {0, 150, 250, 0};
+};
 
 struct MiniMaxResult {
     int score;
     std::array<int, 4> move;
 };
 
-// Function to print progress every 5 seconds
-void printProgress(std::chrono::steady_clock::time_point start_time, int depth, const std::array<int, 4>& best_move, int best_score) {
-    static std::chrono::steady_clock::time_point last_print_time = start_time;
-    auto current_time = std::chrono::steady_clock::now();
-    std::chrono::duration<double> elapsed_seconds = current_time - last_print_time;
+// Pack a result into one word, so it can be shared between threads without a lock
+uint64_t pack_result(const MiniMaxResult &result) {
+    uint64_t packed = (uint64_t)(uint32_t)result.score << 32;
+    for (int i = 0; i < 4; i++) {
+        packed |= (uint64_t)(result.move[i] + 1) << (i * 4); // -1 (no move) becomes 0
+    }
+    return packed;
+}
+
+MiniMaxResult unpack_result(uint64_t packed) {
+    MiniMaxResult result;
+    result.score = (int)(uint32_t)(packed >> 32);
+    for (int i = 0; i < 4; i++) {
+        result.move[i] = (int)((packed >> (i * 4)) & 0xF) - 1;
+    }
+    return result;
+}
+
+// Nodes and time spent on one iteration of iterative deepening
+struct IterationStats {
+    StatCounter nodes;
+    StatCounter time_us;
+};
+
+// What the search keeps for one ply, preallocated so a node never allocates
+struct SearchStackEntry {
+    MoveList moves;                        // Moves of the node at this ply
+    std::array<int, 4> current_move;       // Move being searched, the board keeps its undo info
+    bool current_capture;                  // current_move took a piece
+    std::array<int, 4> excluded_move;      // Skipped while checking if the hash move is singular
+    int extensions;                        // Fractions of a ply the path to this node was extended by
+    int static_eval;                       // NO_EVAL until something evaluates the node
+    std::array<std::array<int, 4>, 2> killers; // Quiet moves that caused cutoffs at this ply
+    std::array<std::array<int, 4>, MAX_PLY> pv; // Best line from this ply on
+    int pv_length;
+};
+
+// One root line of a search, its score is exact
+struct PvLine {
+    int score;
+    std::array<std::array<int, 4>, MAX_PLY> moves;
+    int length;
+};
+
+// Everything a search needs that should survive between searches
+struct SearchState {
+    TranspositionTable hash_table;
+    std::atomic<bool> stop{false}; // Set from another thread to abort the search
+    std::atomic<int> max_depth{0}; // Can be changed while searching, e.g. on a ponder hit
+    std::atomic<int> current_depth{0}; // Iteration being searched
+    std::atomic<int> completed_depth{0}; // Deepest finished iteration
+    std::atomic<uint64_t> best_so_far{pack_result({0, {-1, -1, -1, -1}})}; // Best root move found yet, see pack_result
+    std::atomic<std::chrono::steady_clock::time_point> start_time; // Moved to the ponder hit when there is one
+    std::atomic<bool> searching{false};
+    std::atomic<int64_t> search_time_ms{0}; // Length of the last finished search
+    std::atomic<bool> print_progress{true}; // Print info lines while searching, switched on by a ponder hit
+    std::atomic<int> multi_pv{1}; // Number of best root lines to find, each gets its own search
+    int extension_budget = 0; // Fractions of a ply a path can be extended by in this iteration
+    PruningMargins pruning;
+    size_t memory_limit = 0; // Bytes the engine's structures may take together, 0 = no limit
+
+    // MultiPV. Every iteration searches the root once per line, leaving out the root moves
+    // of the lines already found, so the next search finds the next best line
+    MoveList excluded_root_moves;
+    std::array<PvLine, MAX_MULTI_PV> iteration_lines; // Lines of the iteration being searched
+    std::array<PvLine, MAX_MULTI_PV> lines; // Lines of the last finished iteration, best first
+    int line_count = 0;
+
+    // Statistics of the current (or last) search
+    SearchStats stats;
+    std::array<IterationStats, MAX_ITERATIONS + 1> iterations; // Indexed by depth
+    unsigned progress_ticks = 0;
+    std::chrono::steady_clock::time_point last_progress_time;
+
+    // Indexed by ply, one extra so the deepest node can look at its child
+    std::vector<SearchStackEntry> stack = std::vector<SearchStackEntry>(MAX_PLY + 1);
+};
+
+int64_t elapsed_ms(const SearchState &state) {
+    if (!state.searching) {
+        return state.search_time_ms;
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state.start_time.load()).count();
+}
+
+bool is_mate_score(int score) {
+    return score >= MATE_BOUND || score <= -MATE_BOUND;
+}
+
+// Mate scores count plies from the root, the hash table keeps them counted from
+// the stored node so they are right wherever the position is found again
+int score_to_tt(int score, int ply) {
+    if (score >= MATE_BOUND) {
+        return score + ply;
+    }
+    if (score <= -MATE_BOUND) {
+        return score - ply;
+    }
+    return score;
+}
+
+int score_from_tt(int score, int ply) {
+    if (score >= MATE_BOUND) {
+        return score - ply;
+    }
+    if (score <= -MATE_BOUND) {
+        return score + ply;
+    }
+    return score;
+}
+
+// "cp <centipawns>", or "mate <moves>" with a negative number when black mates
+std::string score_to_string(int score) {
+    if (is_mate_score(score)) {
+        int moves = (MATE_SCORE - std::abs(score) + 1) / 2;
+        return "mate " + std::to_string(score > 0 ? moves : -moves);
+    }
+    return "cp " + std::to_string(score * CENTIPAWNS_PER_UNIT);
+}
+
+std::string move_to_string(const std::array<int, 4> &move) {
+    return std::to_string(move[0]) + "," + std::to_string(move[1]) + "," + std::to_string(move[2]) + "," + std::to_string(move[3]);
+}
+
+std::string principal_variation(const PvLine &line) {
+    std::string pv = "";
+    for (int i = 0; i < line.length; i++) {
+        pv += (i > 0 ? " " : "") + move_to_string(line.moves[i]);
+    }
+    return pv;
+}
+
+// Take the line the last root search left on the search stack
+void copy_root_line(SearchState &state, int score, PvLine &line) {
+    const SearchStackEntry &root = state.stack[0];
+    line.score = score;
+    line.length = root.pv_length;
+    for (int i = 0; i < root.pv_length; i++) {
+        line.moves[i] = root.pv[i];
+    }
+}
+
+bool is_excluded_root_move(const SearchState &state, const std::array<int, 4> &move) {
+    for (int i = 0; i < state.excluded_root_moves.size; i++) {
+        if (state.excluded_root_moves.moves[i] == move) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (elapsed_seconds.count() >= 5.0) { // Every 5 seconds
-        last_print_time = current_time;
-        std::cout << "Elapsed time: " << std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count()
-                  << " seconds | Depth: " << depth << " | Best Move: " << best_move[0] << "," << best_move[1] << "," << best_move[2] << "," << best_move[3]
-                  << " | Best Score: " << best_score << std::endl;
+// UCI style info line for a finished iteration, line counts from 1 in a MultiPV search
+void print_iteration_info(SearchState &state, int depth, const MiniMaxResult &result, const std::string &pv, int line = 1) {
+    int64_t time_ms = elapsed_ms(state);
+    std::lock_guard<std::mutex> lock(output_mutex());
+    std::cout << "info depth " << depth;
+    if (state.multi_pv > 1) {
+        std::cout << " multipv " << line;
     }
+#ifndef NO_SEARCH_STATS
+    const SearchStats &stats = state.stats;
+    uint64_t nodes = stats.nodes.get();
+    uint64_t iteration_nodes = state.iterations[depth].nodes.get();
+    uint64_t previous_nodes = depth > 1 ? state.iterations[depth - 1].nodes.get() : 0;
+    std::cout << " seldepth " << stats.seldepth.get();
+#endif
+    std::cout << " score " << score_to_string(result.score) << " time " << time_ms
+              << " itertime " << state.iterations[depth].time_us.get() / 1000;
+#ifndef NO_SEARCH_STATS
+    std::cout << " nodes " << nodes << " qnodes " << stats.qnodes.get()
+              << " nps " << (uint64_t)(nodes * 1000 / (time_ms > 0 ? time_ms : 1))
+              << " tthits " << stat_ratio(stats.tt_hits.get(), stats.tt_probes.get())
+              << " ttcuts " << stat_ratio(stats.tt_cutoffs.get(), stats.tt_probes.get())
+              << " fmc " << stat_ratio(stats.first_move_cutoffs.get(), stats.cutoffs.get())
+              << " ebf " << stat_ratio(iteration_nodes, previous_nodes);
+#endif
+    std::cout << " pv " << pv << std::endl;
 }
 
-MiniMaxResult minimax(int depth, Board *board, int alpha, int beta, std::unordered_map<std::string, MiniMaxResult> &hash_table, bool maximizing_player, std::chrono::steady_clock::time_point start_time) {
-    int side = maximizing_player ? 1 : -1;
+// Every search statistic as a JSON object inside an info string, for the end
+// of a search and for the "stats" command
+void print_search_stats(SearchState &state) {
+    int64_t time_ms = elapsed_ms(state);
+    int depth = state.completed_depth;
+    std::lock_guard<std::mutex> lock(output_mutex());
+    std::cout << "info string stats {\"depth\":" << depth << ",\"time_ms\":" << time_ms;
+#ifndef NO_SEARCH_STATS
+    const SearchStats &stats = state.stats;
+    uint64_t nodes = stats.nodes.get();
+    uint64_t previous_nodes = depth > 1 ? state.iterations[depth - 1].nodes.get() : 0;
+    std::cout << ",\"seldepth\":" << stats.seldepth.get()
+              << ",\"nodes\":" << nodes
+              << ",\"qnodes\":" << stats.qnodes.get()
+              << ",\"nps\":" << (uint64_t)(nodes * 1000 / (time_ms > 0 ? time_ms : 1))
+              << ",\"tt_probes\":" << stats.tt_probes.get()
+              << ",\"tt_hit_rate\":" << stat_ratio(stats.tt_hits.get(), stats.tt_probes.get())
+              << ",\"tt_cutoff_rate\":" << stat_ratio(stats.tt_cutoffs.get(), stats.tt_probes.get())
+              << ",\"cutoffs\":" << stats.cutoffs.get()
+              << ",\"first_move_cutoff_rate\":" << stat_ratio(stats.first_move_cutoffs.get(), stats.cutoffs.get())
+              << ",\"extensions\":" << stats.extensions.get()
+              << ",\"singular_extensions\":" << stats.singular_extensions.get()
+              << ",\"futility_prunes\":" << stats.futility_prunes.get()
+              << ",\"reverse_futility_prunes\":" << stats.reverse_futility_prunes.get()
+              << ",\"razor_prunes\":" << stats.razor_prunes.get()
+              << ",\"ebf\":" << (depth > 0 ? stat_ratio(state.iterations[depth].nodes.get(), previous_nodes) : 0.0);
+#endif
+    std::cout << ",\"iterations\":[";
+    for (int d = 1; d <= depth && d <= MAX_ITERATIONS; d++) {
+        std::cout << (d > 1 ? "," : "") << "{\"depth\":" << d << ",\"time_ms\":" << state.iterations[d].time_us.get() / 1000.0;
+#ifndef NO_SEARCH_STATS
+        std::cout << ",\"nodes\":" << state.iterations[d].nodes.get();
+#endif
+        std::cout << "}";
+    }
+    std::cout << "]}" << std::endl;
+}
 
-    // Check if the board state has already been evaluated and stored in the hash table
-    std::string board_key = board->board_to_fen(side);
-    if (hash_table.find(board_key) != hash_table.end()) {
-        return hash_table[board_key];
+// Progress line every 5 seconds, checked every 1024 nodes so the clock isn't read all the time
+void print_progress(SearchState &state) {
+    if ((++state.progress_ticks & 1023) != 0) {
+        return;
     }
+    auto current_time = std::chrono::steady_clock::now();
+    if (current_time - state.last_progress_time < std::chrono::seconds(5)) {
+        return;
+    }
+    state.last_progress_time = current_time;
+    MiniMaxResult best = unpack_result(state.best_so_far);
+    int64_t time_ms = elapsed_ms(state);
+    std::lock_guard<std::mutex> lock(output_mutex());
+    std::cout << "info depth " << state.current_depth << " time " << time_ms;
+#ifndef NO_SEARCH_STATS
+    std::cout << " nodes " << state.stats.nodes.get() << " nps " << (uint64_t)(state.stats.nodes.get() * 1000 / (time_ms > 0 ? time_ms : 1));
+#endif
+    std::cout << " score " << score_to_string(best.score) << " pv " << move_to_string(best.move) << std::endl;
+}
 
-    // Terminal node or depth limit reached
-    if (depth == 0 || board->is_game_over()) {
-        int score = board->get_board_value();
-        return {score, {-1, -1, -1, -1}};
+// Search only captures, the side to move can always stand pat on the static eval.
+// Razoring uses it to make sure a position far below alpha has no capture that saves it.
+// Negamax like the main search, scores are from Us' side
+template<Color Us>
+MiniMaxResult quiescence(int ply, Board *board, int alpha, int beta, SearchState &state) {
+    TRACE_SCOPE("quiescence");
+    if (state.stop.load(std::memory_order_relaxed)) {
+        return {0, {-1, -1, -1, -1}};
     }
+    STAT_INC(state.stats.qnodes);
+    STAT_MAX(state.stats.seldepth, ply);
 
+    int best_score = Us * board->get_board_value();
     std::array<int, 4> best_move = {-1, -1, -1, -1};
-    int best_score = maximizing_player ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max();
+    if (board->is_game_over() || ply >= MAX_PLY) {
+        return {best_score, best_move};
+    }
+    if (best_score >= beta) {
+        return {best_score, best_move};
+    }
+    alpha = std::max(alpha, best_score);
+
+    MoveList &moves = state.stack[ply].moves;
+    moves.clear();
+    board->generate_moves<Us>(moves, GEN_CAPTURES, false);
+    for (int i = 0; i < moves.size; i++) {
+        // Most valuable victim first, an empty target square is an en passant pawn
+        for (int j = i + 1; j < moves.size; j++) {
+            if (CAPTURE_VALUES[std::abs(board->piece_at(moves[j][2], moves[j][3]))] >
+                CAPTURE_VALUES[std::abs(board->piece_at(moves[i][2], moves[i][3]))]) {
+                std::swap(moves[i], moves[j]);
+            }
+        }
+        std::array<int, 4> move = moves[i];
+        board->make_move<Us>(move[0], move[1], move[2], move[3]);
+        if (board->in_check<Us>()) {
+            board->unmake_move<Us>();
+            continue;
+        }
+        int score = -quiescence<~Us>(ply + 1, board, -beta, -alpha, state).score;
+        board->unmake_move<Us>();
+        if (state.stop.load(std::memory_order_relaxed)) {
+            return {0, {-1, -1, -1, -1}};
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+        }
+        alpha = std::max(alpha, best_score);
+        if (beta <= alpha) {
+            break;
+        }
+    }
+    return {best_score, best_move};
+}
 
-    // Generate all possible moves
-    std::vector<std::array<int, 4>> possible_moves = board->get_allmoves(side);
+// Turn a window from white's side into one from the side to move's, the full window
+// is -INF_SCORE..INF_SCORE so it can be turned around
+void window_for_side(bool maximizing_player, int &alpha, int &beta) {
+    alpha = std::max(alpha, -INF_SCORE);
+    if (!maximizing_player) {
+        std::swap(alpha, beta);
+        alpha = -alpha;
+        beta = -beta;
+    }
+}
+
+// The quiescence search with the score from white's side
+MiniMaxResult quiescence(int ply, Board *board, int alpha, int beta, bool maximizing_player, SearchState &state) {
+    window_for_side(maximizing_player, alpha, beta);
+    if (maximizing_player) {
+        return quiescence<WHITE>(ply, board, alpha, beta, state);
+    }
+    MiniMaxResult result = quiescence<BLACK>(ply, board, alpha, beta, state);
+    return {-result.score, result.move};
+}
+
+// The search node, in negamax form: the score is from Us' side and a child's score is
+// the negation of its own. The hash table keeps scores from the side to move's side too.
+// depth is in fractions of a ply, see ONE_PLY
+template<Color Us>
+MiniMaxResult negamax(int depth, int ply, Board *board, int alpha, int beta, SearchState &state) {
+    TRACE_SCOPE("minimax");
+    SearchStackEntry &ss = state.stack[ply];
+    bool excluding = ss.excluded_move[0] != -1;
+    ss.pv_length = 0;
+    ss.static_eval = NO_EVAL;
+
+    // Abort, the caller throws the result away
+    if (state.stop.load(std::memory_order_relaxed)) {
+        return {0, {-1, -1, -1, -1}};
+    }
+    STAT_INC(state.stats.nodes);
+    STAT_MAX(state.stats.seldepth, ply);
+
+    // A repeated position or fifty moves without progress is a draw. Checked before the
+    // hash table, so the score of a cycle doesn't come back from an unrelated path.
+    // The root always searches, it needs a move to play
+    if (ply > 0 && (board->is_repetition() || board->is_fifty_move_draw())) {
+        return {DRAW_SCORE, {-1, -1, -1, -1}};
+    }
+
+    // Check if the board state has already been evaluated and stored in the hash table.
+    // The root is always searched, so it has a best move and a line to report
+    uint64_t board_key = board->get_hash(Us);
+    HashEntry entry;
+    STAT_INC(state.stats.tt_probes);
+    bool found = state.hash_table.probe(board_key, entry);
+    if (found) {
+        STAT_INC(state.stats.tt_hits);
+    }
+    if (found) {
+        entry.score = score_from_tt(entry.score, ply);
+    }
+    if (found && ply > 0 && !excluding && entry.depth >= depth / ONE_PLY) {
+        if (entry.flag == HASH_EXACT ||
+            (entry.flag == HASH_LOWER && entry.score >= beta) ||
+            (entry.flag == HASH_UPPER && entry.score <= alpha)) {
+            STAT_INC(state.stats.tt_cutoffs);
+            return {entry.score, entry.move};
+        }
+    }
+
+    // Mate distance pruning, nothing found here can beat being mated right now
+    // or mating next move. If the window is outside that there's no need to search
+    if (ply > 0) {
+        int mated_score = -MATE_SCORE + ply;
+        int mating_score = MATE_SCORE - ply;
+        if (mated_score >= beta) {
+            return {mated_score, {-1, -1, -1, -1}};
+        }
+        if (mating_score <= alpha) {
+            return {mating_score, {-1, -1, -1, -1}};
+        }
+        alpha = std::max(alpha, mated_score);
+        beta = std::min(beta, mating_score);
+    }
+
+    // Terminal node or depth limit reached, counted as a quiescence node
+    if (depth < ONE_PLY || board->is_game_over() || ply >= MAX_PLY) {
+        STAT_INC(state.stats.qnodes);
+        ss.static_eval = Us * board->get_board_value();
+        return {ss.static_eval, {-1, -1, -1, -1}};
+    }
+
+    int alpha_orig = alpha;
+    int beta_orig = beta;
+    std::array<int, 4> best_move = {-1, -1, -1, -1};
+    int best_score = -INF_SCORE;
 
     // Print progress every 5 seconds
-    printProgress(start_time, depth, best_move, best_score);
+    if (state.print_progress) {
+        print_progress(state);
+    }
 
-    // No moves available means checkmate or stalemate
-    if (possible_moves.empty()) {
-        int score = board->get_board_value();
-        return {score, {-1, -1, -1, -1}};
+    // Pruning near the leaves on the static eval. Not at the root, in a singular search or
+    // in check, where the static eval means little. Mate bounds are left alone, and so is
+    // the side of the window that is still open (alpha is -infinity on a full window)
+    bool futile = false;
+    const PruningMargins &margins = state.pruning;
+    int plies = depth / ONE_PLY;
+    if (margins.enabled && ply > 0 && !excluding && plies <= FRONTIER_PLIES && !board->in_check<Us>()) {
+        ss.static_eval = Us * board->get_board_value();
+        int eval = ss.static_eval;
+        // The side to move must be so far past the window its opponent can't stop it
+        int reverse_margin = margins.reverse_futility[plies];
+        if (reverse_margin > 0 && !is_mate_score(beta) && eval - reverse_margin >= beta) {
+            STAT_INC(state.stats.reverse_futility_prunes);
+            return {eval, {-1, -1, -1, -1}};
+        }
+        // Far short of the window, only a capture can save it, which the quiescence search tries
+        int razor_margin = margins.razor[plies];
+        if (razor_margin > 0 && !is_mate_score(alpha) && eval + razor_margin <= alpha) {
+            MiniMaxResult result = quiescence<Us>(ply, board, alpha, alpha + 1, state);
+            if (result.score <= alpha) {
+                STAT_INC(state.stats.razor_prunes);
+                return {result.score, {-1, -1, -1, -1}};
+            }
+        }
+        // Quiet moves can't make up the difference, only captures, promotions and checks are searched
+        int futility_margin = margins.futility[plies];
+        futile = futility_margin > 0 && !is_mate_score(alpha) && eval + futility_margin <= alpha;
+    }
+
+    // Singular extension. If every other move is far worse than the hash move, the position
+    // hinges on it and it is searched deeper. The other moves get a reduced search with a
+    // null window just below the hash score, run before this node's own move list is made
+    // since it uses the same stack entry
+    bool singular = false;
+    if (ply > 0 && found && !excluding && depth >= SINGULAR_MIN_DEPTH * ONE_PLY &&
+        entry.depth >= depth / ONE_PLY - SINGULAR_DEPTH_MARGIN && !is_mate_score(entry.score) &&
+        (entry.flag == HASH_EXACT || entry.flag == HASH_LOWER) &&
+        ss.extensions + SINGULAR_EXTENSION <= state.extension_budget &&
+        board->is_pseudo_legal(Us, entry.move) &&
+        !board->move_leaves_check<Us>(entry.move[0], entry.move[1], entry.move[2], entry.move[3])) {
+        int bound = entry.score - SINGULAR_MARGIN_PER_PLY * depth / ONE_PLY;
+        ss.excluded_move = entry.move;
+        MiniMaxResult others = negamax<Us>(depth / 2, ply, board, bound - 1, bound, state);
+        ss.excluded_move = {-1, -1, -1, -1};
+        if (state.stop.load(std::memory_order_relaxed)) {
+            return {0, {-1, -1, -1, -1}};
+        }
+        singular = others.score < bound;
+        if (singular) {
+            STAT_INC(state.stats.singular_extensions);
+        }
     }
 
-    for (const auto& move : possible_moves) {
+    // Moves come from the picker one at a time, the hash move and killers first.
+    // They are only pseudo legal, so the ones leaving our king in check are skipped
+    MovePicker picker(board, Us, ss.moves, found ? entry.move : std::array<int, 4>{-1, -1, -1, -1}, ss.killers);
+    std::array<int, 4> move;
+    int legal_moves = 0;
+    while (picker.next(move)) {
+        if ((ply == 0 && is_excluded_root_move(state, move)) || (excluding && move == ss.excluded_move)) {
+            continue;
+        }
+        bool quiet = board->piece_at(move[2], move[3]) == 0;
+        // Promotions and en passant captures change the material too
+        bool pawn_move = board->piece_at(move[0], move[1]) == Us;
+        bool tactical = !quiet || (pawn_move && (move[1] != move[3] || move[2] == 0 || move[2] == 7));
+        ss.current_move = move;
+        ss.current_capture = !quiet;
         // Move the piece
-        board->move_piece(move[0], move[1], move[2], move[3]);
+        board->make_move<Us>(move[0], move[1], move[2], move[3]);
+        if (board->in_check<Us>()) {
+            board->unmake_move<Us>();
+            continue;
+        }
+        legal_moves++;
 
-        // Recursively call MiniMax
-        MiniMaxResult result = minimax(depth - 1, board, alpha, beta, hash_table, !maximizing_player, start_time);
+        bool gives_check = board->in_check<~Us>();
+        if (futile && legal_moves > 1 && !tactical && !gives_check) {
+            board->unmake_move<Us>();
+            STAT_INC(state.stats.futility_prunes);
+            continue;
+        }
+
+        // Forcing moves are searched deeper, as long as the path has budget left
+        int extension = 0;
+        if (gives_check) {
+            extension += CHECK_EXTENSION;
+        }
+        if (!quiet && ply > 0 && state.stack[ply - 1].current_capture &&
+            move[2] == state.stack[ply - 1].current_move[2] && move[3] == state.stack[ply - 1].current_move[3]) {
+            extension += RECAPTURE_EXTENSION;
+        }
+        if (singular && move == entry.move) {
+            extension += SINGULAR_EXTENSION;
+        }
+        extension = std::max(0, std::min({extension, MAX_MOVE_EXTENSION, state.extension_budget - ss.extensions}));
+        if (extension > 0) {
+            STAT_INC(state.stats.extensions);
+        }
+        state.stack[ply + 1].extensions = ss.extensions + extension;
+
+        // Recursively search the reply, its score is from the other side
+        int score = -negamax<~Us>(depth - ONE_PLY + extension, ply + 1, board, -beta, -alpha, state).score;
 
         // Undo the move
-        board->undo_move();
+        board->unmake_move<Us>();
+
+        if (state.stop.load(std::memory_order_relaxed)) {
+            return {0, {-1, -1, -1, -1}};
+        }
+
+        // Update best score and move if the current score is better
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
 
-        if (maximizing_player) {
-            // Update best score and move if the current score is better
-            if (result.score > best_score) {
-                best_score = result.score;
-                best_move = move;
+            // This move followed by the child's best line
+            const SearchStackEntry &child = state.stack[ply + 1];
+            ss.pv[0] = move;
+            for (int j = 0; j < child.pv_length; j++) {
+                ss.pv[j + 1] = child.pv[j];
             }
-            alpha = std::max(alpha, best_score);
-        } else {
-            // Update best score and move if the current score is better
-            if (result.score < best_score) {
-                best_score = result.score;
-                best_move = move;
+            ss.pv_length = child.pv_length + 1;
+
+            if (ply == 0 && state.excluded_root_moves.empty()) {
+                state.best_so_far = pack_result({Us * best_score, best_move});
             }
-            beta = std::min(beta, best_score);
         }
+        alpha = std::max(alpha, best_score);
 
         // Alpha-beta pruning
         if (beta <= alpha) {
+            STAT_INC(state.stats.cutoffs);
+            if (legal_moves == 1) {
+                STAT_INC(state.stats.first_move_cutoffs);
+            }
+            // Remember quiet moves that cut off, they are tried early in sibling nodes
+            if (quiet && ss.killers[0] != move) {
+                ss.killers[1] = ss.killers[0];
+                ss.killers[0] = move;
+            }
             break;
         }
+    }
+
+    // Every move but the excluded one failed low, or there were no others
+    if (excluding && legal_moves == 0) {
+        return {alpha, {-1, -1, -1, -1}};
+    }
+
+    // No legal moves is checkmate if we're in check, stalemate if not
+    if (legal_moves == 0) {
+        if (!board->in_check<Us>()) {
+            return {DRAW_SCORE, {-1, -1, -1, -1}};
+        }
+        return {-MATE_SCORE + ply, {-1, -1, -1, -1}};
+    }
 
-        
+    // A node searched without some of its moves has no score worth keeping
+    if (excluding || (ply == 0 && !state.excluded_root_moves.empty())) {
+        return {best_score, best_move};
     }
 
     // Store the board state and its score in the hash table
-    hash_table[board_key] = {best_score, best_move};
+    HashFlag flag = HASH_EXACT;
+    if (best_score <= alpha_orig) {
+        flag = HASH_UPPER;
+    } else if (best_score >= beta_orig) {
+        flag = HASH_LOWER;
+    }
+    state.hash_table.store(board_key, score_to_tt(best_score, ply), best_move, depth / ONE_PLY, flag);
     return {best_score, best_move};
 }
 
-MiniMaxResult start_minimax(int depth, Board *board, bool maximizing_player) {
-    std::unordered_map<std::string, MiniMaxResult> hash_table;
-    auto start_time = std::chrono::steady_clock::now();
+// The search with the score from white's side, white maximizing. The side to move is
+// only looked at here, below this everything is compiled for one side
+MiniMaxResult minimax(int depth, int ply, Board *board, int alpha, int beta, bool maximizing_player, SearchState &state) {
+    window_for_side(maximizing_player, alpha, beta);
+    if (maximizing_player) {
+        return negamax<WHITE>(depth, ply, board, alpha, beta, state);
+    }
+    MiniMaxResult result = negamax<BLACK>(depth, ply, board, alpha, beta, state);
+    return {-result.score, result.move};
+}
+
+// Search one depth at a time, so a stopped search still has a move to play.
+// The depth is read from state.max_depth every iteration so another thread can change it
+MiniMaxResult iterative_minimax(Board *board, bool maximizing_player, SearchState &state) {
+    TRACE_SCOPE("search");
+    state.start_time = std::chrono::steady_clock::now();
+    state.searching = true;
+    state.last_progress_time = state.start_time;
+    state.completed_depth = 0;
+    state.best_so_far = pack_result({0, {-1, -1, -1, -1}});
+    state.stats.reset();
+    state.hash_table.new_search();
+    for (SearchStackEntry &entry : state.stack) {
+        entry.killers = {{{-1, -1, -1, -1}, {-1, -1, -1, -1}}};
+        entry.pv_length = 0;
+        entry.excluded_move = {-1, -1, -1, -1};
+        entry.current_capture = false;
+        entry.extensions = 0;
+    }
 
+    state.line_count = 0;
+    state.excluded_root_moves.clear();
+    int lines_wanted = std::max(1, std::min((int)state.multi_pv, MAX_MULTI_PV));
+
+    for (int d = 1; d <= state.max_depth && d <= MAX_ITERATIONS; d++) {
+        state.current_depth = d;
+        state.extension_budget = d * ONE_PLY; // A line can be searched to at most twice the depth
+        uint64_t nodes_before = state.stats.nodes.get();
+        auto iteration_start = std::chrono::steady_clock::now();
+
+        // One full window search per line, so every line gets an exact score. The later
+        // searches are cheap, the hash table still has most of the tree from the first
+        MiniMaxResult result = {0, {-1, -1, -1, -1}};
+        int found_lines = 0;
+        for (int line = 0; line < lines_wanted; line++) {
+            MiniMaxResult line_result = minimax(d * ONE_PLY, 0, board, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), maximizing_player, state);
+            if (state.stop.load() || (line > 0 && line_result.move[0] == -1)) {
+                break; // Stopped, or there are fewer legal moves than lines
+            }
+            if (line == 0) {
+                result = line_result;
+            }
+            copy_root_line(state, line_result.score, state.iteration_lines[line]);
+            state.excluded_root_moves.push_back(line_result.move);
+            found_lines++;
+        }
+        state.excluded_root_moves.clear();
+        if (state.stop.load()) {
+            break;
+        }
+        state.iterations[d].nodes.reset();
+        state.iterations[d].nodes.add(state.stats.nodes.get() - nodes_before);
+        state.iterations[d].time_us.reset();
+        state.iterations[d].time_us.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - iteration_start).count());
+        state.best_so_far = pack_result(result);
+        state.completed_depth = d;
+        for (int line = 0; line < found_lines; line++) {
+            state.lines[line] = state.iteration_lines[line];
+        }
+        state.line_count = found_lines;
+
+        if (state.print_progress) {
+            for (int line = 0; line < found_lines; line++) {
+                const PvLine &pv = state.lines[line];
+                print_iteration_info(state, d, {pv.score, pv.moves[0]}, principal_variation(pv), line + 1);
+            }
+        }
+    }
+    // Stopped before the first iteration was done, search that anyway so there is a move to play
+    if (state.completed_depth == 0 && state.stop.load()) {
+        state.stop = false;
+        state.extension_budget = ONE_PLY;
+        MiniMaxResult result = minimax(ONE_PLY, 0, board, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), maximizing_player, state);
+        state.stop = true;
+        state.best_so_far = pack_result(result);
+        state.completed_depth = 1;
+        copy_root_line(state, result.score, state.lines[0]);
+        state.line_count = 1;
+    }
+    state.search_time_ms = elapsed_ms(state);
+    state.searching = false;
+    if (state.print_progress) {
+        print_search_stats(state);
+    }
+    return unpack_result(state.best_so_far);
+}
+
+// The move the opponent is expected to answer with, taken from the hash table
+bool expected_reply(Board *board, const std::array<int, 4> &move, bool maximizing_player, SearchState &state, std::array<int, 4> &reply) {
+    if (move[0] == -1) {
+        return false;
+    }
+    board->move_piece(move[0], move[1], move[2], move[3]);
+    HashEntry entry;
+    bool found = state.hash_table.probe(board->get_hash(maximizing_player ? -1 : 1), entry) && entry.move[0] != -1;
+    board->undo_move();
+    if (found) {
+        reply = entry.move;
+    }
+    return found;
+}
+
+MiniMaxResult start_minimax(int depth, Board *board, bool maximizing_player, SearchState &state) {
     // Start MiniMax
-    MiniMaxResult result = minimax(depth, board, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), hash_table, maximizing_player, start_time);
+    state.max_depth = depth;
+    MiniMaxResult result = iterative_minimax(board, maximizing_player, state);
 
     // Print final best move and score
-    std::cout << "Best move: " << result.move[0] << "," << result.move[1] << "," << result.move[2] << "," << result.move[3] << std::endl;
+    if (state.print_progress) {
+        std::lock_guard<std::mutex> lock(output_mutex());
+        std::cout << "Best move: " << move_to_string(result.move) << std::endl;
+    }
 
     return result;
 }
 
+MiniMaxResult start_minimax(int depth, Board *board, bool maximizing_player) {
+    SearchState state;
+    return start_minimax(depth, board, maximizing_player, state);
+}
+
 #endif
@@ -0,0 +1,86 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Counters for tuning the search. Compile with -DNO_SEARCH_STATS and
+// every STAT_ macro disappears, so the search pays nothing for them
+#ifdef NO_SEARCH_STATS
+#define STAT_INC(counter)
+#define STAT_MAX(counter, value)
+#else
+#define STAT_INC(counter) ((counter).add(1))
+#define STAT_MAX(counter, value) ((counter).raise(value))
+#endif
+
+// Everything written to stdout goes through this, so lines from the search
+// thread and the command thread don't mix
+std::mutex &output_mutex() {
+    static std::mutex output;
+    return output;
+}
+
+// A counter only the search thread writes to, but any thread may read.
+// Relaxed load + store instead of fetch_add, so it compiles to a plain add
+class StatCounter
+{
+private:
+    std::atomic<uint64_t> value{0};
+
+public:
+    void add(uint64_t n){
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void raise(uint64_t n){
+        if (n > value.load(std::memory_order_relaxed)) {
+            value.store(n, std::memory_order_relaxed);
+        }
+    }
+    void reset(){
+        value.store(0, std::memory_order_relaxed);
+    }
+    uint64_t get() const{
+        return value.load(std::memory_order_relaxed);
+    }
+};
+
+struct SearchStats {
+    StatCounter nodes;              // minimax calls
+    StatCounter qnodes;             // quiescence calls
+    StatCounter tt_probes;          // hash table lookups
+    StatCounter tt_hits;            // lookups that found the position
+    StatCounter tt_cutoffs;         // lookups whose score could be returned directly
+    StatCounter cutoffs;            // beta cutoffs
+    StatCounter first_move_cutoffs; // beta cutoffs on the first move searched
+    StatCounter seldepth;           // deepest ply reached
+    StatCounter extensions;         // moves searched deeper than one ply less
+    StatCounter singular_extensions; // hash moves found to be singular
+    StatCounter futility_prunes;    // quiet moves skipped near the leaves
+    StatCounter reverse_futility_prunes; // nodes failing high on the static eval
+    StatCounter razor_prunes;       // nodes cut short by the quiescence search
+
+    void reset(){
+        nodes.reset();
+        qnodes.reset();
+        tt_probes.reset();
+        tt_hits.reset();
+        tt_cutoffs.reset();
+        cutoffs.reset();
+        first_move_cutoffs.reset();
+        seldepth.reset();
+        extensions.reset();
+        singular_extensions.reset();
+        futility_prunes.reset();
+        reverse_futility_prunes.reset();
+        razor_prunes.reset();
+    }
+};
+
+// Share of a counter as a fraction, 0 if nothing was counted
+double stat_ratio(uint64_t part, uint64_t total) {
+    return total == 0 ? 0.0 : (double)part / (double)total;
+}
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef SEARCH_THREAD_H
+#define SEARCH_THREAD_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <board_representation.h>
+#include <search_algorithm.h>
+#include <mcts.h>
+#include <memory_audit.h>
+#include <trace.h>
+
+// Deepest iteration a ponder search will go to if nobody stops it
+const int MAX_PONDER_DEPTH = 64;
+// Boards kept for a search, the job handed to the worker and the worker's copy of it
+const int SEARCH_BOARDS = 2;
+
+// What runs the searches
+enum SearchEngine {
+    ENGINE_MINIMAX,
+    ENGINE_MCTS
+};
+
+const char *const SEARCH_ENGINE_NAMES[2] = {"minimax", "mcts"};
+
+// Runs every search on its own worker thread, so the thread reading commands
+// can still stop the search or answer pings while it is running.
+// With pondering on, the worker keeps searching the position we expect to get
+// after our move and the opponent's predicted reply, while the opponent thinks.
+class SearchThread
+{
+public:
+    // Called on the worker thread with every finished (or stopped) search
+    typedef std::function<void(Board &, const MiniMaxResult &)> ReportFunction;
+
+private:
+    SearchState &state;
+    ReportFunction report;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable job_cv;
+    std::condition_variable idle_cv;
+
+    // Job handed from the command thread to the worker (guarded by mutex)
+    std::unique_ptr<Board> job_board;
+    int job_depth = 0;
+    bool job_maximizing = true;
+    bool quit = false;
+    bool busy = false;
+
+    bool ponder = false;
+    bool pondering = false;
+    std::string ponder_key; // Position being pondered, as given by board_to_fen
+    uint64_t ponder_hash = 0; // Its hash, the move counters of a FEN don't matter for a hit
+
+    // Only changed while the worker is idle
+    SearchEngine engine = ENGINE_MINIMAX;
+    MctsSearch mcts;
+
+    // Search, report and possibly ponder on the next position
+    void run_search(Board board, int depth, bool maximizing_player){
+        // Pondering needs the opponent's expected reply from the hash table, so MCTS doesn't ponder
+        if (engine == ENGINE_MCTS) {
+            MiniMaxResult result = mcts.search(board, depth, maximizing_player, state);
+            MemoryPhaseScope phase(MEMORY_REPORT);
+            report(board, result);
+            return;
+        }
+        state.max_depth = depth;
+        MiniMaxResult result = iterative_minimax(&board, maximizing_player, state);
+        {
+            MemoryPhaseScope phase(MEMORY_REPORT);
+            report(board, result);
+        }
+
+        while (true) {
+            std::array<int, 4> reply;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ponder || quit || !expected_reply(&board, result.move, maximizing_player, state, reply)) {
+                    return;
+                }
+                board.move_piece(result.move[0], result.move[1], result.move[2], result.move[3]);
+                board.move_piece(reply[0], reply[1], reply[2], reply[3]);
+                ponder_key = board.board_to_fen(maximizing_player ? 1 : -1);
+                ponder_hash = board.get_hash(maximizing_player ? 1 : -1);
+                pondering = true;
+                state.stop = false;
+                state.max_depth = MAX_PONDER_DEPTH;
+                state.print_progress = false;
+            }
+            report_ponder_move(reply);
+
+            result = iterative_minimax(&board, maximizing_player, state);
+
+            bool hit;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // A ponder hit turns the ponder search into the real one
+                hit = !pondering;
+                pondering = false;
+                state.print_progress = true;
+            }
+            if (!hit) {
+                return;
+            }
+            MemoryPhaseScope phase(MEMORY_REPORT);
+            report(board, result);
+        }
+    }
+
+    void report_ponder_move(const std::array<int, 4> &reply){
+        std::lock_guard<std::mutex> lock(output_mutex());
+        std::cout << "Ponder move: " << reply[0] << "," << reply[1] << "," << reply[2] << "," << reply[3] << std::endl;
+    }
+
+    void worker_loop(){
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            job_cv.wait(lock, [this]() { return quit || job_board; });
+            if (quit) {
+                break;
+            }
+            std::unique_ptr<Board> board = std::move(job_board);
+            lock.unlock();
+
+            {
+                MemoryPhaseScope phase(MEMORY_SEARCH);
+                run_search(*board, job_depth, job_maximizing);
+            }
+
+            lock.lock();
+            busy = false;
+            idle_cv.notify_all();
+        }
+    }
+
+public:
+    SearchThread(SearchState &search_state, ReportFunction report_function) : state(search_state), report(report_function){
+        worker = std::thread(&SearchThread::worker_loop, this);
+    }
+
+    // Start searching a position, or carry on with the ponder search if it's the pondered one.
+    // Returns true on a ponder hit
+    bool go(const Board &board, int depth, bool maximizing_player){
+        std::unique_lock<std::mutex> lock(mutex);
+        if (pondering) {
+            Board copy = board;
+            if (copy.get_hash(maximizing_player ? 1 : -1) == ponder_hash) {
+                {
+                    std::lock_guard<std::mutex> out(output_mutex());
+                    std::cout << "Ponder hit" << std::endl;
+                }
+                pondering = false;
+                // From here on it is the real search: it reports, and its time counts from now
+                state.print_progress = true;
+                state.start_time = std::chrono::steady_clock::now();
+                state.max_depth = depth;
+                if (state.completed_depth >= depth) {
+                    state.stop = true; // Already deep enough, finish the current iteration early
+                }
+                return true;
+            }
+            {
+                std::lock_guard<std::mutex> out(output_mutex());
+                std::cout << "Ponder miss" << std::endl;
+            }
+        }
+        // Only one search at a time, stop whatever is running
+        state.stop = true;
+        idle_cv.wait(lock, [this]() { return !busy; });
+
+        state.stop = false;
+        job_board.reset(new Board(board));
+        job_depth = depth;
+        job_maximizing = maximizing_player;
+        busy = true;
+        job_cv.notify_one();
+        return false;
+    }
+
+    // Stop the search, it reports the best move found so far. A ponder search just ends
+    void stop(){
+        std::lock_guard<std::mutex> lock(mutex);
+        state.stop = true;
+    }
+
+    // Block until the worker has nothing left to do
+    void wait(){
+        std::unique_lock<std::mutex> lock(mutex);
+        idle_cv.wait(lock, [this]() { return !busy; });
+    }
+
+    void set_ponder(bool on){
+        std::lock_guard<std::mutex> lock(mutex);
+        ponder = on;
+        if (!on && pondering) {
+            state.stop = true;
+        }
+    }
+
+    bool is_pondering(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return pondering;
+    }
+
+    // FEN of the position being pondered on
+    std::string ponder_fen(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return ponder_key;
+    }
+
+    // Best root move found so far by the running search
+    MiniMaxResult best_so_far(){
+        return unpack_result(state.best_so_far);
+    }
+
+    // Bytes the thread keeps for its searches, the MCTS tree included
+    size_t memory_usage() const{
+        return sizeof(SearchThread) + SEARCH_BOARDS * sizeof(Board) + mcts.memory_usage();
+    }
+
+    // Only call these while nothing is searching
+    void set_engine(SearchEngine new_engine){
+        engine = new_engine;
+    }
+
+    SearchEngine get_engine() const{
+        return engine;
+    }
+
+    MctsSearch &mcts_search(){
+        return mcts;
+    }
+
+    const MctsSearch &mcts_search() const{
+        return mcts;
+    }
+
+    ~SearchThread(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+            state.stop = true;
+            job_cv.notify_one();
+        }
+        worker.join();
+    }
+};
+
+// Bytes of everything the engine keeps besides the hash table
+size_t fixed_memory_usage(const SearchState &state, const SearchThread &thread) {
+    return sizeof(SearchState) + state.stack.capacity() * sizeof(SearchStackEntry) + thread.memory_usage() + trace_memory_usage();
+}
+
+// Most hash table entries the memory limit leaves room for, SIZE_MAX without a limit
+size_t hash_entries_allowed(const SearchState &state, const SearchThread &thread) {
+    if (state.memory_limit == 0) {
+        return SIZE_MAX;
+    }
+    size_t fixed = fixed_memory_usage(state, thread);
+    return state.memory_limit > fixed ? TranspositionTable::entries_within(state.memory_limit - fixed) : 0;
+}
+
+// Cap the memory of the engine's structures, 0 takes the cap away. The hash table is the only
+// one that can change size, it shrinks if it doesn't fit. If the limit leaves no room for
+// a hash table nothing changes and false is returned. Only call it while nothing is searching
+bool set_memory_limit(SearchState &state, const SearchThread &thread, size_t bytes) {
+    size_t previous = state.memory_limit;
+    state.memory_limit = bytes;
+    size_t allowed = hash_entries_allowed(state, thread);
+    if (allowed == 0) {
+        state.memory_limit = previous;
+        return false;
+    }
+    if (state.hash_table.capacity() > allowed) {
+        state.hash_table.resize(allowed);
+    }
+    return true;
+}
+
+// Pick the engine the searches run with. The MCTS tree is only allocated while MCTS is picked,
+// as big as the memory limit leaves room for. False if there is no room for a tree.
+// Only call it while nothing is searching
+bool set_search_engine(SearchState &state, SearchThread &thread, SearchEngine engine) {
+    MctsSearch &mcts = thread.mcts_search();
+    if (engine == ENGINE_MINIMAX) {
+        mcts.resize(0);
+    } else if (mcts.capacity() == 0) {
+        size_t nodes = DEFAULT_MCTS_NODES;
+        if (state.memory_limit != 0) {
+            size_t used = state.hash_table.memory_usage() + fixed_memory_usage(state, thread);
+            nodes = std::min(nodes, MctsSearch::nodes_within(state.memory_limit > used ? state.memory_limit - used : 0));
+        }
+        if (nodes < (size_t)MAX_MOVES) {
+            return false;
+        }
+        mcts.resize(nodes);
+    }
+    thread.set_engine(engine);
+    return true;
+}
+
+// What every structure of the engine takes, and with -DMEMORY_AUDIT the heap allocations
+// of every phase, as a JSON object inside an info string
+void print_memory_report(SearchState &state, const SearchThread &thread) {
+    size_t stack = state.stack.capacity() * sizeof(SearchStackEntry);
+    size_t tree = thread.mcts_search().memory_usage();
+    size_t total = state.hash_table.memory_usage() + fixed_memory_usage(state, thread);
+    std::lock_guard<std::mutex> lock(output_mutex());
+    std::cout << "info string memory {\"limit\":" << state.memory_limit << ",\"total\":" << total
+              << ",\"resident\":" << process_resident_bytes()
+              << ",\"structures\":{\"hash_table\":" << state.hash_table.memory_usage()
+              << ",\"search_state\":" << sizeof(SearchState) << ",\"search_stack\":" << stack
+              << ",\"search_thread\":" << thread.memory_usage() - tree << ",\"mcts_tree\":" << tree
+              << ",\"trace\":" << trace_memory_usage() << "}";
+    if (memory_audit_enabled()) {
+        std::cout << ",";
+        print_memory_audit(std::cout);
+    }
+    std::cout << "}" << std::endl;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SPRT_H
+#define SPRT_H
+
+#include <algorithm>
+#include <cmath>
+
+// Results of a match, seen from the engine being tested
+struct MatchScore {
+    int wins = 0;
+    int losses = 0;
+    int draws = 0;
+
+    int games() const{
+        return wins + losses + draws;
+    }
+    // Points per game, between 0 and 1
+    double score() const{
+        return games() == 0 ? 0.5 : (wins + 0.5 * draws) / games();
+    }
+    // Variance of the points of a single game
+    double variance() const{
+        if (games() == 0) {
+            return 0.0;
+        }
+        double mean = score();
+        double n = games();
+        return (wins * std::pow(1.0 - mean, 2) + losses * std::pow(mean, 2) + draws * std::pow(0.5 - mean, 2)) / n;
+    }
+};
+
+// Expected points per game for an Elo difference
+double expected_score(double elo) {
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+// Elo difference that gives the points per game, clamped so 0 and 1 stay finite
+double elo_from_score(double score) {
+    score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+struct EloEstimate {
+    double elo;
+    double error; // Half the width of the 95% confidence interval
+};
+
+EloEstimate estimate_elo(const MatchScore &match) {
+    double score = match.score();
+    double margin = match.games() == 0 ? 0.0 : 1.959964 * std::sqrt(match.variance() / match.games());
+    double low = elo_from_score(score - margin);
+    double high = elo_from_score(score + margin);
+    return {elo_from_score(score), (high - low) / 2.0};
+}
+
+enum SprtResult {
+    SPRT_CONTINUE,
+    SPRT_ACCEPT_H0, // The change is not better than elo0
+    SPRT_ACCEPT_H1  // The change is at least elo1 better
+};
+
+// Log likelihood ratio of H1 (Elo difference is elo1) against H0 (it is elo0),
+// using the normal approximation of the game results
+double sprt_llr(const MatchScore &match, double elo0, double elo1) {
+    double variance = match.variance();
+    if (match.games() == 0 || variance <= 0.0) {
+        return 0.0;
+    }
+    double score = match.score();
+    double score0 = expected_score(elo0);
+    double score1 = expected_score(elo1);
+    return match.games() * (std::pow(score - score0, 2) - std::pow(score - score1, 2)) / (2.0 * variance);
+}
+
+// Lower and upper stopping bounds for the given error rates
+double sprt_lower_bound(double alpha, double beta) {
+    return std::log(beta / (1.0 - alpha));
+}
+
+double sprt_upper_bound(double alpha, double beta) {
+    return std::log((1.0 - beta) / alpha);
+}
+
+SprtResult sprt_test(double llr, double alpha, double beta) {
+    if (llr >= sprt_upper_bound(alpha, beta)) {
+        return SPRT_ACCEPT_H1;
+    }
+    if (llr <= sprt_lower_bound(alpha, beta)) {
+        return SPRT_ACCEPT_H0;
+    }
+    return SPRT_CONTINUE;
+}
+
+#endif
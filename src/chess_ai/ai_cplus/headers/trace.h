@@ -0,0 +1,308 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Scoped timers for the hot functions of the engine. Build with -DSEARCH_TRACE and every
+// TRACE_SCOPE times its scope with the CPU's time stamp counter. Without the flag the
+// macro is empty, so a normal build pays nothing for it.
+//
+// Every thread keeps its own call tree of scopes, with the time and number of calls of each
+// path, so nothing is shared while searching. The first TRACE_EVENT_CAPACITY scopes of a
+// thread are also kept as single events. After a search the trace is written as
+//   - collapsed stacks ("search;minimax;move_piece 1234" per line, in nanoseconds of self
+//     time), for flamegraph.pl or speedscope.app
+//   - Chrome trace JSON, for chrome://tracing or ui.perfetto.dev
+// Only write or reset the trace while nothing is being traced
+
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+#ifdef SEARCH_TRACE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Single scopes kept per thread for the Chrome trace, later ones only go into the call tree
+const size_t TRACE_EVENT_CAPACITY = 1 << 18;
+
+// Time stamp counter, the steady clock on CPUs without one
+inline uint64_t trace_ticks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// A path of scopes in a thread's call tree
+struct TraceNode {
+    uint16_t name;
+    int32_t parent;
+    int32_t first_child = -1;
+    int32_t next_sibling = -1;
+    uint64_t ticks = 0;
+    uint64_t calls = 0;
+};
+
+struct TraceEvent {
+    uint16_t name;
+    uint64_t start;
+    uint64_t ticks;
+};
+
+struct TraceThread {
+    int id;
+    std::vector<TraceNode> nodes; // nodes[0] is the thread itself
+    int32_t current = 0;
+    std::vector<TraceEvent> events;
+    uint64_t dropped_events = 0;
+
+    TraceThread(int thread_id) : id(thread_id){
+        nodes.reserve(4096);
+        nodes.push_back({0, -1});
+        events.reserve(TRACE_EVENT_CAPACITY);
+    }
+
+    // The child of the current node for this scope, made the first time the path is taken
+    int32_t enter(uint16_t name){
+        int32_t child = nodes[current].first_child;
+        while (child != -1 && nodes[child].name != name) {
+            child = nodes[child].next_sibling;
+        }
+        if (child == -1) {
+            TraceNode node;
+            node.name = name;
+            node.parent = current;
+            node.next_sibling = nodes[current].first_child;
+            child = (int32_t)nodes.size();
+            nodes.push_back(node);
+            nodes[current].first_child = child;
+        }
+        current = child;
+        return child;
+    }
+
+    void leave(int32_t node, uint64_t start, uint64_t ticks){
+        nodes[node].ticks += ticks;
+        nodes[node].calls++;
+        current = nodes[node].parent;
+        if (events.size() < TRACE_EVENT_CAPACITY) {
+            events.push_back({nodes[node].name, start, ticks});
+        } else {
+            dropped_events++;
+        }
+    }
+};
+
+// Everything shared between threads, only touched when a thread or scope name is first seen
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<TraceThread>> threads; // Kept after their thread ends
+    uint64_t start_ticks = trace_ticks();
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+};
+
+inline TraceRegistry &trace_registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+inline uint16_t trace_name_id(const char *name) {
+    TraceRegistry &registry = trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t i = 0; i < registry.names.size(); i++) {
+        if (registry.names[i] == name) {
+            return (uint16_t)i;
+        }
+    }
+    registry.names.push_back(name);
+    return (uint16_t)(registry.names.size() - 1);
+}
+
+inline TraceThread &trace_thread() {
+    thread_local TraceThread *thread = nullptr;
+    if (!thread) {
+        TraceRegistry &registry = trace_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.emplace_back(new TraceThread((int)registry.threads.size()));
+        thread = registry.threads.back().get();
+    }
+    return *thread;
+}
+
+class TraceScope
+{
+private:
+    TraceThread &thread;
+    int32_t node;
+    uint64_t start;
+
+public:
+    TraceScope(uint16_t name) : thread(trace_thread()){
+        node = thread.enter(name);
+        start = trace_ticks();
+    }
+    ~TraceScope(){
+        uint64_t end = trace_ticks();
+        thread.leave(node, start, end - start);
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) \
+    static const uint16_t TRACE_CONCAT(trace_name_, __LINE__) = trace_name_id(name); \
+    TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(TRACE_CONCAT(trace_name_, __LINE__))
+
+inline bool trace_enabled() {
+    return true;
+}
+
+// Ticks of the time stamp counter per nanosecond, measured against the steady clock
+inline double trace_ticks_per_ns() {
+    TraceRegistry &registry = trace_registry();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - registry.start_time).count();
+    return ns > 0 ? (double)(trace_ticks() - registry.start_ticks) / ns : 1.0;
+}
+
+inline std::string trace_path(const TraceRegistry &registry, const TraceThread &thread, int32_t node) {
+    std::string path = registry.names[thread.nodes[node].name];
+    for (int32_t parent = thread.nodes[node].parent; parent > 0; parent = thread.nodes[parent].parent) {
+        path = registry.names[thread.nodes[parent].name] + ";" + path;
+    }
+    return "thread " + std::to_string(thread.id) + ";" + path;
+}
+
+// One line per call path with its self time in nanoseconds
+inline bool trace_write_collapsed(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    TraceRegistry &registry = trace_registry();
+    double ticks_per_ns = trace_ticks_per_ns();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto &thread : registry.threads) {
+        for (int32_t node = 1; node < (int32_t)thread->nodes.size(); node++) {
+            uint64_t self = thread->nodes[node].ticks;
+            for (int32_t child = thread->nodes[node].first_child; child != -1; child = thread->nodes[child].next_sibling) {
+                self -= std::min(self, thread->nodes[child].ticks);
+            }
+            std::fprintf(file, "%s %llu\n", trace_path(registry, *thread, node).c_str(), (unsigned long long)(self / ticks_per_ns));
+        }
+    }
+    return std::fclose(file) == 0;
+}
+
+// Every kept scope as a complete ("X") event, times in microseconds
+inline bool trace_write_chrome(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    TraceRegistry &registry = trace_registry();
+    double ticks_per_us = trace_ticks_per_ns() * 1000.0;
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    for (const auto &thread : registry.threads) {
+        for (const TraceEvent &event : thread->events) {
+            std::fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                         first ? "" : ",", registry.names[event.name].c_str(), thread->id,
+                         (event.start - registry.start_ticks) / ticks_per_us, event.ticks / ticks_per_us);
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+// Calls, total time and time per call of every scope name, summed over all paths.
+// A recursive scope (minimax) counts the time of its inner calls again
+inline void trace_print_summary(std::ostream &out) {
+    TraceRegistry &registry = trace_registry();
+    double ticks_per_ns = trace_ticks_per_ns();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<uint64_t> calls(registry.names.size(), 0);
+    std::vector<uint64_t> ticks(registry.names.size(), 0);
+    uint64_t dropped = 0;
+    for (const auto &thread : registry.threads) {
+        for (size_t node = 1; node < thread->nodes.size(); node++) {
+            calls[thread->nodes[node].name] += thread->nodes[node].calls;
+            ticks[thread->nodes[node].name] += thread->nodes[node].ticks;
+        }
+        dropped += thread->dropped_events;
+    }
+    for (size_t name = 0; name < registry.names.size(); name++) {
+        if (calls[name] > 0) {
+            out << "info string trace " << registry.names[name] << " calls " << calls[name]
+                << " ms " << (uint64_t)(ticks[name] / ticks_per_ns / 1e6)
+                << " ns/call " << (uint64_t)(ticks[name] / ticks_per_ns / calls[name]) << "\n";
+        }
+    }
+    if (dropped > 0) {
+        out << "info string trace " << dropped << " scopes not in the Chrome trace, it keeps the first "
+            << TRACE_EVENT_CAPACITY << " per thread\n";
+    }
+}
+
+// Bytes the call trees and event buffers of all threads take
+inline size_t trace_memory_usage() {
+    TraceRegistry &registry = trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    size_t bytes = 0;
+    for (const auto &thread : registry.threads) {
+        bytes += sizeof(TraceThread) + thread->nodes.capacity() * sizeof(TraceNode) + thread->events.capacity() * sizeof(TraceEvent);
+    }
+    return bytes;
+}
+
+inline void trace_reset() {
+    TraceRegistry &registry = trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto &thread : registry.threads) {
+        thread->nodes.resize(1);
+        thread->nodes[0] = {0, -1};
+        thread->current = 0;
+        thread->events.clear();
+        thread->dropped_events = 0;
+    }
+    registry.start_ticks = trace_ticks();
+    registry.start_time = std::chrono::steady_clock::now();
+}
+
+#else
+
+#define TRACE_SCOPE(name)
+
+inline bool trace_enabled() {
+    return false;
+}
+inline bool trace_write_collapsed(const std::string &) {
+    return false;
+}
+inline bool trace_write_chrome(const std::string &) {
+    return false;
+}
+inline void trace_print_summary(std::ostream &) {
+}
+inline size_t trace_memory_usage() {
+    return 0;
+}
+inline void trace_reset() {
+}
+
+#endif
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <zobrist.h>
+#include <trace.h>
+
+// Number of entries a table gets if nothing else is asked for (24 MB)
+const size_t DEFAULT_HASH_ENTRIES = 1 << 20;
+
+// What kind of score is stored in an entry
+enum HashFlag {
+    HASH_EXACT, // Score is inside the window
+    HASH_LOWER, // Search failed high, the real score is at least this
+    HASH_UPPER  // Search failed low, the real score is at most this
+};
+
+struct HashEntry {
+    int score;
+    std::array<int, 4> move;
+    int depth;
+    HashFlag flag;
+};
+
+// How an entry is kept in the table
+struct HashSlot {
+    uint64_t key; // Zobrist hash, 0 = empty slot
+    int32_t score;
+    int8_t move[4];
+    int8_t depth;
+    uint8_t flag;
+    uint8_t age; // Search the entry was written in
+};
+
+// A saved table is this header followed by every slot, as they are in memory
+struct TableFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t zobrist_seed; // Keys made with other random numbers belong to other positions
+    uint64_t entries;
+    uint32_t slot_size;
+    uint32_t age;
+};
+
+const char TABLE_MAGIC[4] = {'C', 'T', 'T', 'B'};
+// Goes up whenever a saved table would mean something else: a change to HashSlot, to
+// what the hash covers, or to how scores are stored
+const uint32_t TABLE_VERSION = 2; // 2: scores are from the side to move's view
+
+// Table of searched positions, kept alive between searches so that
+// later searches (and pondering) can reuse the earlier work.
+// All memory is allocated up front, so probing and storing never allocate
+class TranspositionTable
+{
+private:
+    std::vector<HashSlot> slots;
+    uint64_t mask = 0;
+    uint8_t age = 0;
+
+public:
+    TranspositionTable(size_t entries = DEFAULT_HASH_ENTRIES){
+        resize(entries);
+    }
+
+    // Change the number of entries (rounded down to a power of two), this clears the table
+    void resize(size_t entries){
+        size_t size = 1;
+        while (size * 2 <= entries) {
+            size *= 2;
+        }
+        // The old slots go first, so a smaller table really gives the memory back
+        slots.clear();
+        slots.shrink_to_fit();
+        slots.assign(size, HashSlot{});
+        mask = size - 1;
+    }
+
+    // Look up a position, returns false if it has not been searched
+    bool probe(uint64_t key, HashEntry &entry){
+        TRACE_SCOPE("tt_probe");
+        const HashSlot &slot = slots[key & mask];
+        if (slot.key != key) {
+            return false;
+        }
+        entry.score = slot.score;
+        entry.move = {slot.move[0], slot.move[1], slot.move[2], slot.move[3]};
+        entry.depth = slot.depth;
+        entry.flag = (HashFlag)slot.flag;
+        return true;
+    }
+
+    // Save a searched position. The same position is never overwritten by a shallower
+    // search, another position only if its entry is from an older search or shallower
+    void store(uint64_t key, int score, const std::array<int, 4> &move, int depth, HashFlag flag){
+        TRACE_SCOPE("tt_store");
+        HashSlot &slot = slots[key & mask];
+        if (slot.key == key ? slot.depth > depth : (slot.age == age && slot.depth > depth)) {
+            return;
+        }
+        slot.key = key;
+        slot.score = score;
+        for (int i = 0; i < 4; i++) {
+            slot.move[i] = (int8_t)move[i];
+        }
+        slot.depth = (int8_t)depth;
+        slot.flag = (uint8_t)flag;
+        slot.age = age;
+    }
+
+    // Called when a search starts, entries of older searches get replaced first
+    void new_search(){
+        age++;
+    }
+
+    void clear(){
+        slots.assign(slots.size(), HashSlot{});
+    }
+
+    size_t capacity(){
+        return slots.size();
+    }
+
+    // Bytes the slots take
+    size_t memory_usage() const{
+        return slots.capacity() * sizeof(HashSlot);
+    }
+
+    // Most entries a table can have in this many bytes, a power of two. 0 if not even one fits
+    static size_t entries_within(size_t bytes){
+        size_t entries = bytes / sizeof(HashSlot);
+        if (entries == 0) {
+            return 0;
+        }
+        size_t size = 1;
+        while (size * 2 <= entries) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    // Write the table to a file, so a later run can start with it
+    bool save(const std::string &path){
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        TableFileHeader header = {{TABLE_MAGIC[0], TABLE_MAGIC[1], TABLE_MAGIC[2], TABLE_MAGIC[3]},
+                                  TABLE_VERSION, ZOBRIST_SEED, slots.size(), sizeof(HashSlot), age};
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(slots.data(), sizeof(HashSlot), slots.size(), file) == slots.size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+    // Replace the table with a saved one, it takes the size of the saved table.
+    // The old slots are freed first and the saved ones read straight into the new table, so
+    // loading needs no more memory than the table itself. If it isn't a table of this version
+    // with the same hash keys, or it has more than max_entries, nothing changes and false is
+    // returned. If reading fails part way the table is left empty
+    bool load(const std::string &path, size_t max_entries = SIZE_MAX){
+        std::error_code error;
+        uintmax_t file_size = std::filesystem::file_size(path, error);
+        if (error || file_size < sizeof(TableFileHeader)) {
+            return false;
+        }
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        TableFileHeader header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, TABLE_MAGIC, 4) != 0 ||
+            header.version != TABLE_VERSION || header.zobrist_seed != ZOBRIST_SEED || header.slot_size != sizeof(HashSlot)) {
+            std::fclose(file);
+            return false;
+        }
+        // The size has to be a power of two for the mask, and the file has to hold all of it
+        uint64_t entries = header.entries;
+        if (entries == 0 || (entries & (entries - 1)) != 0 || entries > max_entries ||
+            file_size != sizeof(TableFileHeader) + entries * sizeof(HashSlot)) {
+            std::fclose(file);
+            return false;
+        }
+        slots.clear();
+        slots.shrink_to_fit();
+        slots.resize(entries);
+        mask = entries - 1;
+        bool ok = std::fread(slots.data(), sizeof(HashSlot), entries, file) == entries;
+        std::fclose(file);
+        if (!ok) {
+            clear();
+            return false;
+        }
+        age = (uint8_t)header.age;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <array>
+#include <cstdint>
+
+// Random numbers for hashing positions. Every piece on every square, the
+// castling rights, the en passant file and the side to move get a number,
+// and a position's hash is the xor of the numbers of everything in it.
+// The numbers are made at compile time from a fixed seed, so hashes are the
+// same in every build and run
+
+// Changing this changes every hash, anything that stores hashes has to check it
+const uint64_t ZOBRIST_SEED = 0x9E3779B97F4A7C15ULL;
+
+constexpr uint64_t splitmix64(uint64_t &state) {
+    state += 0x9E3779B97F4A7C15ULL;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+    uint64_t pieces[13][64]; // [piece + 6][row * 8 + col], index 6 (empty) is all zero
+    uint64_t castle[16];     // Index made from the four castling rights, see castle_index
+    uint64_t en_passant[8];  // By column
+    uint64_t black_to_move;
+};
+
+constexpr ZobristKeys make_zobrist_keys() {
+    ZobristKeys keys = {};
+    uint64_t state = ZOBRIST_SEED;
+    for (int piece = 0; piece < 13; piece++) {
+        for (int square = 0; square < 64; square++) {
+            keys.pieces[piece][square] = piece == 6 ? 0 : splitmix64(state);
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        keys.castle[i] = i == 0 ? 0 : splitmix64(state);
+    }
+    for (int i = 0; i < 8; i++) {
+        keys.en_passant[i] = splitmix64(state);
+    }
+    keys.black_to_move = splitmix64(state);
+    return keys;
+}
+
+constexpr ZobristKeys ZOBRIST = make_zobrist_keys();
+
+#endif
@@ -0,0 +1,481 @@
+// Plays two engine builds against each other and reports the Elo difference.
+// Every opening is played twice with the colours swapped, several games at a time,
+// and the match stops early once the SPRT has decided.
+//
+//   match_runner -engine1 ./new.exe -engine2 ./old.exe -openings openings.txt [options]
+//
+// Options:
+//   -games N          Games to play at most (default 200)
+//   -concurrency N    Games played at the same time (default: one per core)
+//   -depth N          Fixed depth per move (default 5)
+//   -movetime MS      Time per move instead of a fixed depth
+//   -init1 CMD        Command sent to engine 1 when it starts, e.g. "ponder off" (repeatable)
+//   -init2 CMD        Same for engine 2
+//   -sprt ELO0 ELO1   Test H0: elo <= ELO0 against H1: elo >= ELO1 (default 0 5)
+//   -alpha A -beta B  SPRT error rates (default 0.05 0.05)
+//   -maxplies N       Draw after this many plies (default 400)
+//   -winscore S       Adjudicate a win when both engines agree on this score ...
+//   -winmoves N       ... for N plies in a row (default 100 and 8)
+//   -drawscore S      Adjudicate a draw when the score stays within this ...
+//   -drawmoves N      ... for N plies in a row, after -drawstart plies (default 1, 20, 80)
+//   Scores are in the engine's eval units, a pawn is 10
+//
+// Engines are talked to with the same line protocol the python program uses.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <board_representation.h>
+#include <sprt.h>
+
+// Depth asked for when the search is ended by "stop" instead
+const int MOVETIME_DEPTH = 64;
+// How long past its time an engine may take to answer before it forfeits
+const int MOVE_GRACE_MS = 2000;
+// Fixed depth searches get this long per move before forfeiting
+const int DEPTH_TIMEOUT_MS = 120000;
+
+struct MatchConfig {
+    std::string engine_path[2];
+    std::vector<std::string> init_commands[2];
+    std::string openings_file;
+    int games = 200;
+    int concurrency = 0;
+    int depth = 5;
+    int movetime_ms = 0;
+    double elo0 = 0.0;
+    double elo1 = 5.0;
+    double alpha = 0.05;
+    double beta = 0.05;
+    int max_plies = 400;
+    int win_score = 100; // Eval units, a pawn is 10
+    int win_plies = 8;
+    int draw_score = 1;
+    int draw_plies = 20;
+    int draw_start = 80;
+};
+
+// An engine running as a child process, talked to through pipes
+class EngineProcess
+{
+private:
+    pid_t pid = -1;
+    int to_engine = -1;
+    int from_engine = -1;
+    std::string buffer; // Read but not yet returned output
+    bool alive = false;
+
+public:
+    bool start(const std::string &path){
+        int input[2];
+        int output[2];
+        if (pipe(input) != 0 || pipe(output) != 0) {
+            return false;
+        }
+        pid = fork();
+        if (pid < 0) {
+            return false;
+        }
+        if (pid == 0) {
+            dup2(input[0], STDIN_FILENO);
+            dup2(output[1], STDOUT_FILENO);
+            close(input[0]);
+            close(input[1]);
+            close(output[0]);
+            close(output[1]);
+            execl(path.c_str(), path.c_str(), (char *)nullptr);
+            _exit(127);
+        }
+        close(input[0]);
+        close(output[1]);
+        to_engine = input[1];
+        from_engine = output[0];
+        alive = true;
+        return true;
+    }
+
+    void send(const std::string &line){
+        std::string data = line + "\n";
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = write(to_engine, data.c_str() + written, data.size() - written);
+            if (n <= 0) {
+                return;
+            }
+            written += n;
+        }
+    }
+
+    // Read one line, false if nothing came within the timeout or the engine died
+    bool read_line(std::string &line, int timeout_ms){
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (true) {
+            size_t end = buffer.find('\n');
+            if (end != std::string::npos) {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                return true;
+            }
+            int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) {
+                return false;
+            }
+            pollfd fd = {from_engine, POLLIN, 0};
+            if (poll(&fd, 1, left) <= 0) {
+                continue;
+            }
+            char chunk[4096];
+            ssize_t n = read(from_engine, chunk, sizeof(chunk));
+            if (n <= 0) {
+                alive = false;
+                return false;
+            }
+            buffer.append(chunk, n);
+        }
+    }
+
+    bool is_alive(){
+        return alive;
+    }
+
+    ~EngineProcess(){
+        if (pid <= 0) {
+            return;
+        }
+        send("close program");
+        close(to_engine);
+        close(from_engine);
+        // Give it a moment to exit on its own
+        for (int i = 0; i < 100; i++) {
+            if (waitpid(pid, nullptr, WNOHANG) != 0) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+};
+
+// Ask an engine for its move, false if it didn't answer in time.
+// The score is white's point of view, like everywhere in the engine
+bool request_move(EngineProcess &engine, const std::string &fen, int side, const MatchConfig &config, std::array<int, 4> &move, int &score){
+    int depth = config.movetime_ms > 0 ? MOVETIME_DEPTH : config.depth;
+    engine.send(std::to_string(side) + "," + std::to_string(depth) + "," + fen);
+
+    auto start = std::chrono::steady_clock::now();
+    int limit_ms = config.movetime_ms > 0 ? config.movetime_ms + MOVE_GRACE_MS : DEPTH_TIMEOUT_MS;
+    bool stop_sent = config.movetime_ms == 0;
+    bool have_move = false;
+    std::string line;
+    while (engine.is_alive()) {
+        int elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= limit_ms) {
+            return false;
+        }
+        // Once the time is used the search is stopped, it then reports its best move
+        int wait_ms = (stop_sent ? limit_ms : config.movetime_ms) - elapsed;
+        if (!stop_sent && wait_ms <= 0) {
+            engine.send("stop");
+            stop_sent = true;
+            continue;
+        }
+        if (!engine.read_line(line, wait_ms)) {
+            continue;
+        }
+        if (line.rfind("Best move: ", 0) == 0) {
+            char comma;
+            std::stringstream ss(line.substr(11));
+            ss >> move[0] >> comma >> move[1] >> comma >> move[2] >> comma >> move[3];
+            have_move = true;
+        } else if (line.rfind("Score: ", 0) == 0) {
+            score = std::atoi(line.c_str() + 7);
+        } else if (line == "We are done") {
+            return have_move;
+        }
+    }
+    return false;
+}
+
+// Only kings and at most one bishop or knight left, nobody can mate
+bool insufficient_material(Board &board){
+    int minors = 0;
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            int piece = std::abs(board.piece_at(row, col));
+            if (piece == 1 || piece == 2 || piece == 6) {
+                return false;
+            }
+            if (piece == 3 || piece == 4) {
+                minors++;
+            }
+        }
+    }
+    return minors <= 1;
+}
+
+struct GameResult {
+    int result; // 1 white won, -1 black won, 0 draw
+    std::string reason;
+};
+
+// Play one game from the opening, the Board decides what is legal and when the game is over.
+// A fresh Board is set up from the FEN every move, so long games don't fill its move history
+GameResult play_game(EngineProcess &white, EngineProcess &black, const std::string &opening, const MatchConfig &config, const std::atomic<bool> &abort){
+    std::string fen = opening;
+    int side = opening.find(" b ") != std::string::npos ? -1 : 1;
+    std::vector<uint64_t> positions; // Hashes since the last capture or pawn move
+    int win_count = 0;
+    int draw_count = 0;
+
+    for (int ply = 0; ply < config.max_plies; ply++) {
+        if (abort) {
+            return {0, "aborted"};
+        }
+        Board board(fen);
+        MoveList legal;
+        board.generate_moves(side, legal);
+        if (legal.empty()) {
+            if (board.in_check(side)) {
+                return {-side, "checkmate"};
+            }
+            return {0, "stalemate"};
+        }
+        if (board.is_fifty_move_draw()) {
+            return {0, "fifty moves"};
+        }
+        if (insufficient_material(board)) {
+            return {0, "insufficient material"};
+        }
+        if (board.get_halfmove_clock() == 0) {
+            positions.clear();
+        }
+        uint64_t hash = board.get_hash(side);
+        positions.push_back(hash);
+        if (std::count(positions.begin(), positions.end(), hash) >= 3) {
+            return {0, "threefold repetition"};
+        }
+
+        std::array<int, 4> move;
+        int score = 0;
+        if (!request_move(side == 1 ? white : black, fen, side, config, move, score)) {
+            return {-side, "time forfeit"};
+        }
+        if (std::find(legal.begin(), legal.end(), move) == legal.end()) {
+            return {-side, "illegal move " + std::to_string(move[0]) + "," + std::to_string(move[1]) + "," + std::to_string(move[2]) + "," + std::to_string(move[3])};
+        }
+
+        // Both engines have to see the same side winning for a while in a row
+        if (std::abs(score) >= config.win_score) {
+            win_count = (win_count != 0 && (win_count > 0) == (score > 0)) ? win_count + (score > 0 ? 1 : -1) : (score > 0 ? 1 : -1);
+            if (std::abs(win_count) >= config.win_plies) {
+                return {win_count > 0 ? 1 : -1, "adjudicated win"};
+            }
+        } else {
+            win_count = 0;
+        }
+        if (ply >= config.draw_start && std::abs(score) <= config.draw_score) {
+            if (++draw_count >= config.draw_plies) {
+                return {0, "adjudicated draw"};
+            }
+        } else {
+            draw_count = 0;
+        }
+
+        board.move_piece(move[0], move[1], move[2], move[3]);
+        side = -side;
+        fen = board.board_to_fen(side);
+    }
+    return {0, "move limit"};
+}
+
+// One FEN per line, empty lines and lines starting with # are skipped
+std::vector<std::string> read_openings(const std::string &path){
+    std::vector<std::string> openings;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        openings.push_back(line);
+    }
+    return openings;
+}
+
+bool parse_args(int argc, char *argv[], MatchConfig &config){
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-engine1" && has_value) {
+            config.engine_path[0] = argv[++i];
+        } else if (arg == "-engine2" && has_value) {
+            config.engine_path[1] = argv[++i];
+        } else if (arg == "-init1" && has_value) {
+            config.init_commands[0].push_back(argv[++i]);
+        } else if (arg == "-init2" && has_value) {
+            config.init_commands[1].push_back(argv[++i]);
+        } else if (arg == "-openings" && has_value) {
+            config.openings_file = argv[++i];
+        } else if (arg == "-games" && has_value) {
+            config.games = std::atoi(argv[++i]);
+        } else if (arg == "-concurrency" && has_value) {
+            config.concurrency = std::atoi(argv[++i]);
+        } else if (arg == "-depth" && has_value) {
+            config.depth = std::atoi(argv[++i]);
+        } else if (arg == "-movetime" && has_value) {
+            config.movetime_ms = std::atoi(argv[++i]);
+        } else if (arg == "-sprt" && i + 2 < argc) {
+            config.elo0 = std::atof(argv[++i]);
+            config.elo1 = std::atof(argv[++i]);
+        } else if (arg == "-alpha" && has_value) {
+            config.alpha = std::atof(argv[++i]);
+        } else if (arg == "-beta" && has_value) {
+            config.beta = std::atof(argv[++i]);
+        } else if (arg == "-maxplies" && has_value) {
+            config.max_plies = std::atoi(argv[++i]);
+        } else if (arg == "-winscore" && has_value) {
+            config.win_score = std::atoi(argv[++i]);
+        } else if (arg == "-winmoves" && has_value) {
+            config.win_plies = std::atoi(argv[++i]);
+        } else if (arg == "-drawscore" && has_value) {
+            config.draw_score = std::atoi(argv[++i]);
+        } else if (arg == "-drawmoves" && has_value) {
+            config.draw_plies = std::atoi(argv[++i]);
+        } else if (arg == "-drawstart" && has_value) {
+            config.draw_start = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+    }
+    if (config.engine_path[0].empty() || config.engine_path[1].empty() || config.openings_file.empty()) {
+        std::cerr << "Usage: match_runner -engine1 PATH -engine2 PATH -openings FILE [options]" << std::endl;
+        return false;
+    }
+    if (config.concurrency <= 0) {
+        config.concurrency = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return true;
+}
+
+void print_summary(const MatchScore &match, const MatchConfig &config){
+    EloEstimate elo = estimate_elo(match);
+    double llr = sprt_llr(match, config.elo0, config.elo1);
+    std::cout << "Score of engine1 vs engine2: " << match.wins << " - " << match.losses << " - " << match.draws
+              << " [" << match.score() << "] " << match.games() << std::endl;
+    std::cout << "Elo difference: " << elo.elo << " +/- " << elo.error << std::endl;
+    std::cout << "SPRT: llr " << llr << " (" << sprt_lower_bound(config.alpha, config.beta) << ", "
+              << sprt_upper_bound(config.alpha, config.beta) << ") [" << config.elo0 << ", " << config.elo1 << "]" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    MatchConfig config;
+    if (!parse_args(argc, argv, config)) {
+        return 1;
+    }
+    std::vector<std::string> openings = read_openings(config.openings_file);
+    if (openings.empty()) {
+        std::cerr << "No openings in " << config.openings_file << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN); // A crashed engine shows up as a forfeit, not a dead runner
+
+    std::atomic<int> next_game{0};
+    std::atomic<bool> finished{false};
+    std::mutex results_mutex;
+    MatchScore match;
+
+    // Every worker has its own pair of engines and plays one game at a time
+    auto worker = [&]() {
+        std::unique_ptr<EngineProcess> engines[2];
+        // (Re)start both engines, after a forfeit they may still be searching
+        auto start_engines = [&]() {
+            for (int e = 0; e < 2; e++) {
+                engines[e].reset(new EngineProcess());
+                if (!engines[e]->start(config.engine_path[e])) {
+                    std::lock_guard<std::mutex> lock(results_mutex);
+                    std::cerr << "Could not start " << config.engine_path[e] << std::endl;
+                    finished = true;
+                    return;
+                }
+                for (const std::string &command : config.init_commands[e]) {
+                    engines[e]->send(command);
+                }
+                // Wait until it's up, so starting it doesn't eat into the first move's time
+                engines[e]->send("isready");
+                std::string line;
+                while (engines[e]->read_line(line, DEPTH_TIMEOUT_MS) && line != "readyok") {
+                }
+            }
+        };
+        start_engines();
+        while (!finished) {
+            int game = next_game++;
+            if (game >= config.games) {
+                return;
+            }
+            // Each opening twice in a row, engine 1 has white in the first game
+            const std::string &opening = openings[(game / 2) % openings.size()];
+            bool engine1_white = game % 2 == 0;
+            GameResult result = play_game(*engines[engine1_white ? 0 : 1], *engines[engine1_white ? 1 : 0], opening, config, finished);
+            if (result.reason == "aborted") {
+                return;
+            }
+            if (result.reason == "time forfeit" || result.reason.rfind("illegal move", 0) == 0) {
+                start_engines();
+            }
+
+            std::lock_guard<std::mutex> lock(results_mutex);
+            int engine1_result = engine1_white ? result.result : -result.result;
+            if (engine1_result > 0) {
+                match.wins++;
+            } else if (engine1_result < 0) {
+                match.losses++;
+            } else {
+                match.draws++;
+            }
+            std::cout << "Game " << game + 1 << " (" << (engine1_white ? "engine1 - engine2" : "engine2 - engine1") << "): "
+                      << (result.result > 0 ? "1-0" : result.result < 0 ? "0-1" : "1/2-1/2") << " " << result.reason << std::endl;
+            print_summary(match, config);
+
+            SprtResult sprt = sprt_test(sprt_llr(match, config.elo0, config.elo1), config.alpha, config.beta);
+            if (sprt != SPRT_CONTINUE && !finished) {
+                std::cout << "SPRT: " << (sprt == SPRT_ACCEPT_H1 ? "H1 accepted, engine1 is stronger" : "H0 accepted, engine1 is not stronger") << std::endl;
+                finished = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < config.concurrency; i++) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+
+    std::cout << "Match finished" << std::endl;
+    print_summary(match, config);
+    return 0;
+}
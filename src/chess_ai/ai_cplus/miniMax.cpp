@@ -11,12 +11,51 @@
 #include <eval_functions.h>
 #include <board_representation.h>
 #include <search_algorithm.h>
+#include <search_thread.h>
+#include <bench.h>
+#include <trace.h>
+#include <memory_audit.h>
+#include <mate_search.h>
+#include <game_annotation.h>
+#include <chrono>
 #include <random>
 
 
-// This program should sit and wait for FEN strings from the python program
-int main() {
+// Print the result of a search in the format the python program reads
+void report_result(Board &board, const MiniMaxResult &result) {
+    std::lock_guard<std::mutex> lock(output_mutex());
+    if(result.move[0] != -1){
+        std::vector<std::array<int, 4>> yup = board.debug_moves(result.move[0],result.move[1]);
+        for(int i = 0; i < yup.size(); i++){
+        std::cout << yup[i][0] << "," << yup[i][1] << "," << yup[i][2] << "," << yup[i][3] << std::endl;
+        }
+    }
+    
+    std::cout << "Best move: " << result.move[0] << "," << result.move[1] << "," << result.move[2] << "," << result.move[3] << std::endl;
+    std::cout << "Score: " << result.score << std::endl;
+    std::cout << "We are done" << std::endl;
+}
+
+// This program should sit and wait for FEN strings from the python program.
+// Searches run on a worker thread, so "stop" and "isready" are answered while searching.
+// Started as "miniMax bench [depth] [trace file]" it runs the bench and exits (used for profile
+// guided builds, and to trace a -DSEARCH_TRACE build)
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        run_bench(argc > 2 ? std::atoi(argv[2]) : BENCH_DEPTH);
+        // "bench DEPTH FILE" also writes the trace of a -DSEARCH_TRACE build
+        if (argc > 3 && trace_enabled()) {
+            std::string path = argv[3];
+            trace_print_summary(std::cout);
+            return (path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0 ? trace_write_chrome(path) : trace_write_collapsed(path)) ? 0 : 1;
+        }
+        return 0;
+    }
+
     std::string input_string;
+    SearchState state; // Kept between requests so earlier searches (and pondering) are reused
+    SearchThread search_thread(state, report_result);
+    MemoryPhaseScope commands_phase(MEMORY_COMMANDS);
 
     while (std::getline(std::cin, input_string))
     {
@@ -26,6 +65,239 @@ int main() {
         {
             break;
         }
+        // Toggle searching on the opponent's time
+        if (input_string == "ponder on" || input_string == "ponder off")
+        {
+            search_thread.set_ponder(input_string == "ponder on");
+            continue;
+        }
+        // Stop the running search, it reports the best move found so far
+        if (input_string == "stop")
+        {
+            search_thread.stop();
+            continue;
+        }
+        // Pruning near the leaves, off to compare against it in a match
+        if (input_string == "pruning on" || input_string == "pruning off")
+        {
+            search_thread.stop();
+            search_thread.wait();
+            state.pruning.enabled = input_string == "pruning on";
+            continue;
+        }
+        // Number of best lines the search finds, "multipv 3" for the top three moves
+        if (input_string.rfind("multipv ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            state.multi_pv = std::max(1, std::min(std::atoi(input_string.c_str() + 8), MAX_MULTI_PV));
+            continue;
+        }
+        // Keep the hash table between runs, "savehash FILE" and "loadhash FILE"
+        if (input_string.rfind("savehash ", 0) == 0 || input_string.rfind("loadhash ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            std::string path = input_string.substr(9);
+            bool save = input_string[0] == 's';
+            bool ok = save ? state.hash_table.save(path) : state.hash_table.load(path, hash_entries_allowed(state, search_thread));
+            std::lock_guard<std::mutex> lock(output_mutex());
+            if (ok) {
+                std::cout << "info string hash " << (save ? "saved to " : "loaded from ") << path
+                          << " (" << state.hash_table.capacity() << " entries)" << std::endl;
+            } else {
+                std::cout << "info string could not " << (save ? "save hash to " : "load hash from ") << path << std::endl;
+            }
+            continue;
+        }
+        // What the engine's structures take, "memory limit MB" caps it (0 takes the cap away)
+        if (input_string == "memory")
+        {
+            print_memory_report(state, search_thread);
+            continue;
+        }
+        if (input_string.rfind("memory limit ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            size_t megabytes = std::strtoull(input_string.c_str() + 13, nullptr, 10);
+            bool ok = set_memory_limit(state, search_thread, megabytes * 1024 * 1024);
+            std::lock_guard<std::mutex> lock(output_mutex());
+            if (ok) {
+                std::cout << "info string memory limit " << megabytes << " MB, hash table "
+                          << state.hash_table.capacity() << " entries" << std::endl;
+            } else {
+                std::cout << "info string could not limit memory to " << megabytes << " MB" << std::endl;
+            }
+            continue;
+        }
+        // Engine the searches run with, "engine minimax" or "engine mcts".
+        // "mcts threads N" and "mcts playout N" (random plies before a leaf is evaluated) tune MCTS
+        if (input_string.rfind("engine ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            std::string name = input_string.substr(7);
+            bool known = name == SEARCH_ENGINE_NAMES[ENGINE_MINIMAX] || name == SEARCH_ENGINE_NAMES[ENGINE_MCTS];
+            bool ok = known && set_search_engine(state, search_thread, name == SEARCH_ENGINE_NAMES[ENGINE_MCTS] ? ENGINE_MCTS : ENGINE_MINIMAX);
+            std::lock_guard<std::mutex> lock(output_mutex());
+            if (ok) {
+                std::cout << "info string engine " << name;
+                if (search_thread.get_engine() == ENGINE_MCTS) {
+                    std::cout << " (" << search_thread.mcts_search().capacity() << " tree nodes)";
+                }
+                std::cout << std::endl;
+            } else {
+                std::cout << "info string could not switch to engine " << name << std::endl;
+            }
+            continue;
+        }
+        if (input_string.rfind("mcts threads ", 0) == 0 || input_string.rfind("mcts playout ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            MctsConfig &config = search_thread.mcts_search().config;
+            int value = std::atoi(input_string.c_str() + 13);
+            if (input_string[5] == 't') {
+                config.threads = std::max(1, std::min(value, MAX_MCTS_THREADS));
+            } else {
+                config.playout_plies = std::max(0, std::min(value, MAX_MCTS_PLAYOUT));
+            }
+            std::lock_guard<std::mutex> lock(output_mutex());
+            std::cout << "info string mcts threads " << config.threads << " playout " << config.playout_plies << std::endl;
+            continue;
+        }
+        // Annotate every move of a game, "annotate DEPTH file PATH" for the first game of a PGN
+        // file or "annotate DEPTH MOVES" with the game on the line (PGN movetext, tags allowed)
+        if (input_string.rfind("annotate ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            MemoryPhaseScope annotate_phase(MEMORY_SEARCH);
+            std::stringstream annotate_ss(input_string.substr(9));
+            int annotate_depth = 0;
+            annotate_ss >> annotate_depth;
+            std::string rest;
+            std::getline(annotate_ss >> std::ws, rest);
+            PgnGame game;
+            bool found;
+            if (rest.rfind("file ", 0) == 0) {
+                PgnReader reader(rest.substr(5));
+                found = reader.is_open() && reader.next_game(game);
+            } else {
+                found = game_from_pgn_text(rest, game);
+            }
+            Board game_board("");
+            if (!found || !game_board.parse_fen(game.fen)) {
+                std::lock_guard<std::mutex> lock(output_mutex());
+                std::cout << "info string could not read the game" << std::endl;
+                continue;
+            }
+            state.stop = false; // Left set by the stop above
+            GameAnnotation annotation = annotate_game(game_board, game_board.current_player, game.moves, annotate_depth, state);
+            std::lock_guard<std::mutex> lock(output_mutex());
+            print_annotation(annotation);
+            continue;
+        }
+        // Mate solver for puzzles, "mate N FEN" looks for a mate in at most N moves of the side
+        // to move (0 = any mate it can find). The line alternates the mating side's moves and the
+        // longest defence
+        if (input_string.rfind("mate ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            MemoryPhaseScope mate_phase(MEMORY_SEARCH);
+            std::stringstream mate_ss(input_string.substr(5));
+            int max_moves = 0;
+            mate_ss >> max_moves;
+            std::string mate_fen;
+            std::getline(mate_ss >> std::ws, mate_fen);
+            Board mate_board("");
+            if (!mate_board.parse_fen(mate_fen)) {
+                std::lock_guard<std::mutex> lock(output_mutex());
+                std::cout << "info string mate unknown invalid FEN" << std::endl;
+                continue;
+            }
+            // The node table shares the memory limit with the hash table
+            size_t entries = DEFAULT_MATE_ENTRIES;
+            if (state.memory_limit != 0) {
+                size_t used = state.hash_table.memory_usage() + fixed_memory_usage(state, search_thread);
+                entries = std::min(entries, MateSearch::entries_within(state.memory_limit > used ? state.memory_limit - used : 0));
+            }
+            auto start = std::chrono::steady_clock::now();
+            MateResult mate;
+            if (entries > 0) {
+                MateSearch solver(entries);
+                mate = solver.solve(mate_board, mate_board.current_player, max_moves > 0 ? max_moves : MAX_MATE_MOVES);
+            } else {
+                mate.aborted = true;
+            }
+            long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            std::lock_guard<std::mutex> lock(output_mutex());
+            std::cout << "info string mate " << (mate.found ? std::to_string(mate.moves) : mate.aborted ? "unknown" : "none")
+                      << " nodes " << mate.nodes << " time " << ms;
+            if (mate.found) {
+                std::cout << " pv";
+                for (const std::array<int, 4> &move : mate.line) {
+                    std::cout << " " << move[0] << "," << move[1] << "," << move[2] << "," << move[3];
+                }
+            }
+            std::cout << std::endl;
+            continue;
+        }
+        // Write what the hot path tracing measured and start over, "trace FILE". A .json file
+        // gets a Chrome trace, anything else collapsed stacks for a flame graph
+        if (input_string.rfind("trace ", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            std::string path = input_string.substr(6);
+            bool chrome = path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+            std::lock_guard<std::mutex> lock(output_mutex());
+            if (!trace_enabled()) {
+                std::cout << "info string tracing is not built in, build with -DSEARCH_TRACE" << std::endl;
+                continue;
+            }
+            trace_print_summary(std::cout);
+            bool ok = chrome ? trace_write_chrome(path) : trace_write_collapsed(path);
+            std::cout << "info string " << (ok ? "trace written to " : "could not write trace to ") << path << std::endl;
+            trace_reset();
+            continue;
+        }
+        // Liveness ping
+        if (input_string == "isready")
+        {
+            std::lock_guard<std::mutex> lock(output_mutex());
+            std::cout << "readyok" << std::endl;
+            continue;
+        }
+        // Fixed workload, prints a node count signature and nodes per second
+        if (input_string.rfind("bench", 0) == 0)
+        {
+            search_thread.stop();
+            search_thread.wait();
+            int bench_depth = input_string.size() > 6 ? std::atoi(input_string.c_str() + 6) : BENCH_DEPTH;
+            std::lock_guard<std::mutex> lock(output_mutex());
+            run_bench(bench_depth > 0 ? bench_depth : BENCH_DEPTH);
+            continue;
+        }
+        // Statistics of the running (or last) search
+        if (input_string == "stats")
+        {
+            print_search_stats(state);
+            continue;
+        }
+        // Best move of the running search, without stopping it
+        if (input_string == "bestmove")
+        {
+            MiniMaxResult best = search_thread.best_so_far();
+            std::lock_guard<std::mutex> lock(output_mutex());
+            std::cout << "Best so far: " << best.move[0] << "," << best.move[1] << "," << best.move[2] << "," << best.move[3] << " Score: " << best.score << std::endl;
+            continue;
+        }
+        // Everything from here on is setting up the search
+        MemoryPhaseScope setup_phase(MEMORY_SETUP);
+
         // Get the string stream
         std::stringstream input_ss(input_string);
         int player;
@@ -48,28 +320,28 @@ int main() {
         // Extract the rest of the string
         std::getline(input_ss, fen);
 
-        std::cout << "FEN: " << fen << std::endl;
-
-        // start the board up   
-        Board board(fen);
-        std::vector<std::array<int, 4>> moves = board.get_allmoves(player);
-        MiniMaxResult result;
-        if(player == 1){
-            result = start_minimax(depth, &board, true);
-        }else{
-            result = start_minimax(depth, &board, false);
+        {
+            std::lock_guard<std::mutex> lock(output_mutex());
+            std::cout << "FEN: " << fen << std::endl;
         }
-        std::vector<std::array<int, 4>> yup = board.debug_moves(result.move[0],result.move[1]);
-        for(int i = 0; i < yup.size(); i++){
-        std::cout << yup[i][0] << "," << yup[i][1] << "," << yup[i][2] << "," << yup[i][3] << std::endl;
+
+        // start the board up, the worker takes it from here.
+        // If the opponent played the move we pondered on, the ponder search carries on
+        Board board("");
+        if (!board.parse_fen(fen)) {
+            // Still finish the reply, the python program waits for it
+            std::lock_guard<std::mutex> lock(output_mutex());
+            std::cout << "Invalid FEN: " << fen << std::endl;
+            std::cout << "Best move: -1,-1,-1,-1" << std::endl;
+            std::cout << "Score: 0" << std::endl;
+            std::cout << "We are done" << std::endl;
+            continue;
         }
-        
-        std::cout << "Best move: " << result.move[0] << "," << result.move[1] << "," << result.move[2] << "," << result.move[3] << std::endl;
-        std::cout << "Score: " << result.score << std::endl;
-        std::cout << "We are done" << std::endl;
+        search_thread.go(board, depth, player == 1);
     }
+    search_thread.stop();
+    search_thread.wait();
 
     std::cout << "C++ program finished" << std::endl;
     return 0;
 }
-
@@ -0,0 +1,404 @@
+// Tunes the evaluation parameters on labelled positions (Texel's method) and writes
+// them back into eval_values.h. The positions are turned into their evaluation
+// features once, after that an epoch is a pass over a flat array of features.
+//
+//   texel_tuner -positions games.bin [options]
+//
+// The positions are either a dataset made by dataset/pgn_converter, or a text file
+// where every line is a FEN followed by the result of its game:
+//   rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2 1-0
+// The result can be written as 1-0, 0-1, 1/2-1/2 or [1.0], [0.5], [0.0], and
+// EPD lines (... c9 "1-0";) work too.
+//
+// Options:
+//   -eval FILE       eval_values.h to read the layout from (default headers/eval_values.h)
+//   -out FILE        Where the tuned eval_values.h goes (default: overwrite -eval)
+//   -epochs N        Passes over the positions (default 1000)
+//   -rate R          Adam learning rate, in evaluation units (default 1.0)
+//   -k K             Scaling of the score to a win chance (default: fitted to the positions)
+//   -threads N       Threads used (default: one per core)
+//   -save N          Write the output every N epochs (default 100)
+//   -all             Keep positions that aren't quiet
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <board_representation.h>
+#include <move_picker.h>
+#include <packed_position.h>
+#include <eval_params.h>
+
+struct TunerConfig {
+    std::string positions_file;
+    std::string eval_file = "headers/eval_values.h";
+    std::string out_file;
+    int epochs = 1000;
+    double rate = 1.0;
+    double k = 0.0; // 0 = fit it
+    int threads = 0;
+    int save_every = 100;
+    bool quiet_only = true;
+};
+
+// All positions as one flat array of features, position i owns
+// features[offsets[i]] up to features[offsets[i + 1]]
+struct TuningSet {
+    std::vector<EvalFeature> features;
+    std::vector<size_t> offsets{0};
+    std::vector<float> results; // 1 = white won, 0.5 = draw, 0 = black won
+
+    size_t size() const{
+        return results.size();
+    }
+
+    void append(const TuningSet &other){
+        size_t base = features.size();
+        features.insert(features.end(), other.features.begin(), other.features.end());
+        for (size_t i = 1; i < other.offsets.size(); i++) {
+            offsets.push_back(base + other.offsets[i]);
+        }
+        results.insert(results.end(), other.results.begin(), other.results.end());
+    }
+};
+
+// Split a line into its FEN and result, false if there is no result on it
+bool parse_position_line(const std::string &line, std::string &fen, float &result){
+    const std::pair<const char *, float> labels[] = {
+        {"1/2-1/2", 0.5f}, {"1-0", 1.0f}, {"0-1", 0.0f}, {"[1.0]", 1.0f}, {"[0.5]", 0.5f}, {"[0.0]", 0.0f}
+    };
+    size_t end = std::string::npos;
+    for (const auto &label : labels) {
+        size_t pos = line.find(label.first);
+        if (pos != std::string::npos && pos < end) {
+            end = pos;
+            result = label.second;
+        }
+    }
+    if (end == std::string::npos) {
+        return false;
+    }
+    fen = line.substr(0, end);
+    // Drop what separates the FEN from the result: spaces, quotes, ';' '|' ',' and the EPD "c9" opcode
+    size_t last = fen.find_last_not_of(" \t\"';|,");
+    fen.erase(last == std::string::npos ? 0 : last + 1);
+    if (fen.size() >= 3 && fen.compare(fen.size() - 3, 3, " c9") == 0) {
+        fen.erase(fen.size() - 3);
+    }
+    return !fen.empty();
+}
+
+// A position is quiet if the side to move isn't in check and can't win material with a capture,
+// so the static evaluation is what a search of it would return
+bool is_quiet(Board &board){
+    int side = board.current_player;
+    if (board.in_check(side)) {
+        return false;
+    }
+    MoveList captures;
+    board.generate_moves(side, captures, GEN_CAPTURES, false);
+    for (int i = 0; i < captures.size; i++) {
+        const std::array<int, 4> &move = captures[i];
+        int attacker = CAPTURE_VALUES[std::abs(board.piece_at(move[0], move[1]))];
+        int target = board.piece_at(move[2], move[3]);
+        int victim = CAPTURE_VALUES[target == 0 ? 1 : std::abs(target)];
+        if (victim > attacker || !board.square_attacked(move[2], move[3], -side)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Add the features of a position, false if it isn't used
+bool add_position(Board &board, float result, bool quiet_only, TuningSet &set){
+    if (quiet_only && !is_quiet(board)) {
+        return false;
+    }
+    std::array<std::array<int, 8>, 8> squares = board.get_board();
+    int king_pos[2][2];
+    board.get_king_pos(king_pos);
+    extract_features(squares, board.pieces_alive, king_pos, set.features);
+    set.offsets.push_back(set.features.size());
+    set.results.push_back(result);
+    return true;
+}
+
+// Turn lines into features, positions that can't be used are counted in skipped
+void extract_lines(const std::vector<std::string> &lines, size_t first, size_t last, bool quiet_only, TuningSet &set, size_t &skipped){
+    for (size_t i = first; i < last; i++) {
+        std::string fen;
+        float result;
+        if (!parse_position_line(lines[i], fen, result)) {
+            skipped++;
+            continue;
+        }
+        Board board("");
+        if (!board.parse_fen(fen) || !add_position(board, result, quiet_only, set)) {
+            skipped++;
+        }
+    }
+}
+
+// Same for the positions of a dataset made by pgn_converter
+void extract_packed(const DatasetFile &dataset, size_t first, size_t last, bool quiet_only, TuningSet &set, size_t &skipped){
+    for (size_t i = first; i < last; i++) {
+        Board board(unpack_fen(dataset[i]));
+        if (!add_position(board, (dataset[i].result + 1) / 2.0f, quiet_only, set)) {
+            skipped++;
+        }
+    }
+}
+
+// Extract the positions first up to last with the given function, split over the threads
+template <typename Fn>
+void extract_parallel(size_t count, int threads, Fn extract, TuningSet &set, size_t &skipped){
+    std::vector<TuningSet> parts(threads);
+    std::vector<size_t> part_skipped(threads, 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(extract, count * t / threads, count * (t + 1) / threads, std::ref(parts[t]), std::ref(part_skipped[t]));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+        set.append(parts[t]);
+        skipped += part_skipped[t];
+    }
+}
+
+bool load_positions(const TunerConfig &config, int threads, TuningSet &set){
+    size_t skipped = 0;
+    DatasetFile dataset(config.positions_file);
+    if (dataset.is_open()) {
+        extract_parallel(dataset.size(), threads, [&](size_t first, size_t last, TuningSet &part, size_t &part_skipped) {
+            extract_packed(dataset, first, last, config.quiet_only, part, part_skipped);
+        }, set, skipped);
+    } else {
+        std::ifstream file(config.positions_file);
+        if (!file) {
+            std::cerr << "Could not open " << config.positions_file << std::endl;
+            return false;
+        }
+        // Read in blocks so the text of all positions never has to be in memory at once
+        const size_t BLOCK_LINES = 1 << 20;
+        std::vector<std::string> lines;
+        bool more = true;
+        while (more) {
+            lines.clear();
+            std::string line;
+            while (lines.size() < BLOCK_LINES && (more = (bool)std::getline(file, line))) {
+                if (!line.empty() && line[0] != '#') {
+                    lines.push_back(line);
+                }
+            }
+            extract_parallel(lines.size(), threads, [&](size_t first, size_t last, TuningSet &part, size_t &part_skipped) {
+                extract_lines(lines, first, last, config.quiet_only, part, part_skipped);
+            }, set, skipped);
+        }
+    }
+    std::cout << "Loaded " << set.size() << " positions (" << set.features.size() << " features), skipped " << skipped << std::endl;
+    return set.size() > 0;
+}
+
+// Chance of white winning for a score
+inline double win_chance(double score, double k){
+    return 1.0 / (1.0 + std::pow(10.0, -k * score / 400.0));
+}
+
+// Runs fn(first, last, thread) over the positions split between the threads
+template <typename Fn>
+void parallel_for(size_t count, int threads, Fn fn){
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(fn, count * t / threads, count * (t + 1) / threads, t);
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+// Mean squared error between the results and the win chance of the evaluation.
+// If gradient isn't null it gets the derivative of the error for every parameter
+double tuning_error(const TuningSet &set, const std::vector<double> &params, double k, int threads, std::vector<double> *gradient){
+    std::vector<double> errors(threads, 0.0);
+    std::vector<std::vector<double>> gradients(gradient ? threads : 0, std::vector<double>(NUM_EVAL_PARAMS, 0.0));
+    parallel_for(set.size(), threads, [&](size_t first, size_t last, int t) {
+        double error = 0.0;
+        double *thread_gradient = gradient ? gradients[t].data() : nullptr;
+        for (size_t i = first; i < last; i++) {
+            const EvalFeature *features = &set.features[set.offsets[i]];
+            int count = (int)(set.offsets[i + 1] - set.offsets[i]);
+            double chance = win_chance(linear_eval(features, count, params.data()), k);
+            double difference = set.results[i] - chance;
+            error += difference * difference;
+            if (thread_gradient) {
+                // d(error)/d(score), the coefficients make it per parameter
+                double slope = -2.0 * difference * chance * (1.0 - chance) * std::log(10.0) * k / 400.0;
+                for (int f = 0; f < count; f++) {
+                    thread_gradient[features[f].index] += slope * features[f].coefficient;
+                }
+            }
+        }
+        errors[t] = error;
+    });
+
+    double error = 0.0;
+    for (int t = 0; t < threads; t++) {
+        error += errors[t];
+    }
+    if (gradient) {
+        gradient->assign(NUM_EVAL_PARAMS, 0.0);
+        for (int t = 0; t < threads; t++) {
+            for (int p = 0; p < NUM_EVAL_PARAMS; p++) {
+                (*gradient)[p] += gradients[t][p] / set.size();
+            }
+        }
+    }
+    return error / set.size();
+}
+
+// Find the K with the lowest error for the current parameters, the error is convex in K
+double fit_k(const TuningSet &set, const std::vector<double> &params, int threads){
+    double low = 0.0;
+    double high = 10.0;
+    for (int i = 0; i < 40; i++) {
+        double a = low + (high - low) / 3.0;
+        double b = high - (high - low) / 3.0;
+        if (tuning_error(set, params, a, threads, nullptr) < tuning_error(set, params, b, threads, nullptr)) {
+            high = b;
+        } else {
+            low = a;
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+bool save_params(const TunerConfig &config, const std::string &source, const std::vector<double> &params){
+    std::string text = write_eval_values(source, params);
+    if (text.empty()) {
+        std::cerr << config.eval_file << " doesn't have the layout the tuner expects" << std::endl;
+        return false;
+    }
+    std::ofstream out(config.out_file);
+    out << text;
+    return (bool)out;
+}
+
+// A count given on the command line, only whole numbers above 0 are taken
+bool parse_count(const char *text, int &value){
+    char *end;
+    long number = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || number <= 0 || number > 1000000000) {
+        return false;
+    }
+    value = (int)number;
+    return true;
+}
+
+bool parse_args(int argc, char *argv[], TunerConfig &config){
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-positions" && has_value) {
+            config.positions_file = argv[++i];
+        } else if (arg == "-eval" && has_value) {
+            config.eval_file = argv[++i];
+        } else if (arg == "-out" && has_value) {
+            config.out_file = argv[++i];
+        } else if (arg == "-epochs" && has_value) {
+            if (!parse_count(argv[++i], config.epochs)) {
+                std::cerr << "-epochs needs a number above 0, not " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "-rate" && has_value) {
+            config.rate = std::atof(argv[++i]);
+        } else if (arg == "-k" && has_value) {
+            config.k = std::atof(argv[++i]);
+        } else if (arg == "-threads" && has_value) {
+            if (!parse_count(argv[++i], config.threads)) {
+                std::cerr << "-threads needs a number above 0, not " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "-save" && has_value) {
+            if (!parse_count(argv[++i], config.save_every)) {
+                std::cerr << "-save needs a number above 0, not " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "-all") {
+            config.quiet_only = false;
+        } else {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+    }
+    if (config.positions_file.empty()) {
+        std::cerr << "Usage: texel_tuner -positions FILE [options], see tuner/texel_tuner.cpp" << std::endl;
+        return false;
+    }
+    if (config.out_file.empty()) {
+        config.out_file = config.eval_file;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    TunerConfig config;
+    if (!parse_args(argc, argv, config)) {
+        return 1;
+    }
+    int threads = config.threads > 0 ? config.threads : std::max(1, (int)std::thread::hardware_concurrency());
+
+    // Check the eval file can be written before spending time on the positions
+    std::ifstream eval_file(config.eval_file);
+    std::stringstream source;
+    source << eval_file.rdbuf();
+    std::vector<double> params = current_eval_params();
+    if (write_eval_values(source.str(), params).empty()) {
+        std::cerr << config.eval_file << " doesn't have the layout the tuner expects" << std::endl;
+        return 1;
+    }
+
+    TuningSet set;
+    if (!load_positions(config, threads, set)) {
+        return 1;
+    }
+    double k = config.k > 0.0 ? config.k : fit_k(set, params, threads);
+    std::cout << "K = " << k << ", starting error " << tuning_error(set, params, k, threads, nullptr) << std::endl;
+
+    // Adam, the king value is only there to make the king worth more than everything else
+    const double BETA1 = 0.9;
+    const double BETA2 = 0.999;
+    std::vector<double> moment(NUM_EVAL_PARAMS, 0.0);
+    std::vector<double> velocity(NUM_EVAL_PARAMS, 0.0);
+    std::vector<double> gradient;
+    for (int epoch = 1; epoch <= config.epochs; epoch++) {
+        auto start = std::chrono::steady_clock::now();
+        double error = tuning_error(set, params, k, threads, &gradient);
+        for (int p = 0; p < NUM_EVAL_PARAMS; p++) {
+            if (p == PARAM_PIECE_VALUE + 4) {
+                continue;
+            }
+            moment[p] = BETA1 * moment[p] + (1.0 - BETA1) * gradient[p];
+            velocity[p] = BETA2 * velocity[p] + (1.0 - BETA2) * gradient[p] * gradient[p];
+            double moment_hat = moment[p] / (1.0 - std::pow(BETA1, epoch));
+            double velocity_hat = velocity[p] / (1.0 - std::pow(BETA2, epoch));
+            params[p] -= config.rate * moment_hat / (std::sqrt(velocity_hat) + 1e-8);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Epoch " << epoch << " error " << error << " (" << seconds << " s)" << std::endl;
+
+        if (epoch % config.save_every == 0 || epoch == config.epochs) {
+            if (!save_params(config, source.str(), params)) {
+                return 1;
+            }
+            std::cout << "Wrote " << config.out_file << std::endl;
+        }
+    }
+    return 0;
+}
@@ -1,11 +1,77 @@
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 #include "board_representation.h"
+#include "move_picker.h"
 
 void test_fen_parsing() {
     Board board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
     std::string fen = board.board_to_fen(1);
     assert(fen == "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    // Written back exactly as it was read
+    const char *round_trip[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w Kq - 0 1",
+        "rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 3",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 99 123456"
+    };
+    char buffer[MAX_FEN_LENGTH];
+    for (const char *text : round_trip) {
+        assert(board.parse_fen(text));
+        assert(board.write_fen(buffer, board.current_player) == (int)std::string(text).size());
+        assert(std::string(buffer) == text);
+        assert(board.get_hash(1) == Board(text).get_hash(1)); // Nothing left over from the last position
+    }
+
+    // Counters may be left out, whitespace around the FEN is ignored
+    assert(board.parse_fen(" 4k3/8/8/8/8/8/8/4K3 b - -\r\n"));
+    assert(board.board_to_fen(board.current_player) == "4k3/8/8/8/8/8/8/4K3 b - - 0 1");
+
+    // Castling rights without their king and rook on the home squares are dropped
+    assert(board.parse_fen("4k3/8/8/8/8/8/8/4K3 w K - 0 1"));
+    assert(board.board_to_fen(board.current_player) == "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+    std::vector<std::array<int, 4>> king_moves = board.get_allmoves(1);
+    assert(std::find(king_moves.begin(), king_moves.end(), std::array<int, 4>{7, 4, 7, 6}) == king_moves.end());
+    assert(board.parse_fen("r3k2r/8/8/8/8/8/8/1R2K2R w KQkq - 0 1"));
+    assert(board.board_to_fen(board.current_player) == "r3k2r/8/8/8/8/8/8/1R2K2R w Kkq - 0 1");
+    assert(board.parse_fen("r3k2r/8/8/8/8/8/8/R4K1R w KQkq - 0 1"));
+    assert(board.board_to_fen(board.current_player) == "r3k2r/8/8/8/8/8/8/R4K1R w kq - 0 1");
+
+    // A rejected FEN leaves the board alone
+    const char *invalid[] = {
+        "",
+        "4k3/8/8/8/8/8/8/4K3",
+        "4k3/8/8/8/8/8/8/4K3 x - - 0 1",
+        "4k3/8/8/8/8/8/8 w - - 0 1",                 // Seven ranks
+        "4k3/8/8/8/8/8/8/4K3/8 w - - 0 1",           // Nine ranks
+        "4k4/8/8/8/8/8/8/4K3 w - - 0 1",             // Nine files
+        "4k2/8/8/8/8/8/8/4K3 w - - 0 1",             // Seven files
+        "4k21/8/8/8/8/8/8/4K3 w - - 0 1",            // Two digits in a row
+        "4k3/8/8/8/8/8/8/4X3 w - - 0 1",
+        "4k3/8/8/8/8/8/8/8 w - - 0 1",               // No white king
+        "4k3/8/8/8/8/8/8/3KK3 w - - 0 1",            // Two white kings
+        "P3k3/8/8/8/8/8/8/4K3 w - - 0 1",            // Pawn on the last rank
+        "4k3/8/8/8/8/8/8/4K3 w QK - 0 1",            // Castling letters out of order
+        "4k3/8/8/8/8/8/8/4K3 w KK - 0 1",
+        "4k3/8/8/8/8/8/8/4K3 w - e3 0 1",            // En passant on the wrong rank
+        "4k3/8/8/8/8/8/8/4K3 w - i6 0 1",
+        "4k3/8/8/8/8/8/8/4K3 w - e6 0 1",            // No pawn that just moved past e6
+        "4k3/8/8/8/4p3/8/8/4K3 b - e3 0 1",
+        "4k3/8/8/4P3/8/8/8/4K3 w - e6 0 1",          // The pawn in front is the mover's own
+        "4k3/8/8/8/8/8/8/4K3 w - - 0",               // Only one counter
+        "4k3/8/8/8/8/8/8/4K3 w - - 0 0",             // Move numbers start at 1
+        "4k3/8/8/8/8/8/8/4K3 w - - -1 1",
+        "4k3/8/8/8/8/8/8/4K3 w - - 0 1x",
+        "4k3/8/8/8/8/8/8/4K3 w - - 0 1234567",
+        "4k3/8/8/8/8/8/8/4K3 w - - 0 1 extra",
+        "4k3/8/8/8/8/8/8/4K3  w - - 0 1"
+    };
+    board.parse_fen(round_trip[1]);
+    for (const char *text : invalid) {
+        assert(!board.parse_fen(text));
+        assert(board.board_to_fen(board.current_player) == round_trip[1]);
+    }
     std::cout << "FEN Parsing Test Passed!\n";
 }
 
@@ -22,6 +88,18 @@ void test_undo_move() {
     board.undo_move();
     std::string fen = board.board_to_fen(1);
     assert(fen == "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    // The whole history can be used and undone again
+    for (int i = 0; i < MAX_HISTORY / 4; i++) {
+        board.move_piece(7, 6, 5, 5);
+        board.move_piece(0, 6, 2, 5);
+        board.move_piece(5, 5, 7, 6);
+        board.move_piece(2, 5, 0, 6);
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        board.undo_move();
+    }
+    assert(board.board_to_fen(1) == fen);
     std::cout << "Undo Move Test Passed!\n";
 }
 
@@ -61,11 +139,128 @@ void test_pieces_alive(){
     std::cout << "Pieces Alive Test Passed!\n";
 }
 
+void test_move_picker() {
+    // The picker has to hand out every legal move once, whatever the hash move and killers are
+    std::string fens[3] = {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                           "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 1",
+                           "4k3/8/8/8/8/8/4r3/R3K3 w Q - 0 1"};
+    for (const std::string &fen : fens) {
+        Board board(fen);
+        std::vector<std::array<int, 4>> expected = board.get_allmoves(1);
+        std::array<std::array<int, 4>, 2> killers = {expected.back(), std::array<int, 4>{0, 0, 1, 1}};
+        MoveList list;
+        MovePicker picker(&board, 1, list, expected[expected.size() / 2], killers);
+        std::vector<std::array<int, 4>> picked;
+        std::array<int, 4> move;
+        while (picker.next(move)) {
+            board.move_piece(move[0], move[1], move[2], move[3]);
+            if (!board.in_check(1)) {
+                picked.push_back(move);
+            }
+            board.undo_move();
+        }
+        assert(board.board_to_fen(1) == fen);
+        assert(picked[0] == expected[expected.size() / 2]);
+        std::sort(expected.begin(), expected.end());
+        std::sort(picked.begin(), picked.end());
+        assert(picked == expected);
+    }
+    std::cout << "Move Picker Test Passed!\n";
+}
+
+void test_repetition() {
+    Board board("4k3/8/8/8/8/8/8/4K1N1 w - - 12 40");
+    assert(board.board_to_fen(1) == "4k3/8/8/8/8/8/8/4K1N1 w - - 12 40");
+    // Knight and king out and back again
+    board.move_piece(7, 6, 5, 5);
+    board.move_piece(0, 4, 0, 3);
+    assert(!board.is_repetition());
+    board.move_piece(5, 5, 7, 6);
+    board.move_piece(0, 3, 0, 4);
+    assert(board.is_repetition());
+    assert(board.get_halfmove_clock() == 16);
+    assert(board.board_to_fen(1) == "4k3/8/8/8/8/8/8/4K1N1 w - - 16 42");
+    // A pawn move can't be repeated past
+    Board pawns("4k3/4p3/8/8/8/8/4P3/4K3 w - - 0 1");
+    pawns.move_piece(6, 4, 5, 4);
+    assert(pawns.get_halfmove_clock() == 0);
+    pawns.undo_move();
+    assert(pawns.board_to_fen(1) == "4k3/4p3/8/8/8/8/4P3/4K3 w - - 0 1");
+    std::cout << "Repetition Test Passed!\n";
+}
+
+void test_promotion() {
+    Board board("8/4P1k1/8/8/8/8/8/4K3 w - - 0 1");
+    uint64_t hash = board.get_hash(1);
+    board.move_piece(1, 4, 0, 4);
+    assert(board.piece_at(0, 4) == 6);
+    assert(board.board_to_fen(-1) == "4Q3/6k1/8/8/8/8/8/4K3 b - - 0 1");
+    board.undo_move();
+    assert(board.piece_at(1, 4) == 1);
+    assert(board.get_hash(1) == hash);
+    std::cout << "Promotion Test Passed!\n";
+}
+
+// Count the leaf nodes of the legal move tree
+uint64_t perft(Board &board, int side, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    MoveList moves;
+    board.generate_moves(side, moves);
+    uint64_t nodes = 0;
+    for (const std::array<int, 4> &move : moves) {
+        board.move_piece(move[0], move[1], move[2], move[3]);
+        nodes += perft(board, -side, depth - 1);
+        board.undo_move();
+    }
+    return nodes;
+}
+
+void test_perft() {
+    // Well known positions with castling, en passant and pins, before any promotions
+    Board kiwipete("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    assert(perft(kiwipete, 1, 3) == 97862);
+    Board endgame("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    assert(perft(endgame, 1, 4) == 43238);
+    std::cout << "Perft Test Passed!\n";
+}
+
+void test_attack_tables() {
+    // Knight on a1 and king on h8 only reach into the board
+    assert(KNIGHT_ATTACKS[square_of(7, 0)].mask == (square_bit(5, 1) | square_bit(6, 2)));
+    assert(KING_ATTACKS[square_of(0, 7)].mask == (square_bit(0, 6) | square_bit(1, 6) | square_bit(1, 7)));
+    assert(PAWN_ATTACKS[0][square_of(6, 4)].mask == (square_bit(5, 3) | square_bit(5, 5)));
+    assert(PAWN_ATTACKS[1][square_of(1, 0)].mask == square_bit(2, 1));
+
+    // e5 is attacked by the d4 pawn, the c6 knight, the e1 rook and the h2 bishop, and only by
+    // the f6 king for black. The e8 rook and the king both defend the e6 pawn
+    Board board("4r3/8/2N1pk2/4P3/3P4/8/7B/4R1K1 b - - 0 1");
+    uint64_t white = square_bit(4, 3) | square_bit(2, 2) | square_bit(7, 4) | square_bit(6, 7);
+    assert(board.attackers_to(3, 4, 1) == white);
+    assert(board.attackers_to(3, 4, -1) == square_bit(2, 5));
+    assert(board.attackers_to(2, 4, -1) == (square_bit(2, 5) | square_bit(0, 4)));
+    // Both queries agree everywhere
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            for (int side : {1, -1}) {
+                assert(board.square_attacked(row, col, side) == (board.attackers_to(row, col, side) != 0));
+            }
+        }
+    }
+    std::cout << "Attack Tables Test Passed!\n";
+}
+
 int main() {
     test_pieces_alive();
     test_fen_parsing();
     test_move_generation();
     test_undo_move();
+    test_move_picker();
+    test_repetition();
+    test_promotion();
+    test_perft();
+    test_attack_tables();
     std::cout << "All Board Representation Tests Passed!\n";
     return 0;
 }
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include "board_representation.h"
+#include "bench.h"
+#include "eval_params.h"
+
+// The linear form has to give the same score as the real evaluation
+void check_position(Board &board) {
+    std::array<std::array<int, 8>, 8> squares = board.get_board();
+    int king_pos[2][2] = {{-1, -1}, {-1, -1}};
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (std::abs(squares[row][col]) == 5) {
+                king_pos[squares[row][col] > 0 ? 0 : 1][0] = row;
+                king_pos[squares[row][col] > 0 ? 0 : 1][1] = col;
+            }
+        }
+    }
+    std::vector<EvalFeature> features;
+    extract_features(squares, board.pieces_alive, king_pos, features);
+    std::vector<double> params = current_eval_params();
+    double score = linear_eval(features.data(), (int)features.size(), params.data());
+    assert(std::lround(score) == board.get_board_value());
+}
+
+void test_linear_eval() {
+    srand(1);
+    for (const std::string &fen : BENCH_POSITIONS) {
+        Board board(fen);
+        check_position(board);
+        // Play random moves from it, down to the endgame tables
+        int side = board.current_player;
+        for (int ply = 0; ply < 60; ply++) {
+            std::vector<std::array<int, 4>> moves = board.get_allmoves(side);
+            if (moves.empty()) {
+                break;
+            }
+            std::array<int, 4> move = moves[rand() % moves.size()];
+            board.move_piece(move[0], move[1], move[2], move[3]);
+            side = -side;
+            check_position(board);
+        }
+    }
+    std::cout << "Linear Eval Test Passed!\n";
+}
+
+void test_write_eval_values() {
+    // A file with the layout of eval_values.h, everything set to 0
+    std::string source = "// Piece values\nconst std::unordered_map<int, int> piece_value = {\n";
+    for (int piece = 1; piece <= 6; piece++) {
+        source += "    {" + std::to_string(piece) + ", 0},  // Comment\n    {-" + std::to_string(piece) + ", 0},\n";
+    }
+    source += "};\n\n";
+    std::vector<double> zeros(64, 0.0);
+    for (const char *phase : {"mg_", "eg_"}) {
+        for (const char *piece : TABLE_PIECE_NAMES) {
+            source += format_table(std::string(phase) + piece + "_table", zeros.data()) + "\n\n";
+        }
+    }
+    for (const char *name : CONSTANT_NAMES) {
+        source += "const int " + std::string(name) + " = 0;\n";
+    }
+
+    std::string written = write_eval_values(source, current_eval_params());
+    assert(written.find("{2, 50},  // Comment") != std::string::npos);
+    assert(written.find("{-2, -50},") != std::string::npos);
+    assert(written.find("{{0, 0, 0, 0, 0, 0, 0, 0}},\n        {{98, 134, 61, 95, 68, 126, 34, -11}},") != std::string::npos);
+    assert(written.find("const int PASSED_PAWN_BONUS = 30;") != std::string::npos);
+    // Writing the same values again changes nothing
+    assert(write_eval_values(written, current_eval_params()) == written);
+    // A file without the tables can't be written
+    assert(write_eval_values("const int PASSED_PAWN_BONUS = 0;\n", current_eval_params()).empty());
+    std::cout << "Write Eval Values Test Passed!\n";
+}
+
+void test_attack_maps() {
+    // The e3 knight attacks the queen, which nothing defends
+    Board board("4k3/8/8/3q4/8/4N3/8/4K3 w - - 0 1");
+    AttackMaps maps;
+    compute_attack_maps(board.get_board(), maps);
+    assert(maps.side[0].by_piece[3] == KNIGHT_ATTACKS[square_of(5, 4)].mask);
+    assert(maps.side[1].by_piece[6] & square_bit(7, 3)); // Down the d file to d1
+    assert(!(maps.side[1].by_piece[6] & square_bit(7, 4)));
+    assert(maps.side[0].twice == (maps.side[0].by_piece[3] & maps.side[0].by_piece[5]));
+
+    ThreatCounts black = count_threats(maps, -1);
+    assert(black.hanging == 1 && black.by_minor == 1 && black.by_pawn == 0);
+    ThreatCounts white = count_threats(maps, 1);
+    assert(white.mobility[0] == 8 && white.hanging == 0);
+
+    // The queen sees d1 and d2 next to the white king
+    KingSafetyCounts king = count_king_safety(maps, 7, 4, 1);
+    assert(king.straight == 2 && king.diagonal == 0 && king.knight == 0 && king.shield == 0);
+    std::cout << "Attack Maps Test Passed!\n";
+}
+
+int main() {
+    test_attack_maps();
+    test_linear_eval();
+    test_write_eval_values();
+    std::cout << "All Eval Params Tests Passed!\n";
+    return 0;
+}
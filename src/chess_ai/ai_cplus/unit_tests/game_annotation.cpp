@@ -0,0 +1,65 @@
+#include <iostream>
+#include <cassert>
+#include <string>
+#include "board_representation.h"
+#include "game_annotation.h"
+
+void test_scholars_mate() {
+    PgnGame game;
+    assert(game_from_pgn_text("1. e4 e5 2. Qh5 Nc6 3. Bc4 Nf6?? 4. Qxf7# 1-0", game));
+    assert(game.moves.size() == 7 && game.result == 1);
+
+    SearchState state;
+    state.print_progress = false;
+    Board board(game.fen);
+    GameAnnotation annotation = annotate_game(board, 1, game.moves, 3, state);
+    assert(annotation.complete && !annotation.truncated);
+    assert(annotation.plies.size() == 7);
+    assert(board.board_to_fen(1) == START_FEN); // Walked all the way back
+    assert(state.print_progress == false && state.multi_pv == 1);
+
+    // Nf6 allows the mate, the mate itself is the best move
+    const AnnotatedPly &nf6 = annotation.plies[5];
+    assert(nf6.side == -1 && nf6.san == "Nf6");
+    assert(nf6.move == (std::array<int, 4>{0, 6, 2, 5}));
+    assert(nf6.best_move != nf6.move);
+    assert(nf6.score == MATE_SCORE - 1);
+    assert(nf6.flag == ANNOTATION_BLUNDER);
+    const AnnotatedPly &mate = annotation.plies[6];
+    assert(mate.best_move == mate.move && mate.loss == 0 && mate.flag == ANNOTATION_NONE);
+    assert(mate.best_score == MATE_SCORE - 1);
+    assert(annotation.final_score == MATE_SCORE);
+
+    // Searching every position from an empty table finds the same, with more work
+    SearchState cold_state;
+    cold_state.print_progress = false;
+    GameAnnotation cold = annotate_game(board, 1, game.moves, 3, cold_state, false);
+    assert(cold.plies[5].flag == ANNOTATION_BLUNDER && cold.plies[6].flag == ANNOTATION_NONE);
+    assert(annotation.nodes < cold.nodes);
+    std::cout << "Scholars Mate Test Passed!\n";
+}
+
+void test_missed_mate() {
+    PgnGame game;
+    assert(game_from_pgn_text("[FEN \"6k1/5ppp/8/8/8/8/5PPP/1R4K1 w - - 0 1\"]\n1. Kf1 Kf8 2. Zz4 *", game));
+    SearchState state;
+    state.print_progress = false;
+    Board board(game.fen);
+    GameAnnotation annotation = annotate_game(board, 1, game.moves, 2, state);
+
+    // The annotation stops at the move that can't be read
+    assert(!annotation.complete && annotation.plies.size() == 2);
+    const AnnotatedPly &king = annotation.plies[0];
+    assert(king.best_move == (std::array<int, 4>{7, 1, 0, 1}));
+    assert(king.best_score == MATE_SCORE - 1);
+    assert(king.loss >= BLUNDER_LOSS && king.flag == ANNOTATION_BLUNDER);
+    assert(flag_for_loss(MISTAKE_LOSS) == ANNOTATION_MISTAKE && flag_for_loss(INACCURACY_LOSS - 1) == ANNOTATION_NONE);
+    std::cout << "Missed Mate Test Passed!\n";
+}
+
+int main() {
+    test_scholars_mate();
+    test_missed_mate();
+    std::cout << "All Game Annotation Tests Passed!\n";
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <cassert>
+#include <string>
+#include "board_representation.h"
+#include "mate_search.h"
+
+// Play the line out and check it ends with the defender mated, and the board is left alone
+bool line_mates(Board &board, int side, const MateResult &result) {
+    std::string fen = board.board_to_fen(side);
+    int to_move = side;
+    for (const std::array<int, 4> &move : result.line) {
+        board.move_piece(move[0], move[1], move[2], move[3]);
+        to_move = -to_move;
+    }
+    MoveList replies;
+    board.generate_moves(to_move, replies);
+    bool mated = to_move == -side && replies.empty() && board.in_check(to_move);
+    for (size_t i = 0; i < result.line.size(); i++) {
+        board.undo_move();
+    }
+    return mated && board.board_to_fen(side) == fen;
+}
+
+void test_short_mates() {
+    MateSearch solver(1 << 16);
+
+    // Back rank mate in one
+    Board board("6k1/5ppp/8/8/8/8/5PPP/1R4K1 w - - 0 1");
+    MateResult result = solver.solve(board, 1, 3);
+    assert(result.found && !result.aborted);
+    assert(result.moves == 1 && result.line.size() == 1);
+    assert(result.line[0] == (std::array<int, 4>{7, 1, 0, 1}));
+    assert(line_mates(board, 1, result));
+
+    // Nf6+ gxf6 Bxf7#, whatever black answers
+    solver.clear();
+    board = Board("r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1");
+    result = solver.solve(board, 1, 3);
+    assert(result.found && result.moves == 2 && result.line.size() == 3);
+    assert(result.line[0] == (std::array<int, 4>{3, 3, 2, 5}));
+    assert(line_mates(board, 1, result));
+
+    // Black mating works the same
+    solver.clear();
+    board = Board("2r3k1/p4p2/3Rp2p/1p2P1pK/8/1P4P1/P3Q2P/1q6 b - - 0 1");
+    result = solver.solve(board, -1, 3);
+    assert(result.found && result.moves == 3 && result.line.size() == 5);
+    assert(line_mates(board, -1, result));
+    std::cout << "Short Mates Test Passed!\n";
+}
+
+void test_no_mate() {
+    MateSearch solver(1 << 16);
+
+    // The only moves stalemate, that isn't a mate
+    Board board("k7/2Q5/1K6/8/8/8/8/8 b - - 0 1");
+    MateResult result = solver.solve(board, -1, 3);
+    assert(!result.found && !result.aborted && result.line.empty());
+
+    // Queen against king is a mate in five, not in four
+    board = Board("k7/8/8/1Q6/8/8/K7/8 w - - 4 3");
+    result = solver.solve(board, 1, 4);
+    assert(!result.found && !result.aborted);
+
+    // Not enough nodes to tell
+    solver.clear();
+    result = solver.solve(board, 1, 5, 100);
+    assert(!result.found && result.aborted && result.nodes <= 101);
+    std::cout << "No Mate Test Passed!\n";
+}
+
+void test_long_mate() {
+    MateSearch solver;
+    Board board("k7/8/8/1Q6/8/8/K7/8 w - - 4 3");
+    MateResult result = solver.solve(board, 1);
+    assert(result.found && result.moves == 5 && result.line.size() == 9);
+    assert(line_mates(board, 1, result));
+
+    // A much smaller table still gets there, entries pushed out are solved again
+    MateSearch small(1 << 10);
+    result = small.solve(board, 1, 5);
+    assert(result.found && result.moves == 5 && line_mates(board, 1, result));
+
+    assert(MateSearch::entries_within(sizeof(MateEntry) - 1) == 0);
+    assert(MateSearch::entries_within(3 * sizeof(MateEntry)) == 2);
+    std::cout << "Long Mate Test Passed!\n";
+}
+
+int main() {
+    test_short_mates();
+    test_no_mate();
+    test_long_mate();
+    std::cout << "All Mate Search Tests Passed!\n";
+    return 0;
+}
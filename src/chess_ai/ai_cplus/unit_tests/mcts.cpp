@@ -0,0 +1,122 @@
+#include <iostream>
+#include <cassert>
+#include <array>
+#include "board_representation.h"
+#include "search_thread.h"
+#include "mcts.h"
+
+void ignore_result(Board &, const MiniMaxResult &) {
+}
+
+// After a search every virtual loss is gone, a node has at least the visits of its children
+void check_visits(const MctsSearch &mcts, uint32_t index) {
+    const MctsNode &node = mcts.node(index);
+    assert(node.visits >= 0);
+    if (node.expansion != MCTS_EXPANDED) {
+        return;
+    }
+    int children = 0;
+    for (uint32_t i = node.first_child; i < node.first_child + node.child_count; i++) {
+        children += mcts.node(i).visits;
+        check_visits(mcts, i);
+    }
+    assert(children <= node.visits);
+}
+
+void test_best_moves() {
+    MctsSearch mcts(1 << 16);
+    SearchState state;
+    state.print_progress = false;
+
+    // Back rank mate
+    Board board("6k1/5ppp/8/8/8/8/5PPP/1R4K1 w - - 0 1");
+    MiniMaxResult result = mcts.search(board, 3, true, state);
+    assert(result.move == (std::array<int, 4>{7, 1, 0, 1}));
+    assert(result.score == MATE_SCORE - 1);
+
+    // A queen for free, black mates the other way round
+    board = Board("4k3/8/8/3q4/8/8/3R4/4K3 w - - 0 1");
+    result = mcts.search(board, 3, true, state);
+    assert(result.move == (std::array<int, 4>{6, 3, 3, 3}));
+    assert(result.score > 0);
+    board = Board("1r4k1/8/8/8/8/8/5PPP/6K1 b - - 0 1");
+    result = mcts.search(board, 3, false, state);
+    assert(result.move == (std::array<int, 4>{0, 1, 7, 1}));
+    assert(result.score == -(MATE_SCORE - 1));
+    std::cout << "Best Moves Test Passed!\n";
+}
+
+void test_threads() {
+    MctsSearch mcts(1 << 18);
+    mcts.config.threads = 4;
+    SearchState state;
+    state.print_progress = false;
+    Board board("r1b1kb1r/3npppp/p1p5/2N3B1/4P1n1/8/PPP2PPP/R3K1NR w KQkq - 0 1");
+    std::string fen = board.board_to_fen(1);
+    MiniMaxResult result = mcts.search(board, 4, true, state);
+    assert(result.move[0] != -1);
+    assert(board.board_to_fen(1) == fen);
+
+    // Every iteration went through the root and one of its moves
+    uint64_t iterations = mcts.last_iterations();
+    assert(iterations == MctsSearch::iterations_for_depth(4));
+    assert(state.stats.nodes.get() == iterations);
+    const MctsNode &root = mcts.node(0);
+    assert(root.visits == (int)iterations);
+    int children = 0;
+    for (uint32_t i = root.first_child; i < root.first_child + root.child_count; i++) {
+        children += mcts.node(i).visits;
+    }
+    assert(children == (int)iterations);
+    check_visits(mcts, 0);
+
+    // Playouts end on the position they started from too
+    mcts.config.playout_plies = 6;
+    result = mcts.search(board, 2, true, state);
+    assert(result.move[0] != -1 && board.board_to_fen(1) == fen);
+    check_visits(mcts, 0);
+    std::cout << "Threads Test Passed!\n";
+}
+
+void test_limits() {
+    SearchState state;
+    state.print_progress = false;
+    Board board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    // A full pool stops the tree growing, the search still ends with a move
+    MctsSearch small(500);
+    MiniMaxResult result = small.search(board, 4, true, state);
+    assert(result.move[0] != -1);
+    assert(small.tree_size() <= 500);
+    assert(small.last_iterations() == MctsSearch::iterations_for_depth(4));
+
+    // Stopped before it started, it still looks at every root move once
+    MctsSearch mcts(1 << 16);
+    state.stop = true;
+    result = mcts.search(board, 64, true, state);
+    state.stop = false;
+    assert(result.move[0] != -1);
+    assert(mcts.last_iterations() == MCTS_MIN_ITERATIONS);
+
+    // The tree is only kept while MCTS is the engine, and has to fit under the memory limit
+    SearchThread thread(state, ignore_result);
+    assert(thread.mcts_search().capacity() == 0);
+    size_t fixed = fixed_memory_usage(state, thread) + state.hash_table.memory_usage();
+    assert(set_memory_limit(state, thread, fixed + 1000));
+    assert(!set_search_engine(state, thread, ENGINE_MCTS));
+    assert(thread.get_engine() == ENGINE_MINIMAX);
+    assert(set_memory_limit(state, thread, 0));
+    assert(set_search_engine(state, thread, ENGINE_MCTS));
+    assert(thread.mcts_search().capacity() == DEFAULT_MCTS_NODES);
+    assert(set_search_engine(state, thread, ENGINE_MINIMAX));
+    assert(thread.mcts_search().capacity() == 0);
+    std::cout << "Limits Test Passed!\n";
+}
+
+int main() {
+    test_best_moves();
+    test_threads();
+    test_limits();
+    std::cout << "All MCTS Tests Passed!\n";
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Allocations are only counted with the flag
+#ifndef MEMORY_AUDIT
+#define MEMORY_AUDIT
+#endif
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+#include "board_representation.h"
+#include "search_thread.h"
+#include "memory_audit.h"
+
+void ignore_result(Board &, const MiniMaxResult &) {
+}
+
+void test_phase_counts() {
+    MemoryAudit &audit = memory_audit();
+    uint64_t allocations = audit.phases[MEMORY_SETUP].allocations;
+    uint64_t bytes = audit.phases[MEMORY_SETUP].bytes_allocated;
+    int64_t live = audit.live_bytes;
+    {
+        MemoryPhaseScope phase(MEMORY_SETUP);
+        std::vector<char> *block = new std::vector<char>(1000);
+        assert(audit.phases[MEMORY_SETUP].allocations == allocations + 2);
+        assert(audit.phases[MEMORY_SETUP].bytes_allocated == bytes + 1000 + sizeof(std::vector<char>));
+        assert(audit.live_bytes == live + 1000 + (int64_t)sizeof(std::vector<char>));
+        assert(audit.peak_bytes >= audit.live_bytes);
+        delete block;
+    }
+    assert(audit.live_bytes == live);
+    assert(memory_phase() == MEMORY_STARTUP);
+
+    // The search allocates nothing once it is set up
+    SearchState state;
+    state.print_progress = false;
+    Board board("r1b1kb1r/3npppp/p1p5/2N3B1/4P1n1/8/PPP2PPP/R3K1NR w KQkq - 0 1");
+    state.max_depth = 4;
+    iterative_minimax(&board, true, state);
+    allocations = audit.phases[MEMORY_SEARCH].allocations;
+    {
+        MemoryPhaseScope phase(MEMORY_SEARCH);
+        state.max_depth = 5;
+        iterative_minimax(&board, true, state);
+    }
+    assert(audit.phases[MEMORY_SEARCH].allocations == allocations);
+    std::cout << "Phase Counts Test Passed!\n";
+}
+
+void test_memory_limit() {
+    SearchState state;
+    SearchThread thread(state, ignore_result);
+    size_t fixed = fixed_memory_usage(state, thread);
+    assert(state.hash_table.capacity() == DEFAULT_HASH_ENTRIES);
+
+    // Everything together stays under the limit, the hash table gets what is left
+    size_t limit = 4 * 1024 * 1024;
+    assert(set_memory_limit(state, thread, limit));
+    assert(state.hash_table.memory_usage() + fixed <= limit);
+    assert(state.hash_table.capacity() * 2 * sizeof(HashSlot) + fixed > limit);
+
+    // A saved table bigger than the limit is left alone
+    SearchState big;
+    assert(big.hash_table.save("memory_test.bin"));
+    assert(!state.hash_table.load("memory_test.bin", hash_entries_allowed(state, thread)));
+    assert(set_memory_limit(state, thread, 0));
+    assert(state.hash_table.load("memory_test.bin", hash_entries_allowed(state, thread)));
+    assert(state.hash_table.capacity() == DEFAULT_HASH_ENTRIES);
+    std::remove("memory_test.bin");
+
+    // No room for even a small table
+    assert(!set_memory_limit(state, thread, fixed));
+    assert(state.memory_limit == 0);
+    std::cout << "Memory Limit Test Passed!\n";
+}
+
+int main() {
+    test_phase_counts();
+    test_memory_limit();
+    std::cout << "All Memory Audit Tests Passed!\n";
+    return 0;
+}
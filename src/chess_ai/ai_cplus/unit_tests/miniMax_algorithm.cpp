@@ -2,6 +2,7 @@
 #include <cassert>
 #include "search_algorithm.h"
 #include "board_representation.h"
+#include "search_thread.h"
 
 void test_minimax_correctness() {
     Board board("rnbqkb1r/pppppppp/5n2/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 0 1");
@@ -44,7 +45,225 @@ void test_minimax_time() {
     assert(std::chrono::duration_cast<std::chrono::seconds>(duration).count() < 30); // MiniMax should take less than 30 seconds
 }
 
+void test_ponder_hit() {
+    SearchState state;
+    std::atomic<int> reports{0};
+    std::atomic<int> reported_depth{0};
+    SearchThread search_thread(state, [&](Board &, const MiniMaxResult &) {
+        reported_depth = state.completed_depth.load();
+        reports++;
+    });
+    Board board("rnbqkb1r/pppppppp/5n2/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 0 1");
+    search_thread.set_ponder(true);
+    search_thread.go(board, 4, true);
+    while (!search_thread.is_pondering()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(reports == 1);
+
+    // Pretend the opponent played the predicted reply, the ponder search carries on
+    Board pondered(search_thread.ponder_fen());
+    assert(!state.print_progress);
+    assert(search_thread.go(pondered, 4, true));
+    assert(state.print_progress); // The real search reports from the hit on
+    while (reports < 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(reported_depth >= 4);
+
+    // Anything else is a miss
+    search_thread.set_ponder(false);
+    assert(!search_thread.go(board, 2, true));
+    search_thread.wait();
+    assert(reports == 3);
+    std::cout << "Ponder Hit Test Passed!\n";
+}
+
+void test_stop() {
+    SearchState state;
+    MiniMaxResult reported = {0, {-1, -1, -1, -1}};
+    SearchThread search_thread(state, [&reported](Board &, const MiniMaxResult &result) { reported = result; });
+    Board board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    search_thread.go(board, 64, true);
+    while (state.completed_depth < 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // A stopped search still reports a real move
+    search_thread.stop();
+    search_thread.wait();
+    assert(reported.move[0] != -1);
+    std::cout << "Stop Test Passed!\n";
+}
+
+void test_draws() {
+    // White is a queen up, but every move runs out the fifty move clock
+    Board board("4k3/8/8/8/8/8/8/K6Q w - - 99 80");
+    SearchState state;
+    state.print_progress = false;
+    MiniMaxResult result = start_minimax(3, &board, true, state);
+    assert(result.score == DRAW_SCORE);
+    assert(result.move[0] != -1);
+    std::cout << "Draw Test Passed!\n";
+}
+
+void test_mate() {
+    SearchState state;
+    state.print_progress = false;
+    // Back rank mate in one
+    Board mate_in_one("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+    MiniMaxResult result = start_minimax(4, &mate_in_one, true, state);
+    assert(result.score == MATE_SCORE - 1);
+    assert((result.move == std::array<int, 4>{7, 0, 0, 0}));
+    assert(score_to_string(result.score) == "mate 1");
+    // Black mates the same way
+    Board mated("r5k1/8/8/8/8/8/5PPP/6K1 b - - 0 1");
+    result = start_minimax(4, &mated, false, state);
+    assert(result.score == -(MATE_SCORE - 1));
+    assert(score_to_string(result.score) == "mate -1");
+    // Black has no moves but isn't in check
+    Board stalemate("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+    result = start_minimax(3, &stalemate, false, state);
+    assert(result.score == DRAW_SCORE);
+    // Mate in two, the check extension lets a two ply search see all three moves and the mate
+    Board forced("r5k1/5ppp/8/8/8/8/4RPPP/4R1K1 w - - 0 1");
+    result = start_minimax(2, &forced, true, state);
+    assert(result.score == MATE_SCORE - 3);
+    assert((result.move == std::array<int, 4>{6, 4, 0, 4}));
+    std::cout << "Mate Test Passed!\n";
+}
+
+void test_multi_pv() {
+    Board board("r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N2N2/PP2BPPP/R2QKB1R w KQ - 0 1");
+    SearchState single;
+    single.print_progress = false;
+    MiniMaxResult best = start_minimax(3, &board, true, single);
+    assert(single.line_count == 1);
+
+    SearchState state;
+    state.print_progress = false;
+    state.multi_pv = 4;
+    MiniMaxResult result = start_minimax(3, &board, true, state);
+    assert(state.line_count == 4);
+    assert(result.move == state.lines[0].moves[0] && result.score == best.score);
+    // Best first, with different first moves
+    for (int i = 0; i < state.line_count; i++) {
+        for (int j = 0; j < i; j++) {
+            assert(state.lines[i].score <= state.lines[j].score);
+            assert(state.lines[i].moves[0] != state.lines[j].moves[0]);
+        }
+    }
+    // Each score is the one the move gets on its own. Checked in a blocked position where
+    // nothing is extended, otherwise the root move's extension changes the depth of the reply
+    Board blocked("4k3/8/8/1p1p1p1p/1P1P1P1P/8/8/4K3 w - - 0 1");
+    SearchState lines;
+    lines.print_progress = false;
+    lines.multi_pv = 4;
+    start_minimax(3, &blocked, true, lines);
+    assert(lines.line_count == 4 && lines.stats.extensions.get() == 0);
+    for (int i = 0; i < lines.line_count; i++) {
+        const PvLine &line = lines.lines[i];
+        SearchState reply;
+        reply.print_progress = false;
+        blocked.move_piece(line.moves[0][0], line.moves[0][1], line.moves[0][2], line.moves[0][3]);
+        assert(start_minimax(2, &blocked, false, reply).score == line.score);
+        blocked.undo_move();
+    }
+    // Sharing the hash table makes it cheaper than four separate searches
+    assert(state.stats.nodes.get() < 4 * single.stats.nodes.get());
+
+    // More lines than moves gives every move
+    Board few("7k/8/8/8/8/8/8/K7 w - - 0 1");
+    state.multi_pv = 10;
+    start_minimax(2, &few, true, state);
+    assert(state.line_count == 3);
+    std::cout << "MultiPV Test Passed!\n";
+}
+
+void test_frontier_pruning() {
+    // The quiescence search takes a hanging queen, but not a pawn that costs the queen
+    SearchState state;
+    state.print_progress = false;
+    Board hanging("4k3/8/8/3q4/8/4N3/8/4K3 w - - 0 1");
+    MiniMaxResult result = quiescence(0, &hanging, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), true, state);
+    assert((result.move == std::array<int, 4>{5, 4, 3, 3}));
+    assert(result.score > hanging.get_board_value());
+    Board defended("4k3/8/4p3/3p4/8/8/3Q4/4K3 w - - 0 1");
+    result = quiescence(0, &defended, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), true, state);
+    assert(result.move[0] == -1 && result.score == defended.get_board_value());
+
+    // Same move with far fewer nodes
+    Board board("r1b1kb1r/3npppp/p1p5/2N3B1/4P1n1/8/PPP2PPP/R3K1NR w KQkq - 0 1");
+    state.pruning.enabled = false;
+    MiniMaxResult full = start_minimax(5, &board, true, state);
+    uint64_t full_nodes = state.stats.nodes.get();
+    state.pruning.enabled = true;
+    state.hash_table.clear();
+    MiniMaxResult pruned = start_minimax(5, &board, true, state);
+    assert(pruned.move == full.move);
+    assert(state.stats.nodes.get() < full_nodes);
+    assert(state.stats.futility_prunes.get() > 0 && state.stats.reverse_futility_prunes.get() > 0);
+    std::cout << "Frontier Pruning Test Passed!\n";
+}
+
+void test_mirrored_sides() {
+    // Black searching the mirrored position finds the mirrored move with the opposite score
+    SearchState white_state;
+    white_state.print_progress = false;
+    SearchState black_state;
+    black_state.print_progress = false;
+    Board white("r1b1kb1r/3npppp/p1p5/2N3B1/4P1n1/8/PPP2PPP/R3K1NR w KQkq - 0 1");
+    Board black("r3k1nr/ppp2ppp/8/4p1N1/2n3b1/P1P5/3NPPPP/R1B1KB1R b KQkq - 0 1");
+    MiniMaxResult white_result = start_minimax(5, &white, true, white_state);
+    MiniMaxResult black_result = start_minimax(5, &black, false, black_state);
+    assert(black_result.score == -white_result.score);
+    assert((black_result.move == std::array<int, 4>{7 - white_result.move[0], white_result.move[1], 7 - white_result.move[2], white_result.move[3]}));
+    std::cout << "Mirrored Sides Test Passed!\n";
+}
+
+void test_saved_hash_table() {
+    const std::string path = "hash_table_test.bin";
+    Board board("r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N2N2/PP2BPPP/R2QKB1R w KQ - 0 1");
+    SearchState first;
+    first.print_progress = false;
+    MiniMaxResult result = start_minimax(5, &board, true, first);
+    assert(first.hash_table.save(path));
+
+    // A new engine that loads the table finds the same move with a fraction of the work
+    SearchState second;
+    second.print_progress = false;
+    second.hash_table.resize(1 << 10);
+    assert(second.hash_table.load(path));
+    assert(second.hash_table.capacity() == first.hash_table.capacity());
+    MiniMaxResult again = start_minimax(5, &board, true, second);
+    assert(again.move == result.move && again.score == result.score);
+    assert(second.stats.nodes.get() * 10 < first.stats.nodes.get());
+
+    // Other files, and tables from another version, are turned down and change nothing
+    FILE *file = std::fopen(path.c_str(), "r+b");
+    TableFileHeader header;
+    assert(std::fread(&header, sizeof(header), 1, file) == 1);
+    header.version++;
+    std::rewind(file);
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fclose(file);
+    SearchState third;
+    third.hash_table.resize(1 << 10);
+    assert(!third.hash_table.load(path));
+    assert(!third.hash_table.load("missing_hash_table.bin"));
+    assert(third.hash_table.capacity() == 1 << 10);
+    std::remove(path.c_str());
+    std::cout << "Saved Hash Table Test Passed!\n";
+}
+
 int main() {
+    test_ponder_hit();
+    test_stop();
+    test_draws();
+    test_mate();
+    test_multi_pv();
+    test_saved_hash_table();
+    test_frontier_pruning();
+    test_mirrored_sides();
     //test_minimax_time();
     test_minimax_correctness();
     std::cout << "All MiniMax Algorithm Tests Passed!\n";
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include "board_representation.h"
+#include "pgn_reader.h"
+#include "packed_position.h"
+
+const char *TEST_PGN =
+    "[Event \"Test\"]\n"
+    "[White \"Someone \\\"quoted\\\"\"]\n"
+    "[Result \"1-0\"]\n"
+    "\n"
+    "1. e4 {A comment} e5 2. Nf3 (2. f4 exf4 (2... d5) 3. Nf3) Nc6 3. Bb5 a6 4. O-O $1 Nf6\n"
+    "5. d4 exd4 6. e5 d5 7. exd6 Bxd6 8. Nbd2 O-O ; rest of the line\n"
+    "9. Re1!? Re8 1-0\n"
+    "\n"
+    "[Event \"Second\"]\n"
+    "[FEN \"4k3/P7/8/8/8/8/8/4K2R w K - 0 1\"]\n"
+    "[Result \"1/2-1/2\"]\n"
+    "\n"
+    "1. a8=Q+ Kd7 2. O-O 1/2-1/2\n"
+    "\n"
+    "[Event \"Unfinished\"]\n"
+    "\n"
+    "1. d4 *\n";
+
+// Play the moves of a game, returns how many could be decoded
+int play_game(const PgnGame &game, Board &board) {
+    int side = board.current_player;
+    std::array<int, 4> move;
+    for (size_t i = 0; i < game.moves.size(); i++) {
+        if (!san_to_move(board, side, game.moves[i], move)) {
+            return (int)i;
+        }
+        board.move_piece(move[0], move[1], move[2], move[3]);
+        side = -side;
+    }
+    return (int)game.moves.size();
+}
+
+void test_pgn_reader() {
+    FILE *file = std::tmpfile();
+    std::fputs(TEST_PGN, file);
+    std::rewind(file);
+    PgnReader reader(file);
+    PgnGame game;
+
+    assert(reader.next_game(game));
+    assert(game.result == 1 && game.fen == START_FEN);
+    assert(game.moves.size() == 18);
+    assert(game.moves[6] == "O-O" && game.moves[16] == "Re1");
+    Board board(game.fen);
+    assert(play_game(game, board) == 18);
+    // The en passant capture took the d5 pawn, and both sides castled
+    assert(board.piece_at(3, 3) == 0 && board.piece_at(2, 3) == -4);
+    assert(board.piece_at(7, 6) == 5 && board.piece_at(0, 6) == -5);
+
+    assert(reader.next_game(game));
+    assert(game.result == 0 && game.fen == "4k3/P7/8/8/8/8/8/4K2R w K - 0 1");
+    Board promotion(game.fen);
+    assert(play_game(game, promotion) == 3);
+    assert(promotion.piece_at(0, 0) == 6 && promotion.piece_at(7, 5) == 2);
+
+    assert(reader.next_game(game));
+    assert(game.result == PGN_NO_RESULT && game.moves.size() == 1);
+    assert(!reader.next_game(game));
+    std::fclose(file);
+    std::cout << "PGN Reader Test Passed!\n";
+}
+
+void test_san_to_move() {
+    std::array<int, 4> move;
+    // Both rooks reach d1
+    Board rooks("4k3/8/8/8/8/8/4K3/R6R w - - 0 1");
+    assert(!san_to_move(rooks, 1, "Rd1", move));
+    assert(san_to_move(rooks, 1, "Rad1", move) && move[1] == 0);
+    assert(san_to_move(rooks, 1, "Rhxd1", move) && move[1] == 7);
+
+    Board board("4k3/P7/8/8/8/8/8/R3K2R w KQ - 0 1");
+    assert(san_to_move(board, 1, "O-O-O", move) && move == (std::array<int, 4>{7, 4, 7, 2}));
+    // The board can only promote to a queen
+    assert(san_to_move(board, 1, "a8Q", move));
+    assert(!san_to_move(board, 1, "a8=N", move));
+    assert(!san_to_move(board, 1, "Nf3", move));
+    assert(!san_to_move(board, 1, "O-O-O-O", move));
+    std::cout << "SAN Test Passed!\n";
+}
+
+void test_packed_position() {
+    const std::string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b Kq e3 0 3",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 12 40"
+    };
+    for (const std::string &fen : fens) {
+        Board board(fen);
+        std::array<int, 4> move = {6, 4, 4, 4};
+        PackedPosition packed = pack_position(board, board.current_player, move, -1);
+        assert(unpack_fen(packed) == fen);
+        assert(unpack_move(packed) == move);
+        assert(packed.result == -1);
+    }
+
+    // Write a dataset and read it back through the mapping
+    const std::string path = "pgn_reader_test.bin";
+    {
+        DatasetWriter writer(path);
+        assert(writer.is_open());
+        std::vector<PackedPosition> chunk;
+        for (const std::string &fen : fens) {
+            Board board(fen);
+            chunk.push_back(pack_position(board, board.current_player, {0, 0, 0, 0}, 0));
+        }
+        writer.write(chunk);
+        assert(chunk.empty() && writer.positions_written() == 4);
+    }
+    {
+        DatasetFile dataset(path);
+        assert(dataset.is_open() && dataset.size() == 4);
+        int i = 0;
+        for (const PackedPosition &packed : dataset) {
+            assert(unpack_fen(packed) == fens[i++]);
+        }
+    }
+    std::remove(path.c_str());
+    assert(!DatasetFile(path).is_open());
+    std::cout << "Packed Position Test Passed!\n";
+}
+
+int main() {
+    test_pgn_reader();
+    test_san_to_move();
+    test_packed_position();
+    std::cout << "All PGN Reader Tests Passed!\n";
+    return 0;
+}
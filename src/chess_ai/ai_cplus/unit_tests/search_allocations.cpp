@@ -0,0 +1,78 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include "board_representation.h"
+#include "search_algorithm.h"
+
+// Count every call to the global operator new while counting is switched on
+static bool counting = false;
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    if (counting) {
+        allocations++;
+    }
+    void *ptr = std::malloc(size ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+// GCC sees the free of memory from operator new once the news are inlined, but these
+// news come from malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// The other deletes go through the one above, like the news
+void operator delete[](void *ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void test_search_does_not_allocate() {
+    SearchState state;
+    state.print_progress = false;
+    Board board("r1b1kb1r/3npppp/p1p5/2N3B1/4P1n1/8/PPP2PPP/R3K1NR w KQkq - 0 1");
+    Board other("r3kb1r/3bp1pp/p1P5/8/6q1/8/PPP2PP1/1K4NR b kq - 0 1");
+
+    // Warm up, everything the search needs gets allocated here
+    state.max_depth = 4;
+    iterative_minimax(&board, true, state);
+
+    counting = true;
+    state.max_depth = 5;
+    iterative_minimax(&board, true, state);
+    iterative_minimax(&other, false, state);
+    counting = false;
+
+    std::cout << "Allocations during search: " << allocations << "\n";
+    assert(allocations == 0);
+    std::cout << "Search Allocation Test Passed!\n";
+}
+
+int main() {
+    test_search_does_not_allocate();
+    std::cout << "All Search Allocation Tests Passed!\n";
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include "sprt.h"
+
+void test_elo() {
+    assert(std::abs(expected_score(0.0) - 0.5) < 1e-9);
+    assert(std::abs(elo_from_score(expected_score(100.0)) - 100.0) < 1e-6);
+    // 60% of the points is about 70 Elo
+    MatchScore match;
+    match.wins = 40;
+    match.losses = 20;
+    match.draws = 40;
+    EloEstimate elo = estimate_elo(match);
+    assert(std::abs(elo.elo - 70.4) < 0.1);
+    assert(elo.error > 0.0 && elo.error < 70.0);
+    std::cout << "Elo Test Passed!\n";
+}
+
+void test_sprt() {
+    MatchScore even;
+    even.wins = 1500;
+    even.losses = 1500;
+    even.draws = 2000;
+    // An even match is evidence against a 10 Elo gain
+    assert(sprt_llr(even, 0.0, 10.0) < 0.0);
+    assert(sprt_test(sprt_llr(even, 0.0, 10.0), 0.05, 0.05) == SPRT_ACCEPT_H0);
+
+    MatchScore better;
+    better.wins = 400;
+    better.losses = 250;
+    better.draws = 350;
+    assert(sprt_test(sprt_llr(better, 0.0, 10.0), 0.05, 0.05) == SPRT_ACCEPT_H1);
+
+    MatchScore few;
+    few.wins = 3;
+    few.losses = 2;
+    few.draws = 5;
+    assert(sprt_test(sprt_llr(few, 0.0, 10.0), 0.05, 0.05) == SPRT_CONTINUE);
+    std::cout << "SPRT Test Passed!\n";
+}
+
+int main() {
+    test_elo();
+    test_sprt();
+    std::cout << "All SPRT Tests Passed!\n";
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Tracing is only compiled in with the flag
+#ifndef SEARCH_TRACE
+#define SEARCH_TRACE
+#endif
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "board_representation.h"
+#include "trace.h"
+
+void inner() {
+    TRACE_SCOPE("inner");
+}
+
+void outer() {
+    TRACE_SCOPE("outer");
+    inner();
+    inner();
+}
+
+std::string read_file(const std::string &path) {
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+void test_collapsed_stacks() {
+    trace_reset();
+    for (int i = 0; i < 10; i++) {
+        outer();
+    }
+    inner();
+    // A second thread gets its own tree
+    std::thread([]() { outer(); }).join();
+
+    std::ostringstream summary;
+    trace_print_summary(summary);
+    assert(summary.str().find("trace outer calls 11 ") != std::string::npos);
+    assert(summary.str().find("trace inner calls 23 ") != std::string::npos);
+
+    const std::string path = "trace_test.txt";
+    assert(trace_write_collapsed(path));
+    std::string stacks = read_file(path);
+    assert(stacks.find("thread 0;outer ") != std::string::npos);
+    assert(stacks.find("thread 0;outer;inner ") != std::string::npos);
+    assert(stacks.find("thread 0;inner ") != std::string::npos);
+    assert(stacks.find("thread 1;outer;inner ") != std::string::npos);
+    std::remove(path.c_str());
+    std::cout << "Collapsed Stacks Test Passed!\n";
+}
+
+void test_chrome_trace() {
+    trace_reset();
+    Board board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    board.move_piece(6, 4, 4, 4);
+    board.undo_move();
+    board.get_board_value();
+
+    const std::string path = "trace_test.json";
+    assert(trace_write_chrome(path));
+    std::string json = read_file(path);
+    assert(json.find("\"traceEvents\":[") != std::string::npos);
+    assert(json.find("{\"name\":\"move_piece\",\"ph\":\"X\"") != std::string::npos);
+    assert(json.find("\"name\":\"undo_move\"") != std::string::npos);
+    assert(json.find("\"name\":\"evaluate_king_safety\"") != std::string::npos);
+    assert(json.find("\"name\":\"outer\"") == std::string::npos); // Gone after the reset
+    std::remove(path.c_str());
+    std::cout << "Chrome Trace Test Passed!\n";
+}
+
+int main() {
+    test_collapsed_stacks();
+    test_chrome_trace();
+    std::cout << "All Trace Tests Passed!\n";
+    return 0;
+}